@@ -0,0 +1,301 @@
+#ifndef ACTION_GRAPH_HPP
+#define ACTION_GRAPH_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "json.hpp"
+#include "dir_scanner.hpp"
+#include "logger.hpp"
+#include "sha256.hpp"
+
+// Tegen's work as a DAG of actions (fetch, materialize, configure, compile, test, ...)
+// with a persistent, content-addressed action cache.
+//
+// An action's key is the SHA-256 of its name, its key parts (command lines,
+// versions), the contents of its declared inputs, and the keys of the actions it
+// depends on, so a change propagates down the graph. A cacheable action is skipped
+// when its key matches the cached one and its declared outputs still have the
+// digests recorded after its last successful run.
+//
+// File digests are memoized by (size, mtime), so unchanged trees are not re-read.
+// Ready actions run in parallel on a shared pool. After a failure no new actions
+// start; once the running ones finish, the first error is rethrown.
+class ActionGraph
+{
+public:
+    struct Action
+    {
+        std::string name; // Unique within the graph, e.g. "configure" or "fetch:fmt"
+        std::vector<std::string> deps;
+        std::vector<std::string> keyParts;
+        std::vector<std::filesystem::path> inputs;  // Files or directory trees
+        std::vector<std::filesystem::path> outputs; // Must exist with their recorded digests to skip
+        bool cacheable = true;
+        // Runs once the dependencies are done and may fill in inputs/outputs that only they reveal
+        std::function<void(Action &)> prepare;
+        std::function<void(const Action &)> work; // Throws on failure
+    };
+
+    explicit ActionGraph(std::filesystem::path cacheFile) : cacheFile(std::move(cacheFile)) {}
+
+    void add(Action action)
+    {
+        if (index.count(action.name))
+            throw std::runtime_error("Duplicate action: " + action.name);
+        index[action.name] = actions.size();
+        actions.push_back(std::move(action));
+    }
+
+    size_t executed() const
+    {
+        return ran;
+    }
+
+    size_t skipped() const
+    {
+        return cached;
+    }
+
+    void run(unsigned jobs = 0)
+    {
+        if (jobs == 0)
+            jobs = std::max(1u, std::thread::hardware_concurrency());
+
+        std::vector<size_t> waiting(actions.size(), 0);
+        std::vector<std::vector<size_t>> dependents(actions.size());
+        for (size_t i = 0; i < actions.size(); i++)
+        {
+            for (const auto &dep : actions[i].deps)
+            {
+                auto found = index.find(dep);
+                if (found == index.end())
+                    throw std::runtime_error("Action " + actions[i].name + " depends on unknown action " + dep);
+                dependents[found->second].push_back(i);
+                waiting[i]++;
+            }
+        }
+
+        load();
+        keys.assign(actions.size(), "");
+        std::vector<size_t> ready;
+        for (size_t i = 0; i < actions.size(); i++)
+            if (waiting[i] == 0)
+                ready.push_back(i);
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        size_t running = 0;
+        std::exception_ptr failure;
+
+        auto worker = [&]()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                changed.wait(lock, [&]
+                             { return !ready.empty() || running == 0 || failure; });
+                if (ready.empty() || failure)
+                    return;
+                size_t current = ready.back();
+                ready.pop_back();
+                running++;
+                lock.unlock();
+
+                std::exception_ptr error;
+                try
+                {
+                    execute(current);
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+
+                lock.lock();
+                running--;
+                if (error && !failure)
+                    failure = error;
+                if (!error)
+                    for (size_t next : dependents[current])
+                        if (--waiting[next] == 0)
+                            ready.push_back(next);
+                changed.notify_all();
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned i = 1; i < std::min<size_t>(jobs, actions.size()); i++)
+            pool.emplace_back(worker);
+        worker();
+        for (auto &thread : pool)
+            thread.join();
+
+        save();
+        if (failure)
+            std::rethrow_exception(failure);
+    }
+
+private:
+    using json = nlohmann::json;
+
+    struct Stamp
+    {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        std::string digest;
+    };
+
+    std::filesystem::path cacheFile;
+    std::vector<Action> actions;
+    std::map<std::string, size_t> index;
+    std::vector<std::string> keys;
+    json entries = json::object();
+    std::map<std::string, Stamp> stamps;
+    std::mutex stateMutex;
+    size_t ran = 0;
+    size_t cached = 0;
+
+    void execute(size_t position)
+    {
+        Action &action = actions[position];
+        if (action.prepare)
+            action.prepare(action);
+
+        Sha256 hasher;
+        hasher.update(action.name + '\n');
+        for (const auto &part : action.keyParts)
+            hasher.update("part " + part + '\n');
+        for (const auto &input : action.inputs)
+            hasher.update("input " + input.generic_string() + ' ' + digest(input) + '\n');
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            for (const auto &dep : action.deps)
+                hasher.update("dep " + keys[index[dep]] + '\n');
+        }
+        std::string key = hasher.hexDigest();
+
+        json previous;
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            keys[position] = key;
+            previous = entries.value(action.name, json::object());
+        }
+        if (action.cacheable && previous.value("key", "") == key && outputsMatch(action, previous))
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            cached++;
+            Log::info() << "Up to date: " << action.name;
+            return;
+        }
+
+        if (action.work)
+            action.work(action);
+
+        json entry;
+        entry["key"] = key;
+        entry["outputs"] = json::object();
+        for (const auto &output : action.outputs)
+            entry["outputs"][output.generic_string()] = digest(output);
+        std::lock_guard<std::mutex> lock(stateMutex);
+        entries[action.name] = entry;
+        ran++;
+    }
+
+    bool outputsMatch(const Action &action, const json &previous)
+    {
+        const json &recorded = previous.value("outputs", json::object());
+        for (const auto &output : action.outputs)
+        {
+            auto name = output.generic_string();
+            if (!recorded.contains(name) || recorded[name] != digest(output))
+                return false;
+        }
+        return true;
+    }
+
+    // Content digest of a file or directory tree; "missing" when it does not exist
+    std::string digest(const std::filesystem::path &path)
+    {
+        std::error_code ec;
+        auto status = std::filesystem::status(path, ec);
+        if (ec || !std::filesystem::exists(status))
+            return "missing";
+        if (!std::filesystem::is_directory(status))
+            return fileDigest(path);
+
+        auto tree = DirScanner::scan(path);
+        Sha256 hasher;
+        for (const auto &entry : tree.entries())
+        {
+            if (entry.type != DirScanner::EntryType::File)
+                continue;
+            auto relative = std::string(tree.relative(entry));
+            hasher.update(relative + ' ' + fileDigest(tree.path(entry)) + '\n');
+        }
+        return hasher.hexDigest();
+    }
+
+    std::string fileDigest(const std::filesystem::path &path)
+    {
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(path, ec);
+        if (ec)
+            return "missing";
+        int64_t mtime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+        auto name = path.generic_string();
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            auto found = stamps.find(name);
+            if (found != stamps.end() && found->second.size == size && found->second.mtime == mtime)
+                return found->second.digest;
+        }
+        auto result = Sha256::hashFile(path);
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stamps[name] = {size, mtime, result};
+        return result;
+    }
+
+    void load()
+    {
+        std::ifstream in(cacheFile);
+        json cache = in ? json::parse(in, nullptr, false) : json();
+        if (cache.is_discarded() || !cache.is_object())
+            return;
+        entries = cache.value("actions", json::object());
+        json files = cache.value("files", json::object());
+        for (const auto &[name, stamp] : files.items())
+            stamps[name] = {stamp.value("size", uint64_t(0)), stamp.value("mtime", int64_t(0)), stamp.value("digest", "")};
+    }
+
+    void save()
+    {
+        json cache;
+        cache["actions"] = entries;
+        cache["files"] = json::object();
+        for (const auto &[name, stamp] : stamps)
+        {
+            // Forget files that are gone so the cache does not grow forever
+            if (std::filesystem::exists(name))
+                cache["files"][name] = {{"size", stamp.size}, {"mtime", stamp.mtime}, {"digest", stamp.digest}};
+        }
+        std::error_code ec;
+        std::filesystem::create_directories(cacheFile.parent_path(), ec);
+        auto temporary = cacheFile;
+        temporary += ".tmp";
+        std::ofstream(temporary) << cache.dump();
+        std::filesystem::rename(temporary, cacheFile, ec);
+    }
+};
+
+#endif
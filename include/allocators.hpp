@@ -0,0 +1,230 @@
+#ifndef ALLOCATORS_HPP
+#define ALLOCATORS_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "json.hpp"
+
+// malloc replacements chosen per build profile in TegenConfig.json:
+//
+//   "profiles": {
+//     "release": { "allocator": "mimalloc" },
+//     "debug":   { "allocator": { "name": "jemalloc", "mode": "preload", "env": { "MALLOC_CONF": "prof:true" } } }
+//   }
+//
+// A profile is picked by the build's CMAKE_BUILD_TYPE (case-insensitive); "default"
+// covers builds without a type or without a matching profile. In "link" mode (the
+// default) the generated cmake/TegenAllocator.cmake links the allocator's shared
+// library into every executable, which replaces malloc process-wide. In "preload" mode
+// it is injected through LD_PRELOAD (DYLD_INSERT_LIBRARIES on macOS) by run and bench.
+class Allocators
+{
+public:
+    struct Spec
+    {
+        std::string name = "system";
+        std::string mode = "link"; // "link" or "preload"
+        std::map<std::string, std::string> env;
+    };
+
+    static const std::vector<std::string> &names()
+    {
+        static const std::vector<std::string> all = {"system", "mimalloc", "jemalloc", "tcmalloc"};
+        return all;
+    }
+
+    static bool known(const std::string &name)
+    {
+        return std::find(names().begin(), names().end(), name) != names().end();
+    }
+
+    // Allocator of every profile that sets one, keyed by lower-case profile name
+    static std::map<std::string, Spec> profiles(const nlohmann::json &config)
+    {
+        std::map<std::string, Spec> result;
+        if (!config.contains("profiles") || !config["profiles"].is_object())
+            return result;
+        for (const auto &[profile, settings] : config["profiles"].items())
+        {
+            if (!settings.is_object() || !settings.contains("allocator"))
+                continue;
+            Spec spec;
+            const auto &allocator = settings["allocator"];
+            if (allocator.is_string())
+            {
+                spec.name = allocator.get<std::string>();
+            }
+            else
+            {
+                spec.name = allocator.value("name", "system");
+                spec.mode = allocator.value("mode", "link");
+                spec.env = allocator.value("env", std::map<std::string, std::string>());
+            }
+            if (!known(spec.name))
+                throw std::runtime_error("Unknown allocator '" + spec.name + "' in profile " + profile + " (use system, mimalloc, jemalloc or tcmalloc)");
+            if (spec.mode != "link" && spec.mode != "preload")
+                throw std::runtime_error("Allocator mode must be \"link\" or \"preload\" in profile " + profile);
+            result[lower(profile)] = spec;
+        }
+        return result;
+    }
+
+    // Spec for the build type the build directory was configured with
+    static Spec active(const nlohmann::json &config, const std::filesystem::path &buildDir)
+    {
+        std::string buildType;
+        std::ifstream cache(buildDir / "CMakeCache.txt");
+        for (std::string line; std::getline(cache, line);)
+            if (line.rfind("CMAKE_BUILD_TYPE:", 0) == 0)
+                buildType = lower(line.substr(line.find('=') + 1));
+
+        auto all = profiles(config);
+        auto found = all.find(buildType.empty() ? "default" : buildType);
+        if (found == all.end())
+            found = all.find("default");
+        return found == all.end() ? Spec() : found->second;
+    }
+
+    // Tuning applied on run and bench; the profile's own env entries win
+    static std::map<std::string, std::string> environment(const Spec &spec)
+    {
+        std::map<std::string, std::string> env;
+        if (spec.name == "jemalloc")
+            env["MALLOC_CONF"] = "background_thread:true,metadata_thp:auto";
+        else if (spec.name == "tcmalloc")
+            env["TCMALLOC_MAX_TOTAL_THREAD_CACHE_BYTES"] = "67108864";
+        for (const auto &[key, value] : spec.env)
+            env[key] = value;
+        return env;
+    }
+
+    // Names for CMake's find_library, preferring the smaller variants
+    static std::vector<std::string> libraryNames(const std::string &name)
+    {
+        if (name == "tcmalloc")
+            return {"tcmalloc_minimal", "tcmalloc"};
+        if (name == "system")
+            return {};
+        return {name};
+    }
+
+    // Shared library of an allocator, from the project's lib/ or the system; empty if not installed
+    static std::filesystem::path findShared(const std::string &name, const std::filesystem::path &projectLib)
+    {
+        std::vector<std::filesystem::path> directories = {projectLib, "/usr/local/lib", "/usr/lib64", "/usr/lib",
+                                                          "/usr/lib/x86_64-linux-gnu", "/usr/lib/aarch64-linux-gnu",
+                                                          "/opt/homebrew/lib"};
+        std::error_code ec;
+        for (const auto &library : libraryNames(name))
+        {
+            for (const auto &directory : directories)
+            {
+                for (const auto &entry : std::filesystem::directory_iterator(directory, ec))
+                {
+                    // libmimalloc.so, libmimalloc.so.2, libjemalloc.2.dylib, ...
+                    auto file = entry.path().filename().string();
+                    auto stem = "lib" + library;
+                    if (file.rfind(stem, 0) == 0 && file.size() > stem.size() && (file[stem.size()] == '.') &&
+                        (file.find(".so") != std::string::npos || file.find(".dylib") != std::string::npos))
+                        return entry.path();
+                }
+            }
+        }
+        return {};
+    }
+
+    // What to tell a user whose allocator is missing; Tegen does not install allocators itself,
+    // since packages only bring static archives and those need not replace malloc at all
+    static std::string installHint(const std::string &name)
+    {
+        std::string packages = name == "tcmalloc" ? "libgoogle-perftools-dev or gperftools" : "lib" + name + "-dev or " + name;
+        return "install the system package (" + packages + ") or put its shared library in lib/";
+    }
+
+    static std::string preloadVariable()
+    {
+#ifdef __APPLE__
+        return "DYLD_INSERT_LIBRARIES";
+#else
+        return "LD_PRELOAD";
+#endif
+    }
+
+    // CMake module linking each profile's allocator into every executable
+    static std::string cmakeModule(const nlohmann::json &config)
+    {
+        auto all = profiles(config);
+        std::vector<std::string> named;
+        for (const auto &[profile, spec] : all)
+            if (profile != "default")
+                named.push_back(profile);
+
+        std::ostringstream out;
+        out << "# Generated by Tegen from the \"profiles\" in TegenConfig.json; edit those instead.\n";
+        out << "get_property(_tegen_targets DIRECTORY \"${CMAKE_SOURCE_DIR}\" PROPERTY BUILDSYSTEM_TARGETS)\n";
+        for (const auto &[profile, spec] : all)
+        {
+            if (spec.name == "system" || spec.mode != "link")
+                continue;
+
+            std::string condition;
+            if (profile != "default")
+            {
+                condition = "$<CONFIG:" + profile + ">";
+            }
+            else
+            {
+                condition = "$<NOT:$<OR:0";
+                for (const auto &other : named)
+                    condition += ",$<CONFIG:" + other + ">";
+                condition += ">>";
+            }
+
+            std::string variable = "TEGEN_ALLOCATOR_" + upper(spec.name);
+            out << "\n# " << profile << ": " << spec.name << "\n";
+            out << "find_library(" << variable << " NAMES";
+            for (const auto &library : libraryNames(spec.name))
+                out << " " << library;
+            out << " HINTS \"${CMAKE_SOURCE_DIR}/lib\")\n";
+            out << "if(" << variable << ")\n";
+            out << "    foreach(_tegen_target IN LISTS _tegen_targets)\n";
+            out << "        get_target_property(_tegen_type ${_tegen_target} TYPE)\n";
+            out << "        if(_tegen_type STREQUAL \"EXECUTABLE\")\n";
+            out << "            target_link_libraries(${_tegen_target} PRIVATE \"$<" << condition << ":${" << variable << "}>\")\n";
+            out << "            if(CMAKE_SYSTEM_NAME STREQUAL \"Linux\")\n";
+            out << "                # Nothing references the allocator's symbols directly, so keep --as-needed from dropping it\n";
+            out << "                target_link_options(${_tegen_target} PRIVATE \"$<" << condition << ":LINKER:--no-as-needed>\")\n";
+            out << "            endif()\n";
+            out << "        endif()\n";
+            out << "    endforeach()\n";
+            out << "else()\n";
+            out << "    message(WARNING \"Tegen: allocator " << spec.name << " not found; " << installHint(spec.name) << "\")\n";
+            out << "endif()\n";
+        }
+        return out.str();
+    }
+
+private:
+    static std::string lower(std::string value)
+    {
+        std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c)
+                       { return char(std::tolower(c)); });
+        return value;
+    }
+
+    static std::string upper(std::string value)
+    {
+        std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c)
+                       { return char(std::toupper(c)); });
+        return value;
+    }
+};
+
+#endif
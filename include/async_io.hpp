@@ -0,0 +1,640 @@
+#ifndef ASYNC_IO_HPP
+#define ASYNC_IO_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bounded_queue.hpp"
+#include "sha256.hpp"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+// Direct-descriptor opens (file_index) need 5.15+ UAPI headers
+#if defined(IORING_FILE_INDEX_ALLOC) && defined(__NR_io_uring_setup)
+#define TEGEN_HAVE_IO_URING 1
+#endif
+#endif
+
+// Bulk file I/O for install and cache operations.
+//
+// Three backends share one interface:
+//   - Sequential: the plain copy_file loop install() has always used
+//   - Threaded:   the same synchronous calls spread over a worker pool
+//   - IoUring:    batched submissions on Linux; each small file is one hard-linked
+//                 chain (open src, open dst, read, write, close, close) using direct
+//                 descriptors and registered buffers, so a batch of files costs a
+//                 single io_uring_enter instead of six syscalls per file
+//
+// IoUring falls back to Threaded when the kernel (or a seccomp filter) refuses
+// io_uring or lacks the needed opcodes. TEGEN_IO=sequential|threads|uring forces
+// a backend.
+class AsyncFileIo
+{
+public:
+    enum class Backend
+    {
+        Sequential,
+        Threaded,
+        IoUring
+    };
+
+    struct CopyJob
+    {
+        std::filesystem::path from;
+        std::filesystem::path to;
+        uintmax_t size = 0;
+    };
+
+    using Progress = std::function<void(size_t done)>;
+
+    explicit AsyncFileIo(Backend preferred = Backend::IoUring)
+    {
+        if (const char *forced = std::getenv("TEGEN_IO"))
+        {
+            std::string name = forced;
+            if (name == "sequential")
+                preferred = Backend::Sequential;
+            else if (name == "threads")
+                preferred = Backend::Threaded;
+            else if (name == "uring")
+                preferred = Backend::IoUring;
+        }
+
+        active = preferred;
+#ifdef TEGEN_HAVE_IO_URING
+        if (preferred == Backend::IoUring && !ring.open(batchFiles, bufferSize))
+            active = Backend::Threaded;
+#else
+        if (preferred == Backend::IoUring)
+            active = Backend::Threaded;
+#endif
+    }
+
+    Backend backend() const
+    {
+        return active;
+    }
+
+    static const char *backendName(Backend backend)
+    {
+        switch (backend)
+        {
+        case Backend::Sequential:
+            return "sequential";
+        case Backend::Threaded:
+            return "threads";
+        default:
+            return "io_uring";
+        }
+    }
+
+    // Copy every job, creating target directories as needed
+    void copy(const std::vector<CopyJob> &jobs, const Progress &progress = nullptr)
+    {
+        std::set<std::filesystem::path> parents;
+        for (const auto &job : jobs)
+            parents.insert(job.to.parent_path());
+        for (const auto &parent : parents)
+            std::filesystem::create_directories(parent);
+
+        std::atomic<size_t> done{0};
+        std::mutex progressMutex;
+        auto report = [&](size_t count)
+        {
+            size_t now = done.fetch_add(count) + count;
+            if (progress)
+            {
+                std::lock_guard<std::mutex> lock(progressMutex);
+                progress(now);
+            }
+        };
+
+        switch (active)
+        {
+        case Backend::Sequential:
+            for (const auto &job : jobs)
+            {
+                copyOne(job);
+                report(1);
+            }
+            break;
+        case Backend::Threaded:
+            parallelFor(jobs.size(), [&](size_t i)
+                        {
+                copyOne(jobs[i]);
+                report(1); });
+            break;
+        case Backend::IoUring:
+#ifdef TEGEN_HAVE_IO_URING
+            copyWithRing(jobs, report);
+#endif
+            break;
+        }
+    }
+
+    // Copy jobs as a producer pushes them, until the queue is closed. Unlike the
+    // vector overload this does not create target directories: the producer must
+    // create each one before queueing files into it.
+    void copy(BoundedQueue<CopyJob> &queue, const Progress &progress = nullptr)
+    {
+        size_t done = 0;
+        std::mutex progressMutex;
+        auto report = [&](size_t count)
+        {
+            if (count == 0)
+                return;
+            std::lock_guard<std::mutex> lock(progressMutex);
+            done += count;
+            if (progress)
+                progress(done);
+        };
+
+        switch (active)
+        {
+        case Backend::Sequential:
+        {
+            CopyJob job;
+            while (queue.pop(job))
+            {
+                copyOne(job);
+                report(1);
+            }
+            break;
+        }
+        case Backend::Threaded:
+        {
+            unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+            parallelFor(workers, [&](size_t)
+                        {
+                CopyJob job;
+                try
+                {
+                    while (queue.pop(job))
+                    {
+                        copyOne(job);
+                        report(1);
+                    }
+                }
+                catch (...)
+                {
+                    // Unblock the producer; the other workers drain what is already queued
+                    queue.close();
+                    throw;
+                } });
+            break;
+        }
+        case Backend::IoUring:
+#ifdef TEGEN_HAVE_IO_URING
+            streamWithRing(queue, report);
+#endif
+            break;
+        }
+    }
+
+    // SHA-256 of each file, in input order
+    std::vector<std::string> hash(const std::vector<std::filesystem::path> &files)
+    {
+        std::vector<std::string> digests(files.size());
+        switch (active)
+        {
+        case Backend::Sequential:
+            for (size_t i = 0; i < files.size(); i++)
+                digests[i] = Sha256::hashFile(files[i]);
+            break;
+        case Backend::Threaded:
+            parallelFor(files.size(), [&](size_t i)
+                        { digests[i] = Sha256::hashFile(files[i]); });
+            break;
+        case Backend::IoUring:
+#ifdef TEGEN_HAVE_IO_URING
+            hashWithRing(files, digests);
+#endif
+            break;
+        }
+        return digests;
+    }
+
+    static void parallelFor(size_t count, const std::function<void(size_t)> &body)
+    {
+        size_t workers = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+        std::atomic<size_t> next{0};
+        std::exception_ptr failure;
+        std::mutex failureMutex;
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < workers; w++)
+        {
+            threads.emplace_back([&]
+                                 {
+                for (size_t i = next++; i < count; i = next++)
+                {
+                    try
+                    {
+                        body(i);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(failureMutex);
+                        if (!failure)
+                            failure = std::current_exception();
+                    }
+                } });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        if (failure)
+            std::rethrow_exception(failure);
+    }
+
+private:
+    // Files per ring batch and the registered buffer each one reads into; bigger files take the synchronous path
+    static constexpr unsigned batchFiles = 64;
+    static constexpr size_t bufferSize = 128 * 1024;
+
+    Backend active = Backend::Sequential;
+
+    static void copyOne(const CopyJob &job)
+    {
+        std::filesystem::copy_file(job.from, job.to, std::filesystem::copy_options::overwrite_existing);
+    }
+
+#ifdef TEGEN_HAVE_IO_URING
+    // Thin raw-syscall wrapper so Tegen does not depend on liburing
+    class Ring
+    {
+    public:
+        ~Ring()
+        {
+            close();
+        }
+
+        bool open(unsigned slots, size_t bufferBytes)
+        {
+            io_uring_params params{};
+            unsigned entries = slots * opsPerFile;
+            fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+            if (fd < 0)
+                return false;
+
+            sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (single)
+                sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+            sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            if (sqRing == MAP_FAILED)
+                return fail();
+            cqRing = single ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED)
+                return fail();
+            sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            void *sqeMemory = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+            if (sqeMemory == MAP_FAILED)
+                return fail();
+            sqes = static_cast<io_uring_sqe *>(sqeMemory);
+
+            auto *sq = static_cast<char *>(sqRing);
+            auto *cq = static_cast<char *>(cqRing);
+            sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+            sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+            cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+            cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+            sqEntries = params.sq_entries;
+
+            if (!supportsOpcodes())
+                return fail();
+
+            // One registered buffer per in-flight file
+            buffers.resize(slots);
+            std::vector<iovec> iovecs(slots);
+            for (unsigned i = 0; i < slots; i++)
+            {
+                buffers[i].reset(static_cast<char *>(std::aligned_alloc(4096, bufferBytes)));
+                if (!buffers[i])
+                    return fail();
+                iovecs[i] = {buffers[i].get(), bufferBytes};
+            }
+            if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iovecs.data(), slots) < 0)
+                return fail();
+
+            // Sparse direct-descriptor table: two slots (source, target) per in-flight file
+            std::vector<int> files(slots * 2, -1);
+            if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_FILES, files.data(), files.size()) < 0)
+                return fail();
+            return true;
+        }
+
+        char *buffer(unsigned index)
+        {
+            return buffers[index].get();
+        }
+
+        io_uring_sqe *sqe(unsigned index)
+        {
+            io_uring_sqe *entry = &sqes[index];
+            *entry = io_uring_sqe{};
+            return entry;
+        }
+
+        // Publish count SQEs (0..count-1), wait for all their completions and hand each to onComplete
+        void run(unsigned count, const std::function<void(const io_uring_cqe &)> &onComplete)
+        {
+            unsigned tail = *sqTail;
+            for (unsigned i = 0; i < count; i++)
+                sqArray[(tail + i) & sqMask] = i;
+            __atomic_store_n(sqTail, tail + count, __ATOMIC_RELEASE);
+
+            unsigned toSubmit = count;
+            unsigned completed = 0;
+            while (completed < count)
+            {
+                long submitted = syscall(__NR_io_uring_enter, fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (submitted < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    throw std::runtime_error("io_uring_enter failed");
+                }
+                toSubmit -= std::min<unsigned>(toSubmit, static_cast<unsigned>(submitted));
+
+                unsigned head = *cqHead;
+                unsigned ready = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+                for (; head != ready; head++, completed++)
+                    onComplete(cqes[head & cqMask]);
+                __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            }
+        }
+
+        unsigned capacity() const
+        {
+            return sqEntries;
+        }
+
+    private:
+        static constexpr unsigned opsPerFile = 6;
+
+        struct FreeDeleter
+        {
+            void operator()(char *p) const { std::free(p); }
+        };
+
+        int fd = -1;
+        void *sqRing = MAP_FAILED;
+        void *cqRing = MAP_FAILED;
+        size_t sqRingSize = 0, cqRingSize = 0, sqesSize = 0;
+        io_uring_sqe *sqes = nullptr;
+        io_uring_cqe *cqes = nullptr;
+        unsigned *sqTail = nullptr, *sqArray = nullptr, *cqHead = nullptr, *cqTail = nullptr;
+        unsigned sqMask = 0, cqMask = 0, sqEntries = 0;
+        std::vector<std::unique_ptr<char, FreeDeleter>> buffers;
+
+        bool supportsOpcodes()
+        {
+            std::vector<char> storage(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+            auto *probe = reinterpret_cast<io_uring_probe *>(storage.data());
+            if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) < 0)
+                return false;
+            for (unsigned op : {IORING_OP_OPENAT, IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED, IORING_OP_CLOSE})
+            {
+                if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+                    return false;
+            }
+            return true;
+        }
+
+        bool fail()
+        {
+            close();
+            return false;
+        }
+
+        void close()
+        {
+            if (sqes)
+                munmap(sqes, sqesSize);
+            if (cqRing != MAP_FAILED && cqRing != sqRing)
+                munmap(cqRing, cqRingSize);
+            if (sqRing != MAP_FAILED)
+                munmap(sqRing, sqRingSize);
+            if (fd >= 0)
+                ::close(fd);
+            sqes = nullptr;
+            sqRing = cqRing = MAP_FAILED;
+            fd = -1;
+        }
+    };
+
+    Ring ring;
+
+    // user_data layout: file index in the high bits, chain step in the low byte
+    enum Step : uint64_t
+    {
+        OpenSource,
+        OpenTarget,
+        Read,
+        Write,
+        CloseSource,
+        CloseTarget
+    };
+
+    static uint64_t tag(size_t file, Step step)
+    {
+        return (uint64_t(file) << 8) | step;
+    }
+
+    // Every step is hard-linked so the closes always run, even after a failed open or short read
+    static void prepOpen(io_uring_sqe *sqe, const std::filesystem::path &path, int flags, unsigned slot, uint64_t userData)
+    {
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(path.c_str());
+        sqe->len = 0644;
+        sqe->open_flags = flags; // Direct descriptors reject O_CLOEXEC; they are never visible to exec anyway
+        sqe->file_index = slot + 1;
+        sqe->flags = IOSQE_IO_HARDLINK;
+        sqe->user_data = userData;
+    }
+
+    static void prepFixed(io_uring_sqe *sqe, uint8_t opcode, unsigned slot, char *buffer, unsigned buffer_index, size_t size, uint64_t userData)
+    {
+        sqe->opcode = opcode;
+        sqe->fd = static_cast<int>(slot);
+        sqe->addr = reinterpret_cast<uint64_t>(buffer);
+        sqe->len = static_cast<uint32_t>(size);
+        sqe->buf_index = static_cast<uint16_t>(buffer_index);
+        sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+        sqe->user_data = userData;
+    }
+
+    static void prepClose(io_uring_sqe *sqe, unsigned slot, bool linkNext, uint64_t userData)
+    {
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->file_index = slot + 1;
+        sqe->flags = linkNext ? IOSQE_IO_HARDLINK : 0;
+        sqe->user_data = userData;
+    }
+
+    // Copy up to batchFiles small files in one submission; returns which ones succeeded
+    std::vector<bool> ringCopy(const std::vector<const CopyJob *> &batch)
+    {
+        std::vector<bool> ok(batch.size(), true);
+        unsigned n = 0;
+        for (unsigned k = 0; k < batch.size(); k++)
+        {
+            const CopyJob &job = *batch[k];
+            unsigned source = k * 2, target = k * 2 + 1;
+            prepOpen(ring.sqe(n++), job.from, O_RDONLY, source, tag(k, OpenSource));
+            prepOpen(ring.sqe(n++), job.to, O_WRONLY | O_CREAT | O_TRUNC, target, tag(k, OpenTarget));
+            prepFixed(ring.sqe(n++), IORING_OP_READ_FIXED, source, ring.buffer(k), k, job.size, tag(k, Read));
+            prepFixed(ring.sqe(n++), IORING_OP_WRITE_FIXED, target, ring.buffer(k), k, job.size, tag(k, Write));
+            prepClose(ring.sqe(n++), source, true, tag(k, CloseSource));
+            prepClose(ring.sqe(n++), target, false, tag(k, CloseTarget));
+        }
+
+        ring.run(n, [&](const io_uring_cqe &cqe)
+                 {
+            size_t k = cqe.user_data >> 8;
+            auto step = static_cast<Step>(cqe.user_data & 0xff);
+            bool good = (step == Read || step == Write)
+                            ? cqe.res == static_cast<int>(batch[k]->size)
+                            : cqe.res >= 0;
+            if (!good)
+                ok[k] = false; });
+        return ok;
+    }
+
+    template <typename Report>
+    void copyWithRing(const std::vector<CopyJob> &jobs, Report &report)
+    {
+        std::vector<const CopyJob *> small, failed;
+        for (const auto &job : jobs)
+            (job.size <= bufferSize ? small : failed).push_back(&job);
+
+        for (size_t start = 0; start < small.size(); start += batchFiles)
+        {
+            std::vector<const CopyJob *> batch(small.begin() + start, small.begin() + std::min<size_t>(start + batchFiles, small.size()));
+            auto ok = ringCopy(batch);
+            for (size_t k = 0; k < batch.size(); k++)
+            {
+                // A file that changed size under us or failed to open gets the synchronous path
+                if (!ok[k])
+                    failed.push_back(batch[k]);
+            }
+            report(batch.size() - std::count(ok.begin(), ok.end(), false));
+        }
+
+        parallelFor(failed.size(), [&](size_t i)
+                    {
+            copyOne(*failed[i]);
+            report(1); });
+    }
+
+    template <typename Report>
+    void streamWithRing(BoundedQueue<CopyJob> &queue, Report &report)
+    {
+        std::vector<CopyJob> jobs;
+        std::vector<const CopyJob *> batch;
+        jobs.reserve(batchFiles);
+        CopyJob job;
+        while (queue.pop(job))
+        {
+            // Block for the first job only, then take whatever else is ready so submission never waits on the scanner
+            jobs.clear();
+            batch.clear();
+            do
+            {
+                if (job.size <= bufferSize)
+                {
+                    jobs.push_back(std::move(job));
+                }
+                else
+                {
+                    copyOne(job);
+                    report(1);
+                }
+            } while (jobs.size() < batchFiles && queue.tryPop(job));
+
+            for (const auto &queued : jobs)
+                batch.push_back(&queued);
+            auto ok = ringCopy(batch);
+            for (size_t k = 0; k < jobs.size(); k++)
+            {
+                if (!ok[k])
+                    copyOne(jobs[k]);
+            }
+            report(jobs.size());
+        }
+    }
+
+    void hashWithRing(const std::vector<std::filesystem::path> &files, std::vector<std::string> &digests)
+    {
+        std::vector<size_t> small, large;
+        std::vector<uintmax_t> sizes(files.size());
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            sizes[i] = std::filesystem::file_size(files[i]);
+            (sizes[i] <= bufferSize ? small : large).push_back(i);
+        }
+
+        for (size_t start = 0; start < small.size(); start += batchFiles)
+        {
+            size_t count = std::min<size_t>(batchFiles, small.size() - start);
+            std::vector<bool> ok(count, true);
+            unsigned n = 0;
+            for (unsigned k = 0; k < count; k++)
+            {
+                size_t index = small[start + k];
+                unsigned slot = k * 2;
+                prepOpen(ring.sqe(n++), files[index], O_RDONLY, slot, tag(k, OpenSource));
+                prepFixed(ring.sqe(n++), IORING_OP_READ_FIXED, slot, ring.buffer(k), k, sizes[index], tag(k, Read));
+                prepClose(ring.sqe(n++), slot, false, tag(k, CloseSource));
+            }
+
+            ring.run(n, [&](const io_uring_cqe &cqe)
+                     {
+                size_t k = cqe.user_data >> 8;
+                auto step = static_cast<Step>(cqe.user_data & 0xff);
+                bool good = step == Read ? cqe.res == static_cast<int>(sizes[small[start + k]]) : cqe.res >= 0;
+                if (!good)
+                    ok[k] = false; });
+
+            for (unsigned k = 0; k < count; k++)
+            {
+                size_t index = small[start + k];
+                if (!ok[k])
+                {
+                    large.push_back(index);
+                    continue;
+                }
+                Sha256 hasher;
+                hasher.update(ring.buffer(k), sizes[index]);
+                digests[index] = hasher.hexDigest();
+            }
+        }
+
+        parallelFor(large.size(), [&](size_t i)
+                    { digests[large[i]] = Sha256::hashFile(files[large[i]]); });
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef BUILD_DEPS_HPP
+#define BUILD_DEPS_HPP
+
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "dir_scanner.hpp"
+#include "test_runner.hpp"
+
+// The headers every object of the last build included, from the compiler's depfiles.
+// The Makefile generator leaves them next to the objects (<object>.d, CMake 3.20+ with
+// GCC or Clang); Ninja folds them into .ninja_deps, read back through `ninja -t deps`.
+// Paths are absolute and normalized; objects are relative to the build directory.
+class BuildDeps
+{
+public:
+    static std::map<std::string, std::vector<std::string>> load(const std::filesystem::path &buildDir)
+    {
+        std::map<std::string, std::vector<std::string>> deps;
+        if (std::filesystem::exists(buildDir / ".ninja_deps"))
+        {
+            parseNinja(TestRunner::capture("ninja -C \"" + buildDir.string() + "\" -t deps 2>/dev/null"), buildDir, deps);
+            return deps;
+        }
+
+        auto scan = DirScanner::scan(buildDir);
+        for (const auto &entry : scan.entries())
+        {
+            std::string relative(scan.relative(entry));
+            // Tegen's own variant builds (size, profile, ...) live under build/.tegen
+            if (entry.type != DirScanner::EntryType::File || relative.rfind(".tegen/", 0) == 0 ||
+                (!endsWith(relative, ".o.d") && !endsWith(relative, ".obj.d")))
+                continue;
+            std::ifstream in(scan.path(entry));
+            std::stringstream text;
+            text << in.rdbuf();
+            parseMake(text.str(), buildDir, deps);
+        }
+        return deps;
+    }
+
+    // Objects that include any of the given files (absolute paths)
+    static std::vector<std::string> affected(const std::map<std::string, std::vector<std::string>> &deps,
+                                             const std::set<std::string> &changed)
+    {
+        std::vector<std::string> objects;
+        for (const auto &[object, files] : deps)
+        {
+            for (const auto &file : files)
+            {
+                if (changed.count(file))
+                {
+                    objects.push_back(object);
+                    break;
+                }
+            }
+        }
+        return objects;
+    }
+
+    static std::string normalize(const std::filesystem::path &path, const std::filesystem::path &base)
+    {
+        return (path.is_relative() ? base / path : path).lexically_normal().generic_string();
+    }
+
+private:
+    static bool endsWith(const std::string &value, const std::string &suffix)
+    {
+        return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // "object: dep dep \<newline> dep ...", with escaped spaces in paths
+    static void parseMake(const std::string &text, const std::filesystem::path &buildDir,
+                          std::map<std::string, std::vector<std::string>> &deps)
+    {
+        std::vector<std::string> words;
+        std::string word;
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            char c = text[i];
+            if (c == '\\' && i + 1 < text.size() && (text[i + 1] == ' ' || text[i + 1] == '#'))
+                word += text[++i];
+            else if (c == '\\' && i + 1 < text.size() && (text[i + 1] == '\n' || text[i + 1] == '\r'))
+                continue;
+            else if (c == '$' && i + 1 < text.size() && text[i + 1] == '$')
+                word += text[++i];
+            else if (std::isspace((unsigned char)c))
+            {
+                if (!word.empty())
+                    words.push_back(word);
+                word.clear();
+            }
+            else
+                word += c;
+        }
+        if (!word.empty())
+            words.push_back(word);
+
+        // Several rules may follow each other; a word ending in ':' starts one
+        std::vector<std::string> *current = nullptr;
+        for (auto &entry : words)
+        {
+            if (entry.size() > 1 && entry.back() == ':')
+            {
+                current = &deps[std::filesystem::path(entry.substr(0, entry.size() - 1)).generic_string()];
+                continue;
+            }
+            if (current)
+                current->push_back(normalize(entry, buildDir));
+        }
+    }
+
+    // "object: #deps N, deps mtime M (VALID)" followed by indented dependency lines
+    static void parseNinja(const std::string &text, const std::filesystem::path &buildDir,
+                           std::map<std::string, std::vector<std::string>> &deps)
+    {
+        std::istringstream lines(text);
+        std::vector<std::string> *current = nullptr;
+        for (std::string line; std::getline(lines, line);)
+        {
+            if (line.empty())
+                continue;
+            if (line[0] != ' ')
+            {
+                auto colon = line.find(": #deps");
+                current = colon == std::string::npos ? nullptr : &deps[line.substr(0, colon)];
+            }
+            else if (current)
+            {
+                current->push_back(normalize(line.substr(line.find_first_not_of(' ')), buildDir));
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,398 @@
+#ifndef BUILD_PROGRESS_HPP
+#define BUILD_PROGRESS_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "build_deps.hpp"
+#include "cmake_file_api.hpp"
+#include "compile_history.hpp"
+
+// Progress of a 'cmake --build' with the time left, predicted from how long each object
+// and link took in earlier builds (CompileHistory).
+//
+// Before the build starts, plan() works out what will run the way make does: objects
+// that are missing or older than a file their depfile lists, sources never compiled,
+// and the link of every target with work pending. The generator's "Building CXX object"
+// and "Linking" lines (Makefiles and Ninja) tell which jobs started; the launcher's
+// compile-times.tsv tells which finished. On a terminal a status line with the time
+// left and the running jobs that finish last is kept under the build output; otherwise
+// (CI logs) a progress line is printed every interval.
+class BuildProgress
+{
+public:
+    struct Plan
+    {
+        std::map<std::string, double> objects; // Relative to the build directory -> expected ms
+        size_t unknownObjects = 0;             // Sources never compiled (object names unknown)
+        std::map<std::string, double> links;   // Artifacts relative to the build directory -> expected ms
+    };
+
+    static Plan plan(const std::filesystem::path &buildDir, const std::vector<CMakeFileApi::Target> &targets,
+                     const CompileHistory &history, bool clean)
+    {
+        Plan plan;
+        double fallback = history.typical();
+        auto deps = BuildDeps::load(buildDir);
+        std::set<std::string> compiled; // Sources some object was built from
+        for (const auto &[object, files] : deps)
+        {
+            compiled.insert(files.begin(), files.end());
+            std::error_code ec;
+            auto built = std::filesystem::last_write_time(buildDir / object, ec);
+            bool stale = clean || ec;
+            for (size_t i = 0; !stale && i < files.size(); i++)
+            {
+                std::error_code depEc;
+                auto changed = std::filesystem::last_write_time(files[i], depEc);
+                stale = depEc || changed > built;
+            }
+            double ms = history.duration(object);
+            if (stale)
+                plan.objects[object] = ms >= 0 ? ms : fallback;
+        }
+
+        auto buildRoot = std::filesystem::absolute(buildDir).lexically_normal();
+        for (const auto &target : targets)
+        {
+            size_t pending = 0;
+            for (const auto &source : target.sources)
+            {
+                auto normalized = BuildDeps::normalize(source, buildRoot);
+                if (!compiled.count(normalized))
+                {
+                    plan.unknownObjects++;
+                    pending++;
+                }
+            }
+            // Objects of this target are the ones under its CMakeFiles/<name>.dir/
+            for (const auto &[object, ms] : plan.objects)
+                if (object.find("CMakeFiles/" + target.name + ".dir/") != std::string::npos)
+                    pending++;
+            for (const auto &artifact : target.artifacts)
+            {
+                if (target.type != "EXECUTABLE" && target.type.find("LIBRARY") == std::string::npos)
+                    continue;
+                auto relative = artifact.lexically_normal().lexically_relative(buildRoot).generic_string();
+                if (pending > 0 || clean || !std::filesystem::exists(artifact))
+                    plan.links[relative] = std::max(0.0, history.duration(relative));
+            }
+        }
+        return plan;
+    }
+
+    BuildProgress(const std::filesystem::path &buildDir, Plan plan, const CompileHistory &history, unsigned jobs, bool terminal,
+                  std::chrono::seconds interval = std::chrono::seconds(10))
+        : buildDir(buildDir), pending(std::move(plan.objects)), links(std::move(plan.links)), unknown(plan.unknownObjects),
+          typical(history.typical()), timed(!history.empty()), jobs(std::max(1u, jobs)), terminal(terminal), interval(interval)
+    {
+        total = pending.size() + unknown;
+        std::error_code ec;
+        timesOffset = std::filesystem::file_size(CompileHistory::file(buildDir), ec);
+        if (ec)
+            timesOffset = 0;
+        started = lastReport = std::chrono::steady_clock::now();
+        predicted = remaining();
+    }
+
+    // Milliseconds the whole build was expected to take when it started
+    double predictedMs() const
+    {
+        return predicted;
+    }
+
+    // One line of build output: shown, and read for jobs starting
+    void output(const std::string &line)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        clearStatus();
+        std::cout << line << '\n';
+        parse(stripColors(line));
+        render(false);
+    }
+
+    // Called periodically while the build runs, to keep the estimate moving between output lines
+    void tick()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        render(false);
+    }
+
+    void finish(bool succeeded)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        collectFinished();
+        clearStatus();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        if (succeeded && compiledCount > 0)
+        {
+            std::cout << "Compiled " << compiledCount << " object" << (compiledCount == 1 ? "" : "s") << " in " << formatDuration(ms);
+            if (timed)
+                std::cout << " (predicted " << formatDuration(predicted) << ")";
+            std::cout << "." << std::endl;
+        }
+        std::cout << std::flush;
+    }
+
+private:
+    struct Job
+    {
+        std::string name;
+        double expectedMs;
+        std::chrono::steady_clock::time_point started;
+        bool link;
+    };
+
+    std::filesystem::path buildDir;
+    std::map<std::string, double> pending;
+    std::map<std::string, double> links;
+    size_t unknown;
+    double typical;
+    bool timed;
+    unsigned jobs;
+    bool terminal;
+    std::chrono::seconds interval;
+
+    std::mutex lock;
+    std::vector<Job> running;
+    size_t total = 0;
+    size_t compiledCount = 0;
+    uintmax_t timesOffset = 0;
+    std::string partialLine;
+    bool statusShown = false;
+    double predicted = 0;
+    double actualMs = 0;   // Finished jobs of this build: their durations
+    double expectedMs = 0; // and what the history predicted for them
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point lastReport;
+    std::chrono::steady_clock::time_point lastRender;
+
+    void parse(const std::string &line)
+    {
+        static const std::regex building(R"(Building \w+ object (.+?)\s*$)");
+        static const std::regex linking(R"(Linking \w+ (?:executable|shared library|shared module|static library) (.+?)\s*$)");
+        std::smatch match;
+        if (std::regex_search(line, match, building))
+        {
+            std::string object = std::filesystem::path(match[1].str()).generic_string();
+            double ms = typical;
+            auto found = pending.find(object);
+            if (found != pending.end())
+            {
+                ms = found->second;
+                pending.erase(found);
+            }
+            else if (unknown > 0)
+            {
+                unknown--;
+            }
+            else
+            {
+                total++; // Something plan() did not foresee
+            }
+            start(object, ms, false);
+            compiledCount++;
+        }
+        else if (std::regex_search(line, match, linking))
+        {
+            std::string artifact = std::filesystem::path(match[1].str()).generic_string();
+            double ms = 0;
+            auto found = links.find(artifact);
+            if (found != links.end())
+            {
+                ms = found->second;
+                links.erase(found);
+            }
+            start(artifact, ms, true);
+        }
+    }
+
+    void start(const std::string &name, double expectedMs, bool link)
+    {
+        collectFinished();
+        // Without the launcher nothing reports back; the oldest job must be done once all slots are taken
+        if (running.size() >= jobs)
+            running.erase(running.begin());
+        running.push_back({name, expectedMs, std::chrono::steady_clock::now(), link});
+    }
+
+    // Jobs the launcher has recorded as finished since the last look
+    void collectFinished()
+    {
+        std::ifstream in(CompileHistory::file(buildDir), std::ios::binary);
+        if (!in)
+            return;
+        in.seekg(0, std::ios::end);
+        auto size = uintmax_t(in.tellg());
+        if (size <= timesOffset)
+            return;
+        in.seekg(std::streamoff(timesOffset));
+        std::string appended(size - timesOffset, '\0');
+        in.read(&appended[0], std::streamsize(appended.size()));
+        timesOffset = size;
+
+        partialLine += appended;
+        size_t newline;
+        while ((newline = partialLine.find('\n')) != std::string::npos)
+        {
+            std::string entry = partialLine.substr(0, newline);
+            partialLine.erase(0, newline + 1);
+            auto tab = entry.rfind('\t');
+            if (tab == std::string::npos)
+                continue;
+            std::string name = entry.substr(0, tab);
+            auto job = std::find_if(running.begin(), running.end(), [&](const Job &candidate)
+                                    { return candidate.name == name; });
+            if (job == running.end())
+                continue;
+            // How this build compares with the recorded ones (load, cache state) scales what is left
+            if (job->expectedMs > 0)
+            {
+                actualMs += std::atof(entry.c_str() + tab + 1);
+                expectedMs += job->expectedMs;
+            }
+            running.erase(job);
+        }
+    }
+
+    // Recorded durations times this factor predict this build's; 1 until a job has finished
+    double pace() const
+    {
+        return expectedMs > 0 ? actualMs / expectedMs : 1.0;
+    }
+
+    // Milliseconds left: the queued work spread over the job slots, but never less than the running job
+    // that finishes last, then the links (which wait for their objects)
+    double remaining() const
+    {
+        double scale = pace();
+        auto now = std::chrono::steady_clock::now();
+        double queued = typical * double(unknown) * scale;
+        for (const auto &[object, ms] : pending)
+            queued += ms * scale;
+        double longest = 0;
+        for (const auto &job : running)
+        {
+            double left = std::max(0.0, job.expectedMs * scale - std::chrono::duration<double, std::milli>(now - job.started).count());
+            queued += left;
+            longest = std::max(longest, left);
+        }
+        double linking = 0;
+        for (const auto &[artifact, ms] : links)
+            linking += ms * scale;
+        return std::max(queued / jobs, longest) + linking;
+    }
+
+    // Running jobs by expected time left, longest first: the ones holding the build up
+    std::vector<Job> criticalJobs() const
+    {
+        auto now = std::chrono::steady_clock::now();
+        auto left = [&](const Job &job)
+        { return job.expectedMs * pace() - std::chrono::duration<double, std::milli>(now - job.started).count(); };
+        std::vector<Job> jobsLeft(running.begin(), running.end());
+        std::stable_sort(jobsLeft.begin(), jobsLeft.end(), [&](const Job &a, const Job &b)
+                         { return left(a) > left(b); });
+        return jobsLeft;
+    }
+
+    std::string summary(size_t shownJobs) const
+    {
+        std::ostringstream out;
+        size_t compiling = std::count_if(running.begin(), running.end(), [](const Job &job)
+                                         { return !job.link; });
+        out << "[" << compiledCount - compiling << "/" << total << "]";
+        if (timed)
+            out << " about " << formatDuration(remaining()) << " left";
+        auto critical = criticalJobs();
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < critical.size() && i < shownJobs; i++)
+        {
+            double elapsed = std::chrono::duration<double, std::milli>(now - critical[i].started).count();
+            out << (i == 0 ? " | " : ", ") << std::filesystem::path(critical[i].name).filename().string() << " "
+                << formatDuration(elapsed);
+            if (timed && critical[i].expectedMs > 0)
+                out << "/" << formatDuration(critical[i].expectedMs * pace());
+        }
+        return out.str();
+    }
+
+    void render(bool force)
+    {
+        if (total == 0 && running.empty())
+            return;
+        auto now = std::chrono::steady_clock::now();
+        if (!terminal)
+        {
+            if (!force && now - lastReport < interval)
+                return;
+            lastReport = now;
+            collectFinished();
+            std::cout << "Progress: " << summary(3) << std::endl;
+            return;
+        }
+        // Redrawn at most ten times a second however fast output scrolls
+        if (!force && statusShown && now - lastRender < std::chrono::milliseconds(100))
+            return;
+        lastRender = now;
+        collectFinished();
+        std::string status = summary(2);
+        const size_t width = 100;
+        if (status.size() > width)
+            status = status.substr(0, width - 3) + "...";
+        std::cout << "\r\x1B[K" << status << std::flush;
+        statusShown = true;
+    }
+
+    void clearStatus()
+    {
+        if (!statusShown)
+            return;
+        std::cout << "\r\x1B[K";
+        statusShown = false;
+    }
+
+    static std::string stripColors(const std::string &line)
+    {
+        std::string plain;
+        for (size_t i = 0; i < line.size(); i++)
+        {
+            if (line[i] == '\x1B' && i + 1 < line.size() && line[i + 1] == '[')
+            {
+                for (i += 2; i < line.size() && !std::isalpha((unsigned char)line[i]); i++)
+                {
+                }
+                continue;
+            }
+            plain += line[i];
+        }
+        return plain;
+    }
+
+    static std::string formatDuration(double ms)
+    {
+        std::ostringstream out;
+        if (ms < 1000)
+            out << std::fixed << std::setprecision(0) << ms << " ms";
+        else if (ms < 60000)
+            out << std::fixed << std::setprecision(1) << ms / 1000 << " s";
+        else
+            out << int(ms / 60000) << " min " << int(ms / 1000) % 60 << " s";
+        return out.str();
+    }
+};
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef CHILD_PROCESS_HPP
+#define CHILD_PROCESS_HPP
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// A shell command running in its own process group, so it can be waited on
+// without blocking, or cancelled together with everything it spawned (cmake ->
+// make -> compilers). On Windows it degrades to a blocking std::system call that
+// cannot be cancelled.
+class ChildProcess
+{
+private:
+#ifndef _WIN32
+    pid_t pid = -1;
+#endif
+    bool running = false;
+    int exitCode = -1;
+    uint64_t peakRss = 0;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::duration elapsed{};
+
+    void finish(int status)
+    {
+        running = false;
+        elapsed = std::chrono::steady_clock::now() - started;
+#ifndef _WIN32
+        if (WIFEXITED(status))
+            exitCode = WEXITSTATUS(status);
+        else
+            exitCode = 128 + (WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+#else
+        exitCode = status;
+#endif
+    }
+
+public:
+    ChildProcess() = default;
+    ChildProcess(const ChildProcess &) = delete;
+    ChildProcess &operator=(const ChildProcess &) = delete;
+
+    ~ChildProcess()
+    {
+        if (running)
+            cancel();
+    }
+
+    void start(const std::string &command)
+    {
+        if (running)
+            throw std::runtime_error("Process already running");
+        started = std::chrono::steady_clock::now();
+        exitCode = -1;
+        peakRss = 0;
+#ifdef _WIN32
+        running = true;
+        finish(std::system(command.c_str()));
+#else
+        pid = ::fork();
+        if (pid < 0)
+            throw std::runtime_error("Failed to start: " + command);
+        if (pid == 0)
+        {
+            ::setpgid(0, 0);
+            ::execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char *>(nullptr));
+            ::_exit(127);
+        }
+        // Also set from the parent so cancel() cannot race the child's own setpgid
+        ::setpgid(pid, pid);
+        running = true;
+#endif
+    }
+
+    bool isRunning() const
+    {
+        return running;
+    }
+
+    // Non-blocking; returns true once the process has exited
+    bool poll()
+    {
+#ifndef _WIN32
+        if (!running)
+            return true;
+        int status = 0;
+        struct rusage usage
+        {
+        };
+        pid_t done = ::wait4(pid, &status, WNOHANG, &usage);
+        if (done == pid)
+        {
+            peakRss = uint64_t(usage.ru_maxrss) * 1024;
+            finish(status);
+        }
+#endif
+        return !running;
+    }
+
+    int wait()
+    {
+#ifndef _WIN32
+        if (running)
+        {
+            int status = 0;
+            struct rusage usage
+            {
+            };
+            while (::wait4(pid, &status, 0, &usage) < 0 && errno == EINTR)
+            {
+            }
+            peakRss = uint64_t(usage.ru_maxrss) * 1024;
+            finish(status);
+        }
+#endif
+        return exitCode;
+    }
+
+    // Terminate the whole process group, escalating to SIGKILL if it lingers
+    void cancel()
+    {
+#ifndef _WIN32
+        if (!running)
+            return;
+        ::kill(-pid, SIGTERM);
+        for (int i = 0; i < 50 && !poll(); i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (running)
+        {
+            ::kill(-pid, SIGKILL);
+            wait();
+        }
+#endif
+    }
+
+    int result() const
+    {
+        return exitCode;
+    }
+
+    // Peak resident set size of the process (largest child on Linux), 0 when unknown
+    uint64_t peakRssBytes() const
+    {
+        return peakRss;
+    }
+
+    std::chrono::steady_clock::duration duration() const
+    {
+        return elapsed;
+    }
+
+    // Time since start while running, the final duration afterwards
+    std::chrono::steady_clock::duration runningFor() const
+    {
+        return running ? std::chrono::steady_clock::now() - started : elapsed;
+    }
+
+    // Run to completion and return the exit code
+    static int run(const std::string &command)
+    {
+        ChildProcess process;
+        process.start(command);
+        return process.wait();
+    }
+};
+
+#endif
@@ -0,0 +1,377 @@
+#ifndef CHUNK_STORE_HPP
+#define CHUNK_STORE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "json.hpp"
+#include "sha256.hpp"
+
+#ifdef __linux__
+#include <fcntl.h>
+#endif
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// Content-defined chunk store for large package files (prebuilt archives).
+//
+// Files are split with FastCDC (Gear rolling hash + normalized chunking), so an
+// edit in the middle of an archive only changes the chunks around it. Each chunk
+// is stored once under chunks/<aa>/<sha256>, and every stored file gets a recipe
+// under files/<aa>/<sha256>.json listing its chunks in order.
+class ChunkStore
+{
+public:
+    struct Chunk
+    {
+        std::string hash;
+        uint64_t size = 0;
+    };
+
+    struct PutResult
+    {
+        std::string digest;
+        uint64_t bytes = 0;
+        uint64_t newBytes = 0;
+        size_t chunks = 0;
+        size_t newChunks = 0;
+    };
+
+    struct Stats
+    {
+        size_t files = 0;
+        size_t chunks = 0;
+        uint64_t logicalBytes = 0;  // Sum of all stored file sizes
+        uint64_t physicalBytes = 0; // Bytes actually on disk in chunks/
+
+        double dedupRatio() const
+        {
+            return physicalBytes == 0 ? 1.0 : double(logicalBytes) / double(physicalBytes);
+        }
+    };
+
+    // Chunk size targets; archives smaller than minSize are stored as a single chunk
+    static constexpr size_t minSize = 16 * 1024;
+    static constexpr size_t avgSize = 64 * 1024;
+    static constexpr size_t maxSize = 256 * 1024;
+
+    explicit ChunkStore(std::filesystem::path root) : root(std::move(root)) {}
+
+    const std::filesystem::path &directory() const
+    {
+        return root;
+    }
+
+    bool contains(const std::string &digest) const
+    {
+        return std::filesystem::exists(recipePath(digest));
+    }
+
+    // Chunk a file into the store and return its digest plus what was new
+    PutResult put(const std::filesystem::path &file)
+    {
+        std::ifstream in(file, std::ios::binary);
+        if (!in)
+            throw std::runtime_error("Cannot open file for storing: " + file.string());
+
+        PutResult result;
+        Sha256 fileHasher;
+        nlohmann::json chunks = nlohmann::json::array();
+
+        // Sliding window holding at least maxSize bytes whenever the file has them
+        std::vector<unsigned char> buffer(maxSize * 4);
+        size_t begin = 0, end = 0;
+        bool eof = false;
+
+        while (true)
+        {
+            if (!eof && end - begin < maxSize)
+            {
+                std::copy(buffer.begin() + begin, buffer.begin() + end, buffer.begin());
+                end -= begin;
+                begin = 0;
+                in.read(reinterpret_cast<char *>(buffer.data() + end), static_cast<std::streamsize>(buffer.size() - end));
+                end += static_cast<size_t>(in.gcount());
+                eof = !in;
+            }
+            if (begin == end)
+                break;
+
+            size_t length = cutPoint(buffer.data() + begin, end - begin);
+            const unsigned char *data = buffer.data() + begin;
+            fileHasher.update(data, length);
+
+            Sha256 chunkHasher;
+            chunkHasher.update(data, length);
+            std::string hash = chunkHasher.hexDigest();
+
+            if (writeChunk(hash, data, length))
+            {
+                result.newChunks++;
+                result.newBytes += length;
+            }
+            result.chunks++;
+            result.bytes += length;
+            chunks.push_back({{"hash", hash}, {"size", length}});
+            begin += length;
+        }
+
+        result.digest = fileHasher.hexDigest();
+        std::filesystem::path recipe = recipePath(result.digest);
+        if (!std::filesystem::exists(recipe))
+        {
+            nlohmann::json manifest;
+            manifest["size"] = result.bytes;
+            manifest["chunks"] = chunks;
+            writeAtomically(recipe, manifest.dump());
+        }
+        return result;
+    }
+
+    std::vector<Chunk> recipe(const std::string &digest) const
+    {
+        std::ifstream in(recipePath(digest));
+        if (!in)
+            throw std::runtime_error("No such object in store: " + digest);
+
+        nlohmann::json manifest;
+        in >> manifest;
+        std::vector<Chunk> chunks;
+        for (const auto &entry : manifest["chunks"])
+            chunks.push_back({entry["hash"].get<std::string>(), entry["size"].get<uint64_t>()});
+        return chunks;
+    }
+
+    // Reassemble a stored file at target (written to a temp file and renamed into place)
+    void materialize(const std::string &digest, const std::filesystem::path &target) const
+    {
+        std::filesystem::path temp = target;
+        temp += ".tegen-tmp";
+
+        {
+#ifdef __linux__
+            int out = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (out < 0)
+                throw std::runtime_error("Cannot create " + temp.string());
+            for (const auto &chunk : recipe(digest))
+            {
+                // copy_file_range lets reflink-capable filesystems share extents instead of copying
+                int in = ::open(chunkPath(chunk.hash).c_str(), O_RDONLY | O_CLOEXEC);
+                if (in < 0)
+                {
+                    ::close(out);
+                    throw std::runtime_error("Missing chunk " + chunk.hash + " for " + digest);
+                }
+                bool ok = copyRange(in, out, chunk.size);
+                ::close(in);
+                if (!ok)
+                {
+                    ::close(out);
+                    throw std::runtime_error("Failed to write " + temp.string());
+                }
+            }
+            ::close(out);
+#else
+            std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+            for (const auto &chunk : recipe(digest))
+            {
+                std::ifstream in(chunkPath(chunk.hash), std::ios::binary);
+                if (!in)
+                    throw std::runtime_error("Missing chunk " + chunk.hash + " for " + digest);
+                out << in.rdbuf();
+            }
+            if (!out)
+                throw std::runtime_error("Failed to write " + temp.string());
+#endif
+        }
+        std::filesystem::rename(temp, target);
+    }
+
+    Stats stats() const
+    {
+        Stats stats;
+        std::error_code ec;
+        auto filesDir = root / "files";
+        if (std::filesystem::exists(filesDir, ec))
+        {
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(filesDir, ec))
+            {
+                if (!entry.is_regular_file() || entry.path().extension() != ".json")
+                    continue;
+                std::ifstream in(entry.path());
+                nlohmann::json manifest = nlohmann::json::parse(in, nullptr, false);
+                if (manifest.is_discarded())
+                    continue;
+                stats.files++;
+                stats.logicalBytes += manifest.value("size", uint64_t(0));
+            }
+        }
+
+        auto chunksDir = root / "chunks";
+        if (std::filesystem::exists(chunksDir, ec))
+        {
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(chunksDir, ec))
+            {
+                if (!entry.is_regular_file())
+                    continue;
+                stats.chunks++;
+                stats.physicalBytes += entry.file_size();
+            }
+        }
+        return stats;
+    }
+
+    // Length of the next chunk at data[0..size), following FastCDC's normalized chunking
+    static size_t cutPoint(const unsigned char *data, size_t size)
+    {
+        if (size <= minSize)
+            return size;
+
+        // More mask bits before the average size make early cuts rarer, fewer after make late cuts likelier
+        constexpr uint64_t maskS = 0x0003590703530000ULL; // 15 bits
+        constexpr uint64_t maskL = 0x0000d90003530000ULL; // 11 bits
+
+        size_t normal = std::min(size, avgSize);
+        size_t limit = std::min(size, maxSize);
+        const auto &gear = gearTable();
+        uint64_t fp = 0;
+        size_t i = minSize;
+
+        for (; i < normal; i++)
+        {
+            fp = (fp << 1) + gear[data[i]];
+            if (!(fp & maskS))
+                return i + 1;
+        }
+        for (; i < limit; i++)
+        {
+            fp = (fp << 1) + gear[data[i]];
+            if (!(fp & maskL))
+                return i + 1;
+        }
+        return limit;
+    }
+
+private:
+    std::filesystem::path root;
+
+    static const std::array<uint64_t, 256> &gearTable()
+    {
+        // Fixed pseudo-random table so chunk boundaries are stable across machines and releases
+        static const std::array<uint64_t, 256> table = []
+        {
+            std::array<uint64_t, 256> values{};
+            uint64_t seed = 0x9e3779b97f4a7c15ULL;
+            for (auto &value : values)
+            {
+                seed += 0x9e3779b97f4a7c15ULL;
+                uint64_t z = seed;
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                value = z ^ (z >> 31);
+            }
+            return values;
+        }();
+        return table;
+    }
+
+    std::filesystem::path chunkPath(const std::string &hash) const
+    {
+        return root / "chunks" / hash.substr(0, 2) / hash;
+    }
+
+    std::filesystem::path recipePath(const std::string &digest) const
+    {
+        return root / "files" / digest.substr(0, 2) / (digest + ".json");
+    }
+
+    // Returns true when the chunk was not already present
+    bool writeChunk(const std::string &hash, const unsigned char *data, size_t size)
+    {
+        std::filesystem::path path = chunkPath(hash);
+        if (std::filesystem::exists(path))
+            return false;
+        writeAtomically(path, std::string(reinterpret_cast<const char *>(data), size));
+        return true;
+    }
+
+    // Concurrent installs may write the same chunk or recipe; each writer gets its own temp file, and since
+    // the contents are the same whichever rename lands last wins harmlessly
+    static void writeAtomically(const std::filesystem::path &path, const std::string &contents)
+    {
+        static std::atomic<unsigned> counter{0};
+        std::filesystem::create_directories(path.parent_path());
+        std::filesystem::path temp = path;
+        temp += ".tmp-" + std::to_string(processId()) + "-" + std::to_string(counter++);
+        {
+            std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+            out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+            if (!out)
+                throw std::runtime_error("Failed to write " + temp.string());
+        }
+        std::error_code ec;
+        std::filesystem::rename(temp, path, ec);
+        if (ec)
+        {
+            std::filesystem::remove(temp, ec);
+            if (!std::filesystem::exists(path))
+                throw std::runtime_error("Failed to store " + path.string());
+        }
+    }
+
+    static long processId()
+    {
+#ifdef _WIN32
+        return long(::_getpid());
+#else
+        return long(::getpid());
+#endif
+    }
+
+#ifdef __linux__
+    static bool copyRange(int in, int out, uint64_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t copied = ::copy_file_range(in, nullptr, out, nullptr, size, 0);
+            if (copied <= 0)
+                return copied == 0 ? false : copyFallback(in, out, size);
+            size -= static_cast<uint64_t>(copied);
+        }
+        return true;
+    }
+
+    // Plain read/write for filesystems or kernels that reject copy_file_range
+    static bool copyFallback(int in, int out, uint64_t size)
+    {
+        char buffer[1 << 16];
+        while (size > 0)
+        {
+            ssize_t got = ::read(in, buffer, std::min<uint64_t>(size, sizeof(buffer)));
+            if (got <= 0)
+                return false;
+            for (ssize_t written = 0; written < got;)
+            {
+                ssize_t n = ::write(out, buffer + written, static_cast<size_t>(got - written));
+                if (n <= 0)
+                    return false;
+                written += n;
+            }
+            size -= static_cast<uint64_t>(got);
+        }
+        return true;
+    }
+#endif
+};
+
+#endif
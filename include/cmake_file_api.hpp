@@ -0,0 +1,170 @@
+#ifndef CMAKE_FILE_API_HPP
+#define CMAKE_FILE_API_HPP
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "json.hpp"
+
+// Reads CMake's File API codemodel so Tegen knows the project's real targets and
+// where their artifacts land, without guessing build/<project name>.
+//
+// writeQuery() drops a stateless query into the build tree. Every configure after
+// that (including the ones 'cmake --build' triggers on its own) writes a fresh reply.
+class CMakeFileApi
+{
+public:
+    struct Target
+    {
+        std::string name;
+        std::string type; // EXECUTABLE, STATIC_LIBRARY, SHARED_LIBRARY, UTILITY, ...
+        std::vector<std::filesystem::path> artifacts; // Absolute paths
+        std::vector<std::filesystem::path> sources;   // Absolute paths of compiled sources
+    };
+
+    explicit CMakeFileApi(std::filesystem::path buildDir) : buildDir(std::move(buildDir)) {}
+
+    void writeQuery() const
+    {
+        auto client = apiDir() / "query" / ("client-" + std::string(clientName));
+        std::filesystem::create_directories(client);
+        for (const char *object : {"codemodel-v2", "cmakeFiles-v1"})
+        {
+            if (!std::filesystem::exists(client / object))
+                std::ofstream(client / object).close();
+        }
+    }
+
+    bool hasQuery() const
+    {
+        return std::filesystem::exists(apiDir() / "query" / ("client-" + std::string(clientName)) / "codemodel-v2");
+    }
+
+    bool hasReply() const
+    {
+        return !latestIndex().empty();
+    }
+
+    // Targets of the first (or named) configuration in the latest reply
+    std::vector<Target> targets(const std::string &configuration = "") const
+    {
+        auto index = latestIndex();
+        if (index.empty())
+            throw std::runtime_error("No CMake File API reply in " + buildDir.string() + "; configure the project first");
+
+        auto replyDir = index.parent_path();
+        json indexJson = read(index);
+        auto client = indexJson["reply"].value("client-" + std::string(clientName), json::object());
+        if (!client.contains("codemodel-v2") || !client["codemodel-v2"].contains("jsonFile"))
+            throw std::runtime_error("CMake File API reply has no codemodel; reconfigure the project");
+
+        json codemodel = read(replyDir / client["codemodel-v2"]["jsonFile"].get<std::string>());
+        std::filesystem::path topBuild = codemodel["paths"].value("build", buildDir.string());
+        std::filesystem::path topSource = codemodel["paths"].value("source", std::string());
+
+        const json *selected = nullptr;
+        for (const auto &config : codemodel["configurations"])
+        {
+            if (!selected || config.value("name", "") == configuration)
+                selected = &config;
+        }
+        if (!selected)
+            return {};
+
+        std::vector<Target> result;
+        for (const auto &entry : (*selected)["targets"])
+        {
+            json targetJson = read(replyDir / entry["jsonFile"].get<std::string>());
+            Target target;
+            target.name = targetJson.value("name", "");
+            target.type = targetJson.value("type", "");
+            for (const auto &artifact : targetJson.value("artifacts", json::array()))
+            {
+                std::filesystem::path path = artifact.value("path", "");
+                target.artifacts.push_back(path.is_absolute() ? path : topBuild / path);
+            }
+            for (const auto &source : targetJson.value("sources", json::array()))
+            {
+                if (!source.contains("compileGroupIndex"))
+                    continue;
+                std::filesystem::path path = source.value("path", "");
+                target.sources.push_back(path.is_absolute() ? path : topSource / path);
+            }
+            result.push_back(std::move(target));
+        }
+        return result;
+    }
+
+    // CMakeLists.txt and .cmake files of the project itself (absolute), as read by the last configure
+    std::vector<std::filesystem::path> cmakeFiles() const
+    {
+        auto index = latestIndex();
+        if (index.empty())
+            return {};
+        json indexJson = read(index);
+        auto client = indexJson["reply"].value("client-" + std::string(clientName), json::object());
+        if (!client.contains("cmakeFiles-v1") || !client["cmakeFiles-v1"].contains("jsonFile"))
+            return {};
+
+        json files = read(index.parent_path() / client["cmakeFiles-v1"]["jsonFile"].get<std::string>());
+        std::filesystem::path topSource = files["paths"].value("source", std::string());
+        std::vector<std::filesystem::path> result;
+        for (const auto &input : files.value("inputs", json::array()))
+        {
+            if (input.value("isExternal", false) || input.value("isGenerated", false) || input.value("isCMake", false))
+                continue;
+            std::filesystem::path path = input.value("path", "");
+            result.push_back(path.is_absolute() ? path : topSource / path);
+        }
+        return result;
+    }
+
+    std::vector<Target> executables(const std::string &configuration = "") const
+    {
+        auto all = targets(configuration);
+        all.erase(std::remove_if(all.begin(), all.end(), [](const Target &target)
+                                 { return target.type != "EXECUTABLE" || target.artifacts.empty(); }),
+                  all.end());
+        return all;
+    }
+
+private:
+    using json = nlohmann::json;
+    static constexpr const char *clientName = "tegen";
+
+    std::filesystem::path buildDir;
+
+    std::filesystem::path apiDir() const
+    {
+        return buildDir / ".cmake" / "api" / "v1";
+    }
+
+    // CMake documents that the index file with the lexicographically largest name is current
+    std::filesystem::path latestIndex() const
+    {
+        std::error_code ec;
+        std::filesystem::path latest;
+        for (const auto &entry : std::filesystem::directory_iterator(apiDir() / "reply", ec))
+        {
+            auto name = entry.path().filename().string();
+            if (name.rfind("index-", 0) == 0 && entry.path().extension() == ".json" && (latest.empty() || entry.path() > latest))
+                latest = entry.path();
+        }
+        return latest;
+    }
+
+    static json read(const std::filesystem::path &file)
+    {
+        std::ifstream in(file);
+        if (!in)
+            throw std::runtime_error("Cannot read CMake File API reply: " + file.string());
+        json value;
+        in >> value;
+        return value;
+    }
+};
+
+#endif
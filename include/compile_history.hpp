@@ -0,0 +1,237 @@
+#ifndef COMPILE_HISTORY_HPP
+#define COMPILE_HISTORY_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// How long each object file took to compile, recorded by tegen itself acting as the
+// compiler launcher (`tegen __compile <build dir> <source dir> <compiler> <args...>`,
+// wired in by the generated cmake/TegenCompileHistory.cmake). Each compile appends one
+// "<object>\t<milliseconds>" line to <build dir>/.tegen/compile-times.tsv; the newest
+// line for an object is its current duration.
+class CompileHistory
+{
+public:
+    explicit CompileHistory(const std::filesystem::path &buildDir)
+    {
+        std::ifstream in(file(buildDir));
+        for (std::string line; std::getline(in, line);)
+        {
+            auto tab = line.rfind('\t');
+            if (tab == std::string::npos)
+                continue;
+            durations[line.substr(0, tab)] = std::atof(line.c_str() + tab + 1);
+        }
+    }
+
+    static std::filesystem::path file(const std::filesystem::path &buildDir)
+    {
+        return buildDir / ".tegen" / "compile-times.tsv";
+    }
+
+    bool empty() const
+    {
+        return durations.empty();
+    }
+
+    // Milliseconds of the object's last compile, or -1 when it was never timed
+    double duration(const std::string &object) const
+    {
+        auto found = durations.find(object);
+        return found == durations.end() ? -1 : found->second;
+    }
+
+    // Median of the recorded durations, the guess for anything never timed (0 without history)
+    double typical() const
+    {
+        std::vector<double> known;
+        for (const auto &[object, ms] : durations)
+            known.push_back(ms);
+        std::sort(known.begin(), known.end());
+        return known.empty() ? 0 : known[known.size() / 2];
+    }
+
+    // Milliseconds for compiling all the objects; untimed ones count as the median of the timed ones
+    double estimate(const std::vector<std::string> &objects, size_t *timed = nullptr) const
+    {
+        double fallback = typical();
+        double total = 0;
+        size_t count = 0;
+        for (const auto &object : objects)
+        {
+            double ms = duration(object);
+            if (ms >= 0)
+                count++;
+            total += ms >= 0 ? ms : fallback;
+        }
+        if (timed)
+            *timed = count;
+        return total;
+    }
+
+    // Generated CMake module putting the launcher in front of every C and C++ compile and every link,
+    // ahead of any launcher the project already uses (ccache, ...). Links are keyed by their output.
+    static std::string cmakeModule(const std::string &tegen)
+    {
+        std::ostringstream out;
+        out << "# Generated by Tegen; times each compile and link for rebuild estimates and\n";
+        out << "# materializes lazily installed headers a compile misses.\n";
+        out << "if(EXISTS \"" << tegen << "\")\n";
+        out << "    get_property(_tegen_targets DIRECTORY \"${CMAKE_SOURCE_DIR}\" PROPERTY BUILDSYSTEM_TARGETS)\n";
+        out << "    foreach(_tegen_target IN LISTS _tegen_targets)\n";
+        out << "        get_target_property(_tegen_type ${_tegen_target} TYPE)\n";
+        out << "        if(_tegen_type STREQUAL \"INTERFACE_LIBRARY\" OR _tegen_type STREQUAL \"UTILITY\")\n";
+        out << "            continue()\n";
+        out << "        endif()\n";
+        out << "        foreach(_tegen_language C CXX)\n";
+        out << "            get_target_property(_tegen_launcher ${_tegen_target} ${_tegen_language}_COMPILER_LAUNCHER)\n";
+        out << "            if(NOT _tegen_launcher)\n";
+        out << "                set(_tegen_launcher \"\")\n";
+        out << "            endif()\n";
+        out << "            set_property(TARGET ${_tegen_target} PROPERTY ${_tegen_language}_COMPILER_LAUNCHER\n";
+        out << "                \"" << tegen << "\" __compile \"${CMAKE_BINARY_DIR}\" \"${CMAKE_SOURCE_DIR}\" ${_tegen_launcher})\n";
+        out << "        endforeach()\n";
+        out << "        if(_tegen_type STREQUAL \"EXECUTABLE\" OR _tegen_type MATCHES \"^(SHARED|MODULE)_LIBRARY$\")\n";
+        out << "            get_target_property(_tegen_launcher ${_tegen_target} RULE_LAUNCH_LINK)\n";
+        out << "            if(NOT _tegen_launcher)\n";
+        out << "                set(_tegen_launcher \"\")\n";
+        out << "            endif()\n";
+        out << "            set_property(TARGET ${_tegen_target} PROPERTY RULE_LAUNCH_LINK\n";
+        out << "                \"\\\"" << tegen << "\\\" __compile \\\"${CMAKE_BINARY_DIR}\\\" \\\"${CMAKE_SOURCE_DIR}\\\" ${_tegen_launcher}\")\n";
+        out << "        endif()\n";
+        out << "    endforeach()\n";
+        out << "endif()\n";
+        return out.str();
+    }
+
+    // Body of `tegen __compile`: run the compiler command in argv[4..], record its time, return its exit code.
+    // With retry, a failed compile's diagnostics are handed to it and the compile runs again for as long as
+    // it returns true; the diagnostics of the last attempt are passed on to stderr.
+    static int launch(int argc, char const *argv[], const std::function<bool(const std::string &)> &retry = nullptr)
+    {
+        if (argc < 5)
+            return 2;
+        std::filesystem::path buildDir = argv[2];
+        std::string object;
+        for (int i = 4; i + 1 < argc; i++)
+            if (std::string(argv[i]) == "-o")
+                object = argv[i + 1];
+        for (int i = 4; i < argc; i++)
+            if (std::string(argv[i]).rfind("/Fo", 0) == 0)
+                object = std::string(argv[i]).substr(3);
+
+        auto started = std::chrono::steady_clock::now();
+        int status = 0;
+        if (!retry || object.empty())
+        {
+            status = run(argc - 4, argv + 4);
+        }
+        else
+        {
+            // Next to the object, so parallel compiles never share it
+            std::string errors = object + ".stderr";
+            std::stringstream diagnostics;
+            do
+            {
+                started = std::chrono::steady_clock::now();
+                status = run(argc - 4, argv + 4, errors);
+                std::ifstream in(errors);
+                diagnostics.str("");
+                diagnostics << in.rdbuf();
+            } while (status != 0 && retry(diagnostics.str()));
+            std::error_code ec;
+            std::filesystem::remove(errors, ec);
+            std::cerr << diagnostics.str() << std::flush;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        if (status == 0 && !object.empty())
+            record(buildDir, relativeObject(object, buildDir), ms);
+        return status;
+    }
+
+private:
+    std::map<std::string, double> durations;
+
+    // Objects are keyed as the build tool names them: relative to the build directory
+    static std::string relativeObject(const std::string &object, const std::filesystem::path &buildDir)
+    {
+        std::filesystem::path path(object);
+        if (path.is_relative())
+            path = std::filesystem::current_path() / path;
+        auto relative = path.lexically_normal().lexically_relative(std::filesystem::path(buildDir).lexically_normal());
+        return relative.empty() ? object : relative.generic_string();
+    }
+
+    static void record(const std::filesystem::path &buildDir, const std::string &object, double ms)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(buildDir / ".tegen", ec);
+        // One small append per line, so concurrent compiles do not interleave
+        std::string line = object + "\t" + std::to_string(ms) + "\n";
+        if (FILE *out = std::fopen(file(buildDir).string().c_str(), "ab"))
+        {
+            std::fwrite(line.data(), 1, line.size(), out);
+            std::fclose(out);
+        }
+    }
+
+    // Run a command, its stderr going to errors when given
+    static int run(int argc, char const *argv[], const std::string &errors = "")
+    {
+#ifndef _WIN32
+        pid_t pid = ::fork();
+        if (pid == 0)
+        {
+            if (!errors.empty())
+            {
+                int fd = ::open(errors.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd >= 0)
+                {
+                    ::dup2(fd, STDERR_FILENO);
+                    ::close(fd);
+                }
+            }
+            std::vector<char *> args;
+            for (int i = 0; i < argc; i++)
+                args.push_back(const_cast<char *>(argv[i]));
+            args.push_back(nullptr);
+            ::execvp(args[0], args.data());
+            std::perror(argv[0]);
+            ::_exit(127);
+        }
+        if (pid < 0)
+            return 127;
+        int status = 0;
+        while (::waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+        return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + (WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+#else
+        std::string command;
+        for (int i = 0; i < argc; i++)
+            command += (i ? " \"" : "\"") + std::string(argv[i]) + "\"";
+        if (!errors.empty())
+            command += " 2>\"" + errors + "\"";
+        return std::system(("\"" + command + "\"").c_str());
+#endif
+    }
+};
+
+#endif
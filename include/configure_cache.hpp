@@ -0,0 +1,195 @@
+#ifndef CONFIGURE_CACHE_HPP
+#define CONFIGURE_CACHE_HPP
+
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// What CMake's first configure of a fresh build directory works out the slow way and gets
+// the same every time: compiler identification and ABI detection (the files in
+// CMakeFiles/<cmake version>/) and the results of try_compile style checks (check_include_file,
+// check_cxx_source_compiles, ...). After a configure they are kept in the global store under
+// configure-cache/<key>/, where the key covers the CMake and compiler fingerprints, the
+// generator, the flag environment and the project. A fresh build directory gets the files
+// copied back and the cache entries passed in with -C, so CMake skips those steps.
+class ConfigureCache
+{
+public:
+    static std::filesystem::path seedFile(const std::filesystem::path &buildDir)
+    {
+        return buildDir / ".tegen" / "configure-seed.cmake";
+    }
+
+    // Prepare a fresh build directory from the store. Returns the number of seeded check results, or -1
+    // when nothing was restored (the directory was configured before, or the store has no entry).
+    static int restore(const std::filesystem::path &buildDir, const std::filesystem::path &storeDir, const std::string &key)
+    {
+        auto entry = storeDir / "configure-cache" / key;
+        std::ifstream versionIn(entry / "version");
+        std::string version;
+        std::getline(versionIn, version);
+        if (std::filesystem::exists(buildDir / "CMakeCache.txt") || version.empty() || !std::filesystem::exists(entry / "seed.cmake"))
+            return -1;
+
+        std::error_code ec;
+        auto platform = buildDir / "CMakeFiles" / version;
+        std::filesystem::create_directories(platform);
+        for (const auto &file : std::filesystem::directory_iterator(entry / "files", ec))
+            std::filesystem::copy_file(file.path(), platform / file.path().filename(), std::filesystem::copy_options::overwrite_existing);
+        std::filesystem::create_directories(seedFile(buildDir).parent_path());
+        std::filesystem::copy_file(entry / "seed.cmake", seedFile(buildDir), std::filesystem::copy_options::overwrite_existing);
+
+        int checks = 0;
+        std::ifstream seed(entry / "seed.cmake");
+        for (std::string line; std::getline(seed, line);)
+            if (line.find("CACHE INTERNAL") != std::string::npos && line.rfind("set(CMAKE_", 0) != 0 && line.rfind("set(_CMAKE_", 0) != 0)
+                checks++;
+        return checks;
+    }
+
+    // Undo restore() after a configure that failed with the cached results
+    static void discard(const std::filesystem::path &buildDir)
+    {
+        std::error_code ec;
+        std::filesystem::remove(buildDir / "CMakeCache.txt", ec);
+        std::filesystem::remove_all(buildDir / "CMakeFiles", ec);
+        std::filesystem::remove(seedFile(buildDir), ec);
+    }
+
+    // Record a configured build directory's results under key; an existing entry only gets new check results
+    static void save(const std::filesystem::path &buildDir, const std::filesystem::path &storeDir, const std::string &key)
+    {
+        std::ifstream cacheIn(buildDir / "CMakeCache.txt");
+        std::stringstream cache;
+        cache << cacheIn.rdbuf();
+        std::string version = cacheValue(cache.str(), "CMAKE_CACHE_MAJOR_VERSION") + "." + cacheValue(cache.str(), "CMAKE_CACHE_MINOR_VERSION") +
+                              "." + cacheValue(cache.str(), "CMAKE_CACHE_PATCH_VERSION");
+        auto platform = buildDir / "CMakeFiles" / version;
+        if (!std::filesystem::exists(platform / "CMakeSystem.cmake"))
+            return;
+
+        auto entry = storeDir / "configure-cache" / key;
+        std::error_code ec;
+        if (!std::filesystem::exists(entry / "version"))
+        {
+            // Built aside and renamed into place, like everything else in the store
+            auto scratch = entry.string() + ".tmp-" + std::to_string(processId());
+            std::filesystem::remove_all(scratch, ec);
+            std::filesystem::create_directories(std::filesystem::path(scratch) / "files");
+            // The top-level files are what CMake reads back; CompilerId*/ are only the probes' leftovers
+            for (const auto &file : std::filesystem::directory_iterator(platform))
+                if (file.is_regular_file())
+                    std::filesystem::copy_file(file.path(), std::filesystem::path(scratch) / "files" / file.path().filename());
+            std::ofstream(std::filesystem::path(scratch) / "version") << version << "\n";
+            std::filesystem::create_directories(entry.parent_path());
+            std::filesystem::rename(scratch, entry, ec);
+            if (ec)
+                std::filesystem::remove_all(scratch, ec);
+        }
+
+        std::string seed = seedScript(cache.str(), cacheValue(cache.str(), "CMAKE_HOME_DIRECTORY"), cacheValue(cache.str(), "CMAKE_CACHEFILE_DIR"));
+        std::ifstream storedIn(entry / "seed.cmake");
+        std::stringstream stored;
+        stored << storedIn.rdbuf();
+        if (stored.str() == seed)
+            return;
+        auto temp = entry / ("seed.cmake." + std::to_string(processId()));
+        std::ofstream(temp) << seed;
+        std::filesystem::rename(temp, entry / "seed.cmake", ec);
+        if (ec)
+            std::filesystem::remove(temp, ec);
+    }
+
+    // -C script recreating the cache entries that come from toolchain detection and checks. Entries naming
+    // the source or build directory are left out, since the next checkout may live elsewhere.
+    static std::string seedScript(const std::string &cache, const std::string &sourceDir, const std::string &buildDir)
+    {
+        std::ostringstream out;
+        out << "# Generated by Tegen from an earlier configure with the same toolchain.\n";
+        out << "set(CMAKE_PLATFORM_INFO_INITIALIZED 1 CACHE INTERNAL \"Platform information initialized\")\n";
+        std::istringstream lines(cache);
+        std::string doc;
+        for (std::string line; std::getline(lines, line);)
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (line.rfind("//", 0) == 0)
+            {
+                doc = doc.empty() ? line.substr(2) : doc;
+                continue;
+            }
+            std::string entryDoc = doc;
+            doc.clear();
+            auto colon = line.find(':');
+            auto equals = line.find('=', colon == std::string::npos ? 0 : colon);
+            if (line.empty() || line[0] == '#' || colon == std::string::npos || equals == std::string::npos)
+                continue;
+            std::string name = line.substr(0, colon);
+            std::string type = line.substr(colon + 1, equals - colon - 1);
+            std::string value = line.substr(equals + 1);
+            if ((!sourceDir.empty() && value.find(sourceDir) != std::string::npos) ||
+                (!buildDir.empty() && value.find(buildDir) != std::string::npos))
+                continue;
+
+            // Tools found next to the compiler (ar, ranlib, nm, ld, ...) and the platform probes
+            bool tool = type == "FILEPATH" && name.rfind("CMAKE_", 0) == 0;
+            bool platform = type == "INTERNAL" && (name == "CMAKE_EXECUTABLE_FORMAT" || name == "CMAKE_UNAME" ||
+                                                   name == "_CMAKE_LINKER_PUSHPOP_STATE_SUPPORTED");
+            // The Check* modules describe their results this way
+            bool check = type == "INTERNAL" && name.rfind("CMAKE_", 0) != 0 &&
+                         (entryDoc.rfind("Have ", 0) == 0 || entryDoc.rfind("Test ", 0) == 0 || entryDoc.rfind("Result of ", 0) == 0);
+            if (!tool && !platform && !check)
+                continue;
+            out << "set(" << name << " " << quote(value) << " CACHE " << type << " " << quote(entryDoc) << ")\n";
+        }
+        return out.str();
+    }
+
+private:
+    static std::string cacheValue(const std::string &cache, const std::string &name)
+    {
+        std::istringstream lines(cache);
+        for (std::string line; std::getline(lines, line);)
+        {
+            if (line.rfind(name + ":", 0) != 0)
+                continue;
+            auto value = line.substr(line.find('=') + 1);
+            while (!value.empty() && std::isspace((unsigned char)value.back()))
+                value.pop_back();
+            return value;
+        }
+        return "";
+    }
+
+    static std::string quote(const std::string &value)
+    {
+        std::string quoted = "\"";
+        for (char c : value)
+        {
+            if (c == '\\' || c == '"' || c == '$')
+                quoted += '\\';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    static long processId()
+    {
+#ifdef _WIN32
+        return long(::_getpid());
+#else
+        return long(::getpid());
+#endif
+    }
+};
+
+#endif
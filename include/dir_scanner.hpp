@@ -0,0 +1,378 @@
+#ifndef DIR_SCANNER_HPP
+#define DIR_SCANNER_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Directory tree scanner producing a compact, sorted entry list.
+//
+// On Linux it reads directories with getdents64 relative to a root descriptor and
+// trusts d_type, so regular files and directories are classified without a stat
+// per entry. Subdirectories are handed to a small pool of workers, and relative
+// paths are interned in per-worker character arenas rather than allocated as one
+// std::filesystem::path each. Other platforms fall back to directory_iterator with
+// the same output.
+class DirScanner
+{
+public:
+    enum class EntryType : uint8_t
+    {
+        File,
+        Directory,
+        Other
+    };
+
+    struct Entry
+    {
+        uint32_t offset = 0; // Into the names arena
+        uint32_t length = 0;
+        EntryType type = EntryType::Other;
+        uint64_t size = 0; // Only filled for files when Options::sizes is set
+    };
+
+    struct Options
+    {
+        bool recursive = true;
+        bool sizes = false; // One fstatat per file; skip when sizes are not needed
+        unsigned threads = 0; // 0 picks from hardware_concurrency
+    };
+
+    class Result
+    {
+    public:
+        const std::filesystem::path &root() const
+        {
+            return rootPath;
+        }
+
+        const std::vector<Entry> &entries() const
+        {
+            return list;
+        }
+
+        size_t size() const
+        {
+            return list.size();
+        }
+
+        // Path relative to the root, using '/' separators
+        std::string_view relative(const Entry &entry) const
+        {
+            return std::string_view(names).substr(entry.offset, entry.length);
+        }
+
+        std::filesystem::path path(const Entry &entry) const
+        {
+            return rootPath / std::filesystem::path(std::string(relative(entry)));
+        }
+
+        size_t count(EntryType type) const
+        {
+            return size_t(std::count_if(list.begin(), list.end(), [type](const Entry &entry)
+                                        { return entry.type == type; }));
+        }
+
+    private:
+        friend class DirScanner;
+        std::filesystem::path rootPath;
+        std::string names;
+        std::vector<Entry> list;
+    };
+
+    // Entries are handed over as soon as their directory has been read, and a
+    // directory is always visited before any of its children. With more than one
+    // thread the visitor is called concurrently and must be thread-safe.
+    using Visitor = std::function<void(std::string_view relative, const Entry &entry)>;
+
+    // Streaming scan: nothing is accumulated, so memory stays flat however many entries there are
+    static void scan(const std::filesystem::path &root, const Options &options, const Visitor &visit)
+    {
+#ifdef __linux__
+        std::vector<Worker> workers;
+        walk(root, options, &visit, workers);
+#else
+        Entry entry;
+        iterate(root, options, [&](std::string relative, EntryType type, uint64_t size)
+                {
+            entry.length = static_cast<uint32_t>(relative.size());
+            entry.type = type;
+            entry.size = size;
+            visit(relative, entry); });
+#endif
+    }
+
+    static Result scan(const std::filesystem::path &root, const Options &options)
+    {
+        Result result;
+        result.rootPath = root;
+
+#ifdef __linux__
+        std::vector<Worker> workers;
+        walk(root, options, nullptr, workers);
+
+        // Merge worker arenas into one
+        size_t nameBytes = 0, entryCount = 0;
+        for (const auto &worker : workers)
+        {
+            nameBytes += worker.names.size();
+            entryCount += worker.entries.size();
+        }
+        result.names.reserve(nameBytes);
+        result.list.reserve(entryCount);
+        for (auto &worker : workers)
+        {
+            uint32_t base = static_cast<uint32_t>(result.names.size());
+            result.names += worker.names;
+            for (auto entry : worker.entries)
+            {
+                entry.offset += base;
+                result.list.push_back(entry);
+            }
+        }
+#else
+        iterate(root, options, [&](std::string relative, EntryType type, uint64_t size)
+                {
+            Entry entry;
+            entry.offset = static_cast<uint32_t>(result.names.size());
+            entry.length = static_cast<uint32_t>(relative.size());
+            entry.type = type;
+            entry.size = size;
+            result.names += relative;
+            result.list.push_back(entry); });
+#endif
+
+        // Parallel walks finish in any order; sort so callers see a stable listing
+        std::sort(result.list.begin(), result.list.end(), [&result](const Entry &a, const Entry &b)
+                  { return result.relative(a) < result.relative(b); });
+        return result;
+    }
+
+    static Result scan(const std::filesystem::path &root)
+    {
+        return scan(root, Options{});
+    }
+
+private:
+#ifdef __linux__
+    struct Worker
+    {
+        std::string names;
+        std::vector<Entry> entries;
+    };
+
+    static void walk(const std::filesystem::path &root, const Options &options, const Visitor *visit, std::vector<Worker> &workers)
+    {
+        int rootFd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (rootFd < 0)
+            throw std::runtime_error("Cannot open directory: " + root.string());
+
+        unsigned threads = options.threads ? options.threads : std::max(1u, std::min(8u, std::thread::hardware_concurrency()));
+        Walk walk;
+        walk.rootFd = rootFd;
+        walk.options = options;
+        walk.visit = visit;
+        walk.pending.push_back("");
+        walk.outstanding = 1;
+        workers.resize(threads);
+
+        if (threads == 1)
+        {
+            walk.run(workers[0]);
+        }
+        else
+        {
+            std::vector<std::thread> pool;
+            for (auto &worker : workers)
+                pool.emplace_back([&walk, &worker]
+                                  { walk.run(worker); });
+            for (auto &thread : pool)
+                thread.join();
+        }
+        ::close(rootFd);
+
+        if (walk.failure)
+            std::rethrow_exception(walk.failure);
+    }
+
+    // Shared queue of directories (relative to the root) still to be read
+    struct Walk
+    {
+        int rootFd = -1;
+        Options options;
+        std::mutex mutex;
+        std::condition_variable wake;
+        const Visitor *visit = nullptr;
+        std::vector<std::string> pending;
+        size_t outstanding = 0; // Queued plus in-progress directories
+        std::exception_ptr failure;
+
+        void run(Worker &worker)
+        {
+            std::vector<std::string> found;
+            while (true)
+            {
+                std::string directory;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [this]
+                              { return !pending.empty() || outstanding == 0; });
+                    if (pending.empty())
+                        return;
+                    directory = std::move(pending.back());
+                    pending.pop_back();
+                }
+
+                found.clear();
+                std::exception_ptr error;
+                try
+                {
+                    read(directory, worker, found);
+
+                    // Streaming callers get this directory's entries before its subdirectories are queued
+                    if (visit)
+                    {
+                        for (const auto &entry : worker.entries)
+                            (*visit)(std::string_view(worker.names).substr(entry.offset, entry.length), entry);
+                        worker.entries.clear();
+                        worker.names.clear();
+                    }
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                    found.clear();
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (error && !failure)
+                    failure = error;
+                if (failure)
+                    found.clear(); // Stop descending once anything failed
+                for (auto &sub : found)
+                    pending.push_back(std::move(sub));
+                outstanding += found.size();
+                outstanding--;
+                wake.notify_all();
+            }
+        }
+
+        void read(const std::string &directory, Worker &worker, std::vector<std::string> &subdirectories)
+        {
+            int fd = directory.empty() ? ::dup(rootFd) : ::openat(rootFd, directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd < 0)
+                throw std::runtime_error("Cannot open directory: " + directory);
+
+            struct LinuxDirent64
+            {
+                uint64_t d_ino;
+                int64_t d_off;
+                unsigned short d_reclen;
+                unsigned char d_type;
+                char d_name[1];
+            };
+
+            alignas(LinuxDirent64) char buffer[32 * 1024];
+            while (true)
+            {
+                long bytes = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+                if (bytes < 0)
+                {
+                    ::close(fd);
+                    throw std::runtime_error("Cannot read directory: " + directory);
+                }
+                if (bytes == 0)
+                    break;
+
+                for (long position = 0; position < bytes;)
+                {
+                    auto *dirent = reinterpret_cast<LinuxDirent64 *>(buffer + position);
+                    position += dirent->d_reclen;
+
+                    const char *name = dirent->d_name;
+                    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                        continue;
+
+                    Entry entry;
+                    entry.type = classify(fd, name, dirent->d_type, entry.size);
+                    entry.offset = static_cast<uint32_t>(worker.names.size());
+                    if (!directory.empty())
+                    {
+                        worker.names += directory;
+                        worker.names += '/';
+                    }
+                    worker.names += name;
+                    entry.length = static_cast<uint32_t>(worker.names.size() - entry.offset);
+                    worker.entries.push_back(entry);
+
+                    if (entry.type == EntryType::Directory && options.recursive && dirent->d_type != DT_LNK)
+                        subdirectories.emplace_back(worker.names, entry.offset, entry.length);
+                }
+            }
+            ::close(fd);
+        }
+
+        // d_type answers most entries; stat only for sizes, symlinks and filesystems reporting DT_UNKNOWN
+        EntryType classify(int directoryFd, const char *name, unsigned char type, uint64_t &size) const
+        {
+            if (type == DT_DIR)
+                return EntryType::Directory;
+            if (type == DT_REG && !options.sizes)
+                return EntryType::File;
+            if (type != DT_REG && type != DT_LNK && type != DT_UNKNOWN)
+                return EntryType::Other;
+
+            // Symlinks are followed for classification, matching directory_entry::is_regular_file()
+            struct stat info;
+            if (::fstatat(directoryFd, name, &info, 0) != 0)
+                return EntryType::Other;
+            if (S_ISREG(info.st_mode))
+            {
+                size = static_cast<uint64_t>(info.st_size);
+                return EntryType::File;
+            }
+            return S_ISDIR(info.st_mode) ? EntryType::Directory : EntryType::Other;
+        }
+    };
+#else
+    template <typename Add>
+    static void iterate(const std::filesystem::path &root, const Options &options, Add add)
+    {
+        auto visitEntry = [&](const std::filesystem::directory_entry &item)
+        {
+            std::string relative = std::filesystem::relative(item.path(), root).generic_string();
+            if (item.is_regular_file())
+                add(std::move(relative), EntryType::File, options.sizes ? uint64_t(item.file_size()) : 0);
+            else if (item.is_directory())
+                add(std::move(relative), EntryType::Directory, 0);
+            else
+                add(std::move(relative), EntryType::Other, 0);
+        };
+        if (options.recursive)
+            for (const auto &item : std::filesystem::recursive_directory_iterator(root))
+                visitEntry(item);
+        else
+            for (const auto &item : std::filesystem::directory_iterator(root))
+                visitEntry(item);
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef FILE_WATCHER_HPP
+#define FILE_WATCHER_HPP
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Reports which project files changed, as paths relative to the project root.
+//
+// Linux uses inotify: directory trees are watched recursively, and new
+// subdirectories are picked up as they appear. Other platforms poll modification
+// times. Editor scratch files (swap files, backups, vim's 4913 probe) are ignored.
+class FileWatcher
+{
+public:
+    using Filter = std::function<bool(const std::string &name)>;
+
+    explicit FileWatcher(std::filesystem::path root) : root(std::move(root))
+    {
+#ifdef __linux__
+        fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0)
+            throw std::runtime_error("inotify is not available");
+#endif
+    }
+
+    ~FileWatcher()
+    {
+#ifdef __linux__
+        if (fd >= 0)
+            ::close(fd);
+#endif
+    }
+
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    // Watch a directory (relative to the root) and everything below it
+    void watchTree(const std::string &relative)
+    {
+        std::error_code ec;
+        if (!std::filesystem::is_directory(root / relative, ec))
+            return;
+        addDirectory(relative, true, nullptr);
+        for (const auto &entry : std::filesystem::recursive_directory_iterator(root / relative, ec))
+        {
+            if (entry.is_directory(ec))
+                addDirectory(std::filesystem::relative(entry.path(), root).generic_string(), true, nullptr);
+        }
+    }
+
+    // Watch only the entries of one directory whose names pass the filter
+    void watchDirectory(const std::string &relative, Filter filter)
+    {
+        addDirectory(relative, false, std::move(filter));
+    }
+
+    // Block up to timeout for the first change, then return every change seen so far
+    std::vector<std::string> wait(std::chrono::milliseconds timeout)
+    {
+        std::set<std::string> changed;
+#ifdef __linux__
+        pollfd request{fd, POLLIN, 0};
+        if (::poll(&request, 1, int(timeout.count())) <= 0)
+            return {};
+
+        alignas(inotify_event) char buffer[16 * 1024];
+        while (true)
+        {
+            ssize_t bytes = ::read(fd, buffer, sizeof(buffer));
+            if (bytes <= 0)
+                break;
+            for (ssize_t offset = 0; offset < bytes;)
+            {
+                auto *event = reinterpret_cast<inotify_event *>(buffer + offset);
+                offset += ssize_t(sizeof(inotify_event) + event->len);
+
+                auto watch = watches.find(event->wd);
+                if (watch == watches.end())
+                    continue;
+                if (event->mask & IN_IGNORED)
+                {
+                    watches.erase(watch);
+                    continue;
+                }
+
+                std::string name = event->len ? event->name : "";
+                if (name.empty() || isScratch(name) || (watch->second.filter && !watch->second.filter(name)))
+                    continue;
+
+                std::string relative = watch->second.relative.empty() ? name : watch->second.relative + "/" + name;
+                if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)) && watch->second.recursive)
+                    watchTree(relative);
+                changed.insert(relative);
+            }
+        }
+#else
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        do
+        {
+            for (auto &[relative, spec] : polled)
+            {
+                auto current = snapshot(relative, spec);
+                for (const auto &[path, time] : current)
+                {
+                    auto previous = spec.times.find(path);
+                    if (previous == spec.times.end() || previous->second != time)
+                        changed.insert(path);
+                }
+                for (const auto &[path, time] : spec.times)
+                {
+                    if (!current.count(path))
+                        changed.insert(path);
+                }
+                spec.times = std::move(current);
+            }
+            if (!changed.empty())
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        } while (std::chrono::steady_clock::now() < deadline);
+#endif
+        return std::vector<std::string>(changed.begin(), changed.end());
+    }
+
+private:
+    std::filesystem::path root;
+
+    static bool isScratch(const std::string &name)
+    {
+        auto endsWith = [&](const char *suffix)
+        {
+            std::string s(suffix);
+            return name.size() >= s.size() && name.compare(name.size() - s.size(), s.size(), s) == 0;
+        };
+        return name == "4913" || name[0] == '#' || endsWith("~") || endsWith(".swp") || endsWith(".swx") ||
+               endsWith(".tmp") || name.rfind(".#", 0) == 0;
+    }
+
+#ifdef __linux__
+    struct Watch
+    {
+        std::string relative;
+        bool recursive = false;
+        Filter filter;
+    };
+
+    int fd = -1;
+    std::map<int, Watch> watches;
+
+    void addDirectory(const std::string &relative, bool recursive, Filter filter)
+    {
+        std::filesystem::path directory = relative.empty() ? root : root / relative;
+        uint32_t mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF;
+        int wd = ::inotify_add_watch(fd, directory.c_str(), mask);
+        if (wd >= 0)
+            watches[wd] = {relative, recursive, std::move(filter)};
+    }
+#else
+    struct Polled
+    {
+        bool recursive = false;
+        Filter filter;
+        std::map<std::string, std::filesystem::file_time_type> times;
+    };
+
+    std::map<std::string, Polled> polled;
+
+    void addDirectory(const std::string &relative, bool recursive, Filter filter)
+    {
+        // Subdirectories of a recursive tree are covered by the tree's own snapshot
+        for (const auto &[existing, spec] : polled)
+        {
+            if (spec.recursive && (existing.empty() || relative.rfind(existing + "/", 0) == 0))
+                return;
+        }
+        Polled spec{recursive, std::move(filter), {}};
+        spec.times = snapshot(relative, spec);
+        polled[relative] = std::move(spec);
+    }
+
+    std::map<std::string, std::filesystem::file_time_type> snapshot(const std::string &relative, const Polled &spec)
+    {
+        std::map<std::string, std::filesystem::file_time_type> times;
+        std::error_code ec;
+        auto record = [&](const std::filesystem::directory_entry &entry)
+        {
+            std::string name = entry.path().filename().string();
+            if (!entry.is_regular_file(ec) || isScratch(name) || (spec.filter && !spec.filter(name)))
+                return;
+            times[std::filesystem::relative(entry.path(), root).generic_string()] = entry.last_write_time(ec);
+        };
+        std::filesystem::path directory = relative.empty() ? root : root / relative;
+        if (spec.recursive)
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(directory, ec))
+                record(entry);
+        else
+            for (const auto &entry : std::filesystem::directory_iterator(directory, ec))
+                record(entry);
+        return times;
+    }
+#endif
+};
+
+#endif
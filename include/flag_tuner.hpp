@@ -0,0 +1,233 @@
+#ifndef FLAG_TUNER_HPP
+#define FLAG_TUNER_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "sha256.hpp"
+
+// Compiler and linker flags searched by 'tegen tune' and the ones it settled on per build profile.
+// The space to search is a list of dimensions, each a list of alternatives; "" leaves the build as
+// it is, and the first alternative of every dimension is where the search starts:
+//
+//   "tune": {
+//     "space": {
+//       "opt": ["", "-O2", "-O3"],
+//       "lto": ["", { "compile": "-flto=auto", "link": "-flto=auto" }]
+//     }
+//   }
+//
+// A string alternative is passed to both the compiler and the linker (which LTO needs to see
+// -O, -march and --param again). The search goes one dimension at a time: every alternative of
+// it is built with the best choices so far and benchmarked, and the fastest is kept if it beats
+// the current choice by more than the noise margin. The result is saved with the profile:
+//
+//   "profiles": {
+//     "release": { "flags": { "compile": "-O3 -march=x86-64-v3", "link": "-O3 -march=x86-64-v3",
+//                             "speedup": 1.12, "baselineMs": 13.8, "tunedMs": 12.3 } }
+//   }
+//
+// and applied by the generated cmake/TegenFlags.cmake, which appends them to the flags of the
+// build type (after its -O level, so the tuned one wins).
+class FlagTuner
+{
+public:
+    struct Flags
+    {
+        std::string compile;
+        std::string link;
+    };
+
+    struct Dimension
+    {
+        std::string name;
+        std::vector<Flags> alternatives;
+    };
+
+    // Beating the current choice by less than this is taken for noise
+    static constexpr double noiseMargin = 0.02;
+
+    static std::vector<Dimension> space(const nlohmann::json &config, bool clang)
+    {
+        if (!config.contains("tune") || !config["tune"].contains("space") || !config["tune"]["space"].is_object())
+            return defaultSpace(clang);
+        std::vector<Dimension> result;
+        for (const auto &[name, alternatives] : config["tune"]["space"].items())
+        {
+            Dimension dimension{name, {}};
+            for (const auto &alternative : alternatives)
+            {
+                if (alternative.is_string())
+                    dimension.alternatives.push_back({alternative.get<std::string>(), alternative.get<std::string>()});
+                else if (alternative.is_object())
+                    dimension.alternatives.push_back({alternative.value("compile", ""), alternative.value("link", "")});
+            }
+            if (dimension.alternatives.size() > 1)
+                result.push_back(dimension);
+        }
+        return result;
+    }
+
+    static std::vector<Dimension> defaultSpace(bool clang)
+    {
+        auto both = [](const std::string &flags) { return Flags{flags, flags}; };
+        std::vector<Dimension> result;
+        result.push_back({"opt", {both(""), both("-O2"), both("-O3")}});
+#if defined(__x86_64__) || defined(__i386__)
+        result.push_back({"march", {both(""), both("-march=x86-64-v2"), both("-march=x86-64-v3"), both("-march=native")}});
+#else
+        result.push_back({"march", {both(""), both("-mcpu=native")}});
+#endif
+        result.push_back({"lto", {both(""), both(clang ? "-flto=thin" : "-flto=auto")}});
+        if (clang)
+            result.push_back({"inline", {both(""), both("-mllvm -inline-threshold=500")}});
+        else
+            result.push_back({"inline", {both(""), both("--param=max-inline-insns-auto=40"), both("--param=max-inline-insns-single=400")}});
+        result.push_back({"plt", {both(""), {"-fno-plt", ""}}});
+        if (!clang)
+            result.push_back({"interposition", {both(""), {"-fno-semantic-interposition", ""}}});
+        return result;
+    }
+
+    // The flags of one choice per dimension
+    static Flags combine(const std::vector<Dimension> &space, const std::vector<size_t> &choice)
+    {
+        Flags flags;
+        for (size_t i = 0; i < space.size(); i++)
+        {
+            const auto &picked = space[i].alternatives[choice[i]];
+            append(flags.compile, picked.compile);
+            append(flags.link, picked.link);
+        }
+        return flags;
+    }
+
+    static std::string describe(const Flags &flags)
+    {
+        if (flags.compile.empty() && flags.link.empty())
+            return "(as built)";
+        if (flags.compile == flags.link)
+            return flags.compile;
+        return "compile: " + (flags.compile.empty() ? "-" : flags.compile) + ", link: " + (flags.link.empty() ? "-" : flags.link);
+    }
+
+    // Short stable name for a variant's build tree
+    static std::string key(const Flags &flags)
+    {
+        Sha256 hasher;
+        hasher.update(flags.compile + '\n' + flags.link);
+        return hasher.hexDigest().substr(0, 12);
+    }
+
+    // Profile names follow CMAKE_BUILD_TYPE, lower-cased; builds without a type use "default"
+    static std::string profileName(const std::string &buildType)
+    {
+        std::string name = buildType;
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+        return name.empty() ? "default" : name;
+    }
+
+    static void save(nlohmann::json &config, const std::string &profile, const Flags &flags, double baselineMs, double tunedMs)
+    {
+        auto &settings = config["profiles"][profile];
+        settings["flags"] = {{"compile", flags.compile},
+                             {"link", flags.link},
+                             {"speedup", tunedMs > 0 ? std::round(baselineMs / tunedMs * 1000) / 1000 : 1.0},
+                             {"baselineMs", std::round(baselineMs * 100) / 100},
+                             {"tunedMs", std::round(tunedMs * 100) / 100}};
+    }
+
+    static bool hasFlags(const nlohmann::json &config)
+    {
+        if (!config.contains("profiles") || !config["profiles"].is_object())
+            return false;
+        for (const auto &[profile, settings] : config["profiles"].items())
+            if (settings.is_object() && settings.contains("flags"))
+                return true;
+        return false;
+    }
+
+    // CMake module appending each profile's flags, or the flags of the variant being measured
+    // (TEGEN_TUNE_COMPILE and TEGEN_TUNE_LINK, passed by 'tegen tune')
+    static std::string cmakeModule(const nlohmann::json &config)
+    {
+        std::ostringstream out;
+        out << "# Generated by Tegen from the \"flags\" of the profiles in TegenConfig.json (see 'tegen tune'); edit those instead.\n";
+        out << "string(TOLOWER \"${CMAKE_BUILD_TYPE}\" _tegen_profile)\n";
+        out << "string(TOUPPER \"${CMAKE_BUILD_TYPE}\" _tegen_config)\n";
+        out << "set(_tegen_compile \"\")\n";
+        out << "set(_tegen_link \"\")\n";
+        out << "if(DEFINED TEGEN_TUNE_COMPILE)\n";
+        out << "    set(_tegen_compile \"${TEGEN_TUNE_COMPILE}\")\n";
+        out << "    set(_tegen_link \"${TEGEN_TUNE_LINK}\")\n";
+        Flags fallback;
+        if (config.contains("profiles") && config["profiles"].is_object())
+        {
+            for (const auto &[profile, settings] : config["profiles"].items())
+            {
+                if (!settings.is_object() || !settings.contains("flags"))
+                    continue;
+                Flags flags{settings["flags"].value("compile", ""), settings["flags"].value("link", "")};
+                if (profile == "default")
+                {
+                    fallback = flags;
+                    continue;
+                }
+                out << "elseif(_tegen_profile STREQUAL " << quote(profileName(profile)) << ")\n";
+                out << "    set(_tegen_compile " << quote(flags.compile) << ")\n";
+                out << "    set(_tegen_link " << quote(flags.link) << ")\n";
+            }
+        }
+        if (!fallback.compile.empty() || !fallback.link.empty())
+        {
+            out << "else()\n";
+            out << "    set(_tegen_compile " << quote(fallback.compile) << ")\n";
+            out << "    set(_tegen_link " << quote(fallback.link) << ")\n";
+        }
+        out << "endif()\n";
+        out << "# After the build type's own flags, so a tuned -O level wins\n";
+        out << "if(_tegen_config)\n";
+        out << "    set(_tegen_config \"_${_tegen_config}\")\n";
+        out << "endif()\n";
+        out << "if(_tegen_compile)\n";
+        out << "    foreach(_tegen_language C CXX)\n";
+        out << "        string(APPEND CMAKE_${_tegen_language}_FLAGS${_tegen_config} \" ${_tegen_compile}\")\n";
+        out << "    endforeach()\n";
+        out << "endif()\n";
+        out << "if(_tegen_link)\n";
+        out << "    foreach(_tegen_kind EXE SHARED MODULE)\n";
+        out << "        string(APPEND CMAKE_${_tegen_kind}_LINKER_FLAGS${_tegen_config} \" ${_tegen_link}\")\n";
+        out << "    endforeach()\n";
+        out << "endif()\n";
+        return out.str();
+    }
+
+private:
+    static void append(std::string &flags, const std::string &more)
+    {
+        if (more.empty())
+            return;
+        if (!flags.empty())
+            flags += ' ';
+        flags += more;
+    }
+
+    static std::string quote(const std::string &value)
+    {
+        std::string quoted = "\"";
+        for (char c : value)
+        {
+            if (c == '\\' || c == '"' || c == '$')
+                quoted += '\\';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+};
+
+#endif
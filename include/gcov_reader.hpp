@@ -0,0 +1,61 @@
+#ifndef GCOV_READER_HPP
+#define GCOV_READER_HPP
+
+#include <cstdlib>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "test_runner.hpp"
+
+// Reads the counters a --coverage binary wrote under GCOV_PREFIX back through
+// `gcov --json-format` (GCC 9+; TEGEN_GCOV can name another gcov, e.g. "llvm-cov gcov").
+class GcovReader
+{
+public:
+    // One gcov JSON report per .gcda file found below prefixDir
+    static std::vector<nlohmann::json> reports(const std::filesystem::path &prefixDir)
+    {
+        std::vector<nlohmann::json> result;
+        std::error_code ec;
+        if (!std::filesystem::is_directory(prefixDir, ec))
+            return result;
+
+        std::vector<std::filesystem::path> dataFiles;
+        for (const auto &entry : std::filesystem::recursive_directory_iterator(prefixDir, ec))
+        {
+            if (entry.path().extension() != ".gcda")
+                continue;
+            // GCOV_PREFIX mirrors the absolute object path; gcov wants the matching .gcno beside the .gcda
+            auto original = std::filesystem::path("/") / std::filesystem::relative(entry.path(), prefixDir);
+            auto notes = original;
+            notes.replace_extension(".gcno");
+            auto copy = entry.path();
+            copy.replace_extension(".gcno");
+            std::filesystem::copy_file(notes, copy, std::filesystem::copy_options::overwrite_existing, ec);
+            if (!ec)
+                dataFiles.push_back(entry.path());
+        }
+        if (dataFiles.empty())
+            return result;
+
+        const char *gcov = std::getenv("TEGEN_GCOV");
+        std::string command = "cd " + TestRunner::shellQuote(prefixDir.string()) + " && " + (gcov ? gcov : "gcov") + " --stdout --json-format";
+        for (const auto &file : dataFiles)
+            command += " " + TestRunner::shellQuote(file.string());
+        command += " 2>/dev/null";
+
+        // One JSON document per line
+        std::istringstream output(TestRunner::capture(command));
+        for (std::string line; std::getline(output, line);)
+        {
+            auto report = nlohmann::json::parse(line, nullptr, false);
+            if (!report.is_discarded())
+                result.push_back(std::move(report));
+        }
+        return result;
+    }
+};
+
+#endif
@@ -0,0 +1,341 @@
+#ifndef HEADER_COST_HPP
+#define HEADER_COST_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "child_process.hpp"
+#include "package_manifest.hpp"
+
+// What it costs a translation unit to include a header on its own: compiler wall time
+// for preprocessing and for a full parse (-fsyntax-only), the distinct files it pulls in
+// transitively (-H), and the tokens left after preprocessing.
+//
+// Each header is also checked for problems: a missing or mismatched include guard (or
+// #pragma once), code outside the guard, breaking when included twice, and not compiling
+// on its own. Works with GCC and Clang.
+class HeaderCost
+{
+public:
+    struct Options
+    {
+        std::string compiler = "c++";
+        std::string standard = "17";
+        std::filesystem::path includeDir; // The project's include/
+        std::filesystem::path workDir;    // Scratch space for the probe translation units
+        unsigned threads = 0;             // 0: one per hardware thread
+    };
+
+    // Headers worth measuring: the ones a user would include directly
+    static bool isHeader(const std::filesystem::path &path)
+    {
+        static const std::set<std::string> extensions = {".h", ".hh", ".hpp", ".hxx", ".h++"};
+        return extensions.count(path.extension().string()) > 0;
+    }
+
+    // Measure headers (relative to the project root, e.g. include/fmt/core.h) in parallel
+    static std::map<std::string, PackageManifest::Cost> measureAll(const std::vector<std::string> &headers,
+                                                                   const std::filesystem::path &projectDir, const Options &options)
+    {
+        std::vector<std::string> work;
+        for (const auto &header : headers)
+            if (isHeader(header))
+                work.push_back(header);
+
+        std::map<std::string, PackageManifest::Cost> costs;
+        std::mutex lock;
+        std::atomic<size_t> next{0};
+        unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        threads = unsigned(std::min<size_t>(threads, work.size()));
+        std::filesystem::create_directories(options.workDir);
+
+        std::vector<std::thread> pool;
+        for (unsigned t = 0; t < threads; t++)
+        {
+            pool.emplace_back([&, t]
+                              {
+                                  for (size_t i = next++; i < work.size(); i = next++)
+                                  {
+                                      auto cost = measure(projectDir / work[i], options, "probe" + std::to_string(t));
+                                      std::lock_guard<std::mutex> guard(lock);
+                                      costs[work[i]] = std::move(cost);
+                                  } });
+        }
+        for (auto &thread : pool)
+            thread.join();
+        return costs;
+    }
+
+    static PackageManifest::Cost measure(const std::filesystem::path &header, const Options &options, const std::string &probeName)
+    {
+        PackageManifest::Cost cost;
+        auto base = options.workDir / probeName;
+        auto source = base;
+        source += ".cpp";
+        auto output = base;
+        output += ".out";
+        auto errors = base;
+        errors += ".err";
+
+        std::ifstream in(header);
+        std::stringstream text;
+        text << in.rdbuf();
+        cost.issues = guardIssues(text.str());
+
+        auto include = "#include \"" + header.generic_string() + "\"\n";
+        std::ofstream(source) << include;
+        std::string common = quote(options.compiler) + " -std=c++" + options.standard + " -I" + quote(options.includeDir.string()) + " ";
+        std::string redirect = " >" + quote(output.string()) + " 2>" + quote(errors.string());
+
+        // Full front end first: a header that does not compile alone has no meaningful cost
+        double parseMs = 0;
+        if (run(common + "-fsyntax-only " + quote(source.string()) + redirect, parseMs) != 0)
+        {
+            cost.issues.push_back("does not compile on its own: " + firstError(errors));
+            return cost;
+        }
+        cost.parseMs = parseMs;
+
+        // -H lists every file opened, one per line, prefixed with dots for the nesting depth
+        if (run(common + "-E -P -H " + quote(source.string()) + redirect, cost.preprocessMs) == 0)
+        {
+            std::ifstream preprocessed(output);
+            std::stringstream tokens;
+            tokens << preprocessed.rdbuf();
+            cost.tokens = countTokens(tokens.str());
+
+            std::set<std::string> opened;
+            std::ifstream tree(errors);
+            for (std::string line; std::getline(tree, line);)
+            {
+                auto space = line.find(' ');
+                if (space != std::string::npos && space > 0 && line.find_first_not_of('.') == space)
+                    opened.insert(std::filesystem::path(line.substr(space + 1)).lexically_normal().string());
+            }
+            opened.erase(header.lexically_normal().string());
+            cost.includes = unsigned(opened.size());
+        }
+
+        // Unguarded headers may still be harmless twice (only declarations); find out
+        bool unguarded = std::any_of(cost.issues.begin(), cost.issues.end(), [](const std::string &issue)
+                                     { return issue.rfind("no include guard", 0) == 0; });
+        if (unguarded)
+        {
+            std::ofstream(source) << include << include;
+            double ignored = 0;
+            if (run(common + "-fsyntax-only " + quote(source.string()) + redirect, ignored) != 0)
+                cost.issues.push_back("breaks when included twice: " + firstError(errors));
+        }
+        return cost;
+    }
+
+    // Include guard problems found in the header's text
+    static std::vector<std::string> guardIssues(const std::string &text)
+    {
+        // Directives and other code, in order, with comments removed
+        std::vector<std::string> lines;
+        std::istringstream in(stripComments(text));
+        for (std::string line; std::getline(in, line);)
+        {
+            auto first = line.find_first_not_of(" \t\r");
+            if (first == std::string::npos)
+                continue;
+            line = line.substr(first);
+            while (!line.empty() && std::isspace((unsigned char)line.back()))
+                line.pop_back();
+            lines.push_back(line);
+        }
+        if (lines.empty())
+            return {};
+
+        static const std::regex pragmaOnce(R"(^#\s*pragma\s+once\b.*)");
+        static const std::regex ifndef(R"(^#\s*ifndef\s+(\w+)$)");
+        static const std::regex ifNotDefined(R"(^#\s*if\s+!\s*defined\s*\(?\s*(\w+)\s*\)?$)");
+        static const std::regex define(R"(^#\s*define\s+(\w+)\b.*)");
+        static const std::regex endif(R"(^#\s*endif\b.*)");
+        static const std::regex conditional(R"(^#\s*(if|ifdef|ifndef)\b.*)");
+
+        for (const auto &line : lines)
+            if (std::regex_match(line, pragmaOnce))
+                return {};
+
+        std::smatch match;
+        if (!std::regex_match(lines[0], match, ifndef) && !std::regex_match(lines[0], match, ifNotDefined))
+            return {"no include guard or #pragma once"};
+        std::string guard = match[1];
+        std::smatch defined;
+        if (lines.size() < 2 || !std::regex_match(lines[1], defined, define))
+            return {"no include guard or #pragma once (#ifndef " + guard + " is not followed by #define)"};
+        if (defined[1] != guard)
+            return {"include guard mismatch: #ifndef " + guard + " but #define " + defined[1].str()};
+
+        // The #if opened on the first line must close on the last
+        int depth = 0;
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            if (std::regex_match(lines[i], conditional))
+                depth++;
+            else if (std::regex_match(lines[i], endif) && --depth == 0 && i + 1 != lines.size())
+                return {"code outside the include guard " + guard};
+        }
+        return {};
+    }
+
+    // Tokens in preprocessed source: identifiers, numbers, literals and punctuators
+    static uint64_t countTokens(const std::string &text)
+    {
+        static const std::vector<std::string> punctuators = {"<=>", "<<=", ">>=", "...", "->*", "::", "->", "++", "--", "<<",
+                                                             ">>", "<=", ">=", "==", "!=", "&&", "||", "+=", "-=", "*=",
+                                                             "/=", "%=", "&=", "|=", "^=", ".*", "##"};
+        uint64_t count = 0;
+        size_t i = 0;
+        while (i < text.size())
+        {
+            char c = text[i];
+            if (std::isspace((unsigned char)c))
+            {
+                i++;
+                continue;
+            }
+            count++;
+            if (c == '#' && (i == 0 || text[i - 1] == '\n'))
+            {
+                // Leftover directive (#pragma): one token per line is close enough
+                i = text.find('\n', i);
+                if (i == std::string::npos)
+                    break;
+                continue;
+            }
+            if (c == 'R' && i + 1 < text.size() && text[i + 1] == '"')
+            {
+                // R"delim( ... )delim"
+                auto open = text.find('(', i);
+                if (open == std::string::npos)
+                    break;
+                auto close = text.find(")" + text.substr(i + 2, open - i - 2) + "\"", open);
+                i = close == std::string::npos ? text.size() : close + (open - i - 2) + 2;
+                continue;
+            }
+            if (std::isalpha((unsigned char)c) || c == '_')
+            {
+                while (i < text.size() && (std::isalnum((unsigned char)text[i]) || text[i] == '_'))
+                    i++;
+                // u8"..." and L'x' prefixes belong to the literal that follows
+                if (i < text.size() && (text[i] == '"' || text[i] == '\''))
+                    count--;
+                continue;
+            }
+            if (std::isdigit((unsigned char)c) || (c == '.' && i + 1 < text.size() && std::isdigit((unsigned char)text[i + 1])))
+            {
+                while (i < text.size() && (std::isalnum((unsigned char)text[i]) || text[i] == '.' || text[i] == '\'' || text[i] == '_' ||
+                                           ((text[i] == '+' || text[i] == '-') && (text[i - 1] == 'e' || text[i - 1] == 'E' ||
+                                                                                   text[i - 1] == 'p' || text[i - 1] == 'P'))))
+                    i++;
+                continue;
+            }
+            if (c == '"' || c == '\'')
+            {
+                for (i++; i < text.size() && text[i] != c && text[i] != '\n'; i++)
+                    if (text[i] == '\\')
+                        i++;
+                i++;
+                continue;
+            }
+            size_t length = 1;
+            for (const auto &punctuator : punctuators)
+            {
+                if (text.compare(i, punctuator.size(), punctuator) == 0)
+                {
+                    length = punctuator.size();
+                    break;
+                }
+            }
+            i += length;
+        }
+        return count;
+    }
+
+private:
+    static std::string quote(const std::string &value)
+    {
+        return "\"" + value + "\"";
+    }
+
+    static int run(const std::string &command, double &milliseconds)
+    {
+        ChildProcess process;
+        process.start(command);
+        int status = process.wait();
+        milliseconds = std::chrono::duration<double, std::milli>(process.duration()).count();
+        return status;
+    }
+
+    static std::string firstError(const std::filesystem::path &errors)
+    {
+        std::ifstream in(errors);
+        for (std::string line; std::getline(in, line);)
+        {
+            auto found = line.find("error: ");
+            if (found != std::string::npos)
+                return line.substr(found + 7);
+        }
+        return "compiler failed";
+    }
+
+    // Comments replaced by a space (newlines kept, so line structure survives)
+    static std::string stripComments(const std::string &text)
+    {
+        std::string out;
+        out.reserve(text.size());
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            if (text.compare(i, 2, "//") == 0)
+            {
+                while (i < text.size() && text[i] != '\n')
+                    i++;
+                if (i < text.size())
+                    out += '\n';
+            }
+            else if (text.compare(i, 2, "/*") == 0)
+            {
+                out += ' ';
+                for (i += 2; i < text.size() && text.compare(i, 2, "*/") != 0; i++)
+                    if (text[i] == '\n')
+                        out += '\n';
+                i++;
+            }
+            else if (text[i] == '"' || text[i] == '\'')
+            {
+                char quoteChar = text[i];
+                out += text[i];
+                for (i++; i < text.size() && text[i] != quoteChar && text[i] != '\n'; i++)
+                {
+                    out += text[i];
+                    if (text[i] == '\\' && i + 1 < text.size())
+                        out += text[++i];
+                }
+                if (i < text.size())
+                    out += text[i];
+            }
+            else
+            {
+                out += text[i];
+            }
+        }
+        return out;
+    }
+};
+
+#endif
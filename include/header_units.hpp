@@ -0,0 +1,209 @@
+#ifndef HEADER_UNITS_HPP
+#define HEADER_UNITS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "child_process.hpp"
+#include "header_cost.hpp"
+#include "json.hpp"
+#include "sha256.hpp"
+#include "toolchain_cache.hpp"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// Dependency headers precompiled into C++ header units, so translation units that
+// include them load the compiled form instead of parsing the text again.
+//
+// GCC (11 and later) does this without source changes: with -fmodules-ts and a module
+// mapper file listing "<header path> <compiled unit>", each matching #include is
+// translated into an import. Units are kept in the global store under
+// header-units/<key>/, where the key covers the toolchain fingerprint (compiler
+// identity, version and flags) and the content of the package's headers, so each is
+// built once per toolchain and shared between projects. Headers that fail to build
+// as a unit, other compilers and an empty mapper all mean plain textual includes.
+class HeaderUnits
+{
+public:
+    struct Toolchain
+    {
+        std::string compiler;
+        std::string flags; // Dialect and build-type flags the project compiles with
+        std::string fingerprint;
+    };
+
+    // Whether the compiler can translate includes into header unit imports; reason says why not
+    static bool supported(const ToolchainCache::Info &compiler, std::string &reason)
+    {
+        if (compiler.version.empty())
+        {
+            reason = "compiler " + (compiler.path.empty() ? std::string("") : compiler.path + " ") + "not found";
+            return false;
+        }
+        if (compiler.clang)
+        {
+            reason = "Clang only imports header units named by import or a module map, not plain #include";
+            return false;
+        }
+        if (compiler.major.empty() || std::atoi(compiler.major.c_str()) < 11)
+        {
+            reason = "header units need GCC 11 or later";
+            return false;
+        }
+        return true;
+    }
+
+    // Compiler identity (see ToolchainCache) plus the flags units are built with
+    static std::string fingerprint(const ToolchainCache::Info &compiler, const std::string &flags)
+    {
+        Sha256 hasher;
+        hasher.update("toolchain " + compiler.fingerprint() + '\n');
+        hasher.update("flags " + flags + '\n');
+        return hasher.hexDigest();
+    }
+
+    // Compiled units (by header, relative to the project root) of one package's headers, taken
+    // from the store or built into it. built counts the units compiled by this call.
+    static std::map<std::string, std::filesystem::path> prepare(const std::vector<std::string> &headers,
+                                                                const std::filesystem::path &projectDir,
+                                                                const std::filesystem::path &storeDir,
+                                                                const Toolchain &toolchain, size_t *built = nullptr)
+    {
+        std::vector<std::string> candidates;
+        Sha256 hasher;
+        hasher.update("toolchain " + toolchain.fingerprint + '\n');
+        for (const auto &header : headers)
+        {
+            if (!HeaderCost::isHeader(header))
+                continue;
+            candidates.push_back(header);
+            hasher.update("header " + header + ' ' + Sha256::hashFile(projectDir / header) + '\n');
+        }
+        std::map<std::string, std::filesystem::path> units;
+        if (candidates.empty())
+            return units;
+
+        auto directory = storeDir / "header-units" / hasher.hexDigest();
+        auto index = directory / "index.json";
+        if (!std::filesystem::exists(index))
+            build(candidates, projectDir, directory, toolchain, built);
+
+        std::ifstream in(index);
+        auto entries = in ? nlohmann::json::parse(in, nullptr, false) : nlohmann::json();
+        if (entries.is_discarded() || !entries.is_object())
+            return units;
+        for (const auto &[header, file] : entries.items())
+            units[header] = directory / file.get<std::string>();
+        return units;
+    }
+
+    // Mapper file content: the path the compiler resolves each header to, then its compiled unit
+    static std::string mapper(const std::map<std::string, std::filesystem::path> &units, const std::filesystem::path &projectDir)
+    {
+        std::string content;
+        for (const auto &[header, unit] : units)
+            content += (projectDir / header).lexically_normal().generic_string() + " " + unit.generic_string() + "\n";
+        return content;
+    }
+
+    // Generated CMake module passing the mapper to every C++ compile with GCC
+    static std::string cmakeModule(const std::string &mapperPath)
+    {
+        std::ostringstream out;
+        out << "# Generated by Tegen for \"headerUnits\" in TegenConfig.json; edit that instead.\n";
+        out << "# An empty mapper means textual includes.\n";
+        out << "if(CMAKE_CXX_COMPILER_ID STREQUAL \"GNU\" AND EXISTS \"${CMAKE_SOURCE_DIR}/" << mapperPath << "\")\n";
+        out << "    get_property(_tegen_targets DIRECTORY \"${CMAKE_SOURCE_DIR}\" PROPERTY BUILDSYSTEM_TARGETS)\n";
+        out << "    foreach(_tegen_target IN LISTS _tegen_targets)\n";
+        out << "        get_target_property(_tegen_type ${_tegen_target} TYPE)\n";
+        out << "        if(NOT _tegen_type STREQUAL \"INTERFACE_LIBRARY\" AND NOT _tegen_type STREQUAL \"UTILITY\")\n";
+        out << "            target_compile_options(${_tegen_target} PRIVATE \"$<$<COMPILE_LANGUAGE:CXX>:-fmodules-ts>\"\n";
+        out << "                \"$<$<COMPILE_LANGUAGE:CXX>:-fmodule-mapper=${CMAKE_SOURCE_DIR}/" << mapperPath << ">\")\n";
+        out << "        endif()\n";
+        out << "    endforeach()\n";
+        out << "endif()\n";
+        return out.str();
+    }
+
+private:
+    // Compile every header into a scratch directory, then move it into place in one rename
+    static void build(const std::vector<std::string> &headers, const std::filesystem::path &projectDir,
+                      const std::filesystem::path &directory, const Toolchain &toolchain, size_t *built)
+    {
+#ifdef _WIN32
+        auto scratch = directory.string() + ".tmp";
+#else
+        auto scratch = directory.string() + ".tmp-" + std::to_string(::getpid());
+#endif
+        std::filesystem::remove_all(scratch);
+        std::filesystem::create_directories(scratch);
+
+        nlohmann::json index = nlohmann::json::object();
+        std::mutex lock;
+        std::atomic<size_t> next{0};
+        unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = unsigned(std::min<size_t>(threads, headers.size()));
+        std::vector<std::thread> pool;
+        for (unsigned t = 0; t < threads; t++)
+        {
+            pool.emplace_back([&]
+                              {
+                                  for (size_t i = next++; i < headers.size(); i = next++)
+                                  {
+                                      auto name = std::to_string(i) + ".gcm";
+                                      auto header = (projectDir / headers[i]).lexically_normal();
+                                      auto map = std::filesystem::path(scratch) / (std::to_string(i) + ".map");
+                                      // The mapper names the output, so nothing lands in a gcm.cache/ directory
+                                      std::ofstream(map) << header.generic_string() << " " << (std::filesystem::path(scratch) / name).generic_string() << "\n";
+                                      std::string command = quote(toolchain.compiler) + " " + toolchain.flags + " -fmodules-ts -fmodule-mapper=" +
+                                                            quote(map.string()) + " -I" + quote((projectDir / "include").string()) +
+                                                            " -fmodule-header -x c++-header " + quote(header.string()) + " >" + nullDevice() + " 2>&1";
+                                      bool ok = ChildProcess::run(command) == 0 && std::filesystem::exists(std::filesystem::path(scratch) / name);
+                                      std::filesystem::remove(map);
+                                      if (!ok)
+                                          continue;
+                                      std::lock_guard<std::mutex> guard(lock);
+                                      index[headers[i]] = name;
+                                      if (built)
+                                          ++*built;
+                                  } });
+        }
+        for (auto &thread : pool)
+            thread.join();
+        std::ofstream(std::filesystem::path(scratch) / "index.json") << index.dump(1);
+
+        std::error_code ec;
+        std::filesystem::create_directories(directory.parent_path());
+        std::filesystem::rename(scratch, directory, ec);
+        // Another build published the same units first; theirs are identical
+        if (ec)
+            std::filesystem::remove_all(scratch, ec);
+    }
+
+    static std::string quote(const std::string &value)
+    {
+        return "\"" + value + "\"";
+    }
+
+    static std::string nullDevice()
+    {
+#ifdef _WIN32
+        return "NUL";
+#else
+        return "/dev/null";
+#endif
+    }
+};
+
+#endif
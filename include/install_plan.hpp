@@ -0,0 +1,250 @@
+#ifndef INSTALL_PLAN_HPP
+#define INSTALL_PLAN_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "chunk_store.hpp"
+#include "json.hpp"
+#include "test_runner.hpp"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// What installing or updating a package costs, worked out before any file is downloaded.
+//
+// A package is cloned blobless and without a checkout first, which brings only the commit
+// and its trees; 'git ls-tree -l' then lists every file with its size and blob id. Files
+// whose blob the store has seen before (store/blobs.json maps git blob ids to chunk store
+// digests) are written from the store instead of downloaded, and only the rest are checked
+// out. Times are predicted from the throughput of earlier installs, which is kept in
+// store/install-history.json: bytes per second downloading, files per second copying into
+// the project, and milliseconds per header scored.
+class InstallPlan
+{
+public:
+    struct File
+    {
+        std::string path; // Relative to the package root, e.g. include/fmt/core.h
+        std::string blob;
+        uint64_t size = 0;
+    };
+
+    struct Package
+    {
+        std::string name;
+        std::string version;
+        bool lazy = false;
+        std::vector<File> fetch;  // Downloaded
+        std::vector<File> reused; // Written from the store
+        size_t headers = 0;       // Under include/
+        size_t libraries = 0;     // Static libraries under lib/
+
+        uint64_t fetchBytes() const
+        {
+            return total(fetch);
+        }
+
+        uint64_t reusedBytes() const
+        {
+            return total(reused);
+        }
+
+        // Files copied into include/ and lib/ (a lazy package's headers stay in the store)
+        size_t materialized() const
+        {
+            return (lazy ? 0 : headers) + libraries;
+        }
+    };
+
+    // Rates of earlier installs; 0 when there is nothing to go by yet
+    struct Throughput
+    {
+        double bytesPerMs = 0;
+        double filesPerMs = 0;
+        double msPerHeader = 0;
+    };
+
+    // Blobless clone of one branch or tag without a checkout. False when git or the server cannot do
+    // partial clones, in which case the caller clones in full.
+    static bool cloneTree(const std::string &url, const std::string &version, const std::filesystem::path &dir)
+    {
+        std::string command = "git clone --quiet --filter=blob:none --no-checkout --depth 1 -b " + version + " " + url + " \"" +
+                              dir.string() + "\"" + quietErrors();
+        return std::system(command.c_str()) == 0 && std::filesystem::exists(dir / ".git");
+    }
+
+    // Every file of HEAD with its blob id and size (no blob is downloaded for this)
+    static std::vector<File> listTree(const std::filesystem::path &dir)
+    {
+        std::vector<File> files;
+        std::string output = TestRunner::capture("git -C \"" + dir.string() + "\" ls-tree -r -l --full-tree HEAD");
+        // <mode> blob <id> <size padded>\t<path>
+        std::istringstream lines(output);
+        for (std::string line; std::getline(lines, line);)
+        {
+            auto tab = line.find('\t');
+            if (tab == std::string::npos)
+                continue;
+            std::istringstream fields(line.substr(0, tab));
+            std::string mode, type, blob, size;
+            fields >> mode >> type >> blob >> size;
+            if (type != "blob" || size == "-")
+                continue;
+            files.push_back({line.substr(tab + 1), blob, std::stoull(size)});
+        }
+        return files;
+    }
+
+    // Split a package's files into downloads and store hits
+    static Package classify(const std::string &name, const std::string &version, bool lazy, const std::vector<File> &files,
+                            const std::filesystem::path &storeDir)
+    {
+        Package package;
+        package.name = name;
+        package.version = version;
+        package.lazy = lazy;
+        auto blobs = loadBlobs(storeDir);
+        ChunkStore store(storeDir);
+        for (const auto &file : files)
+        {
+            auto known = blobs.find(file.blob);
+            if (known != blobs.end() && store.contains(known->second))
+                package.reused.push_back(file);
+            else
+                package.fetch.push_back(file);
+            auto extension = std::filesystem::path(file.path).extension();
+            if (file.path.rfind("include/", 0) == 0)
+                package.headers++;
+            else if (file.path.rfind("lib/", 0) == 0 && (extension == ".a" || extension == ".lib"))
+                package.libraries++;
+        }
+        return package;
+    }
+
+    // Git blob id -> chunk store digest for every file Tegen has put in the store from a package
+    static std::map<std::string, std::string> loadBlobs(const std::filesystem::path &storeDir)
+    {
+        std::ifstream in(storeDir / "blobs.json");
+        auto data = in ? nlohmann::json::parse(in, nullptr, false) : nlohmann::json();
+        if (data.is_discarded() || !data.is_object())
+            return {};
+        return data.get<std::map<std::string, std::string>>();
+    }
+
+    static void rememberBlobs(const std::filesystem::path &storeDir, const std::map<std::string, std::string> &added)
+    {
+        if (added.empty())
+            return;
+        auto blobs = loadBlobs(storeDir);
+        size_t before = blobs.size();
+        blobs.insert(added.begin(), added.end());
+        if (blobs.size() != before)
+            writeAtomically(storeDir / "blobs.json", nlohmann::json(blobs).dump());
+    }
+
+    static Throughput throughput(const std::filesystem::path &storeDir)
+    {
+        auto history = loadHistory(storeDir);
+        Throughput rates;
+        rates.bytesPerMs = rate(history, "fetch");
+        rates.filesPerMs = rate(history, "materialize");
+        double headersPerMs = rate(history, "score");
+        rates.msPerHeader = headersPerMs > 0 ? 1 / headersPerMs : 0;
+        return rates;
+    }
+
+    // Add a measurement: kind is "fetch" (bytes), "materialize" (files) or "score" (headers)
+    static void record(const std::filesystem::path &storeDir, const std::string &kind, double amount, double ms)
+    {
+        if (amount <= 0 || ms <= 0)
+            return;
+        auto history = loadHistory(storeDir);
+        auto &samples = history[kind];
+        if (!samples.is_array())
+            samples = nlohmann::json::array();
+        samples.push_back({amount, ms});
+        // Recent installs describe this machine and network best
+        while (samples.size() > historyLength)
+            samples.erase(samples.begin());
+        writeAtomically(storeDir / "install-history.json", history.dump());
+    }
+
+private:
+    static constexpr size_t historyLength = 20;
+
+    static uint64_t total(const std::vector<File> &files)
+    {
+        uint64_t bytes = 0;
+        for (const auto &file : files)
+            bytes += file.size;
+        return bytes;
+    }
+
+    static nlohmann::json loadHistory(const std::filesystem::path &storeDir)
+    {
+        std::ifstream in(storeDir / "install-history.json");
+        auto data = in ? nlohmann::json::parse(in, nullptr, false) : nlohmann::json();
+        return data.is_discarded() || !data.is_object() ? nlohmann::json::object() : data;
+    }
+
+    // Amount per millisecond over the recorded samples, weighted by their size
+    static double rate(const nlohmann::json &history, const std::string &kind)
+    {
+        double amount = 0;
+        double ms = 0;
+        for (const auto &sample : history.value(kind, nlohmann::json::array()))
+        {
+            if (!sample.is_array() || sample.size() != 2)
+                continue;
+            amount += sample[0].get<double>();
+            ms += sample[1].get<double>();
+        }
+        return ms > 0 ? amount / ms : 0;
+    }
+
+    static std::string quietErrors()
+    {
+#ifdef _WIN32
+        return " 2>NUL";
+#else
+        return " 2>/dev/null";
+#endif
+    }
+
+    static void writeAtomically(const std::filesystem::path &path, const std::string &contents)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+        auto temp = path;
+        temp += ".tmp-" + std::to_string(processId());
+        {
+            std::ofstream out(temp, std::ios::binary);
+            out << contents;
+        }
+        std::filesystem::rename(temp, path, ec);
+        if (ec)
+            std::filesystem::remove(temp, ec);
+    }
+
+    static long processId()
+    {
+#ifdef _WIN32
+        return long(::_getpid());
+#else
+        return long(::getpid());
+#endif
+    }
+};
+
+#endif
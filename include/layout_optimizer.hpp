@@ -0,0 +1,121 @@
+#ifndef LAYOUT_OPTIMIZER_HPP
+#define LAYOUT_OPTIMIZER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "json.hpp"
+
+// Post-link code layout for front-end bound binaries: hot code packed together so it
+// shares i-cache lines, iTLB entries and pages.
+//
+// With llvm-bolt on PATH the built binary is rewritten from a profile. The profile
+// comes from `perf record` branch samples (LBR) when the CPU and kernel provide them,
+// and from BOLT's own instrumentation otherwise. Without BOLT the profile comes from a
+// --coverage run. The hottest functions are then written to a section ordering file,
+// and the binary is relinked with -ffunction-sections through gold or lld.
+class LayoutOptimizer
+{
+public:
+    enum class Method
+    {
+        Bolt,
+        OrderFile
+    };
+
+    static bool hasTool(const std::string &name)
+    {
+#ifdef _WIN32
+        return std::system(("where " + name + " >NUL 2>NUL").c_str()) == 0;
+#else
+        return std::system(("command -v " + name + " >/dev/null 2>&1").c_str()) == 0;
+#endif
+    }
+
+    static Method pick(bool forceOrderFile)
+    {
+        return !forceOrderFile && hasTool("llvm-bolt") ? Method::Bolt : Method::OrderFile;
+    }
+
+    // Whether `perf record -j any,u` works here (needs LBR hardware and perf_event access)
+    static bool lbrAvailable()
+    {
+        return hasTool("perf") && hasTool("perf2bolt") &&
+               std::system("perf record -q -e cycles:u -j any,u -o /dev/null -- true >/dev/null 2>&1") == 0;
+    }
+
+    // Linker used for the ordered relink; empty when neither gold nor lld is installed
+    static std::string orderingLinker()
+    {
+        if (hasTool("ld.lld"))
+            return "lld";
+        if (hasTool("ld.gold"))
+            return "gold";
+        return "";
+    }
+
+    // Flags that make the linker follow the ordering file
+    static std::string orderingLinkFlags(const std::string &linker, const std::filesystem::path &orderFile)
+    {
+        if (linker == "lld")
+            return "-fuse-ld=lld -Wl,--symbol-ordering-file=" + orderFile.string() + " -Wl,--no-warn-symbol-ordering";
+        return "-fuse-ld=gold -Wl,--section-ordering-file=" + orderFile.string();
+    }
+
+    // Functions by descending call count, from gcov JSON reports
+    static std::vector<std::pair<std::string, uint64_t>> hotFunctions(const std::vector<nlohmann::json> &reports)
+    {
+        std::map<std::string, uint64_t> counts;
+        for (const auto &report : reports)
+        {
+            for (const auto &file : report.value("files", nlohmann::json::array()))
+            {
+                for (const auto &function : file.value("functions", nlohmann::json::array()))
+                {
+                    uint64_t count = function.value("execution_count", uint64_t(0));
+                    if (count > 0)
+                        counts[function.value("name", "")] += count;
+                }
+            }
+        }
+        counts.erase("");
+
+        std::vector<std::pair<std::string, uint64_t>> hot(counts.begin(), counts.end());
+        std::stable_sort(hot.begin(), hot.end(), [](const auto &a, const auto &b)
+                         { return a.second > b.second; });
+        return hot;
+    }
+
+    // lld orders symbols; gold orders sections, which GCC names .text.<symbol> (or
+    // .text.hot./.text.startup./... .<symbol>), hence the glob
+    static void writeOrderFile(const std::vector<std::pair<std::string, uint64_t>> &hot, const std::string &linker,
+                               const std::filesystem::path &orderFile)
+    {
+        std::filesystem::create_directories(orderFile.parent_path());
+        std::ofstream out(orderFile);
+        for (const auto &[name, count] : hot)
+            out << (linker == "lld" ? name : ".text*." + name) << "\n";
+    }
+
+    // Link flags that keep the relocations BOLT needs to move functions, not just blocks
+    static std::string boltLinkFlags()
+    {
+        return "-Wl,--emit-relocs";
+    }
+
+    static std::string boltCommand(const std::filesystem::path &binary, const std::filesystem::path &profile,
+                                   const std::filesystem::path &output)
+    {
+        return "llvm-bolt \"" + binary.string() + "\" -o \"" + output.string() + "\" -data=\"" + profile.string() +
+               "\" -reorder-blocks=ext-tsp -reorder-functions=hfsort -split-functions -split-all-cold -split-eh"
+               " -dyno-stats";
+    }
+};
+
+#endif
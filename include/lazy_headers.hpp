@@ -0,0 +1,219 @@
+#ifndef LAZY_HEADERS_HPP
+#define LAZY_HEADERS_HPP
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "chunk_store.hpp"
+#include "json.hpp"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// Headers of packages installed with --lazy, written into include/ only when a compile
+// asks for them. The package's headers go into the chunk store at install time and
+// .tegen/lazy-headers.json maps each one to its digest. When a compile run through the
+// launcher (see CompileHistory) fails on a missing include that the index knows, the
+// header is materialized from the store and the compile runs again. Headers brought in
+// this way are appended to .tegen/lazy-used.log, which the next build folds into the
+// manifest so they are put back after a fresh checkout.
+//
+// Only hard misses are seen: a header probed with __has_include stays absent.
+class LazyHeaders
+{
+public:
+    static std::filesystem::path indexFile(const std::filesystem::path &projectDir)
+    {
+        return projectDir / ".tegen" / "lazy-headers.json";
+    }
+
+    static std::filesystem::path usedLog(const std::filesystem::path &projectDir)
+    {
+        return projectDir / ".tegen" / "lazy-used.log";
+    }
+
+    // Rewrite the index for the launcher (header -> digest); no lazy headers removes it
+    static void writeIndex(const std::filesystem::path &projectDir, const std::filesystem::path &storeDir,
+                           const std::map<std::string, std::string> &digests)
+    {
+        auto file = indexFile(projectDir);
+        std::error_code ec;
+        if (digests.empty())
+        {
+            std::filesystem::remove(file, ec);
+            return;
+        }
+        nlohmann::json index = {{"store", storeDir.generic_string()}, {"headers", digests}};
+        std::string content = index.dump(1);
+        std::ifstream in(file);
+        std::stringstream existing;
+        existing << in.rdbuf();
+        if (existing.str() == content)
+            return;
+        std::filesystem::create_directories(file.parent_path());
+        std::ofstream(file) << content;
+    }
+
+    explicit LazyHeaders(std::filesystem::path projectDir) : projectDir(std::move(projectDir)), store("")
+    {
+        std::ifstream in(indexFile(this->projectDir));
+        auto index = in ? nlohmann::json::parse(in, nullptr, false) : nlohmann::json();
+        if (index.is_discarded() || !index.is_object())
+            return;
+        store = ChunkStore(index.value("store", ""));
+        digests = index.value("headers", std::map<std::string, std::string>());
+    }
+
+    bool empty() const
+    {
+        return digests.empty();
+    }
+
+    // Lazy headers (relative to the project root) named by the "file not found" errors of a
+    // GCC, Clang or MSVC compile. They may exist by now: a parallel compile can have written
+    // one since this compile looked.
+    std::vector<std::string> missing(const std::string &errors) const
+    {
+        static const std::regex gcc(R"(^(.+?):\d+:\d+: fatal error: (.+?): No such file or directory\r?$)");
+        static const std::regex clang(R"(^(.+?):\d+:\d+: fatal error: '(.+?)' file not found\r?$)");
+        static const std::regex msvc(R"(^(.+?)\(\d+\): fatal error C1083: Cannot open include file: '(.+?)'.*$)");
+
+        std::vector<std::string> headers;
+        std::istringstream lines(errors);
+        for (std::string line; std::getline(lines, line);)
+        {
+            std::smatch match;
+            if (!std::regex_match(line, match, gcc) && !std::regex_match(line, match, clang) && !std::regex_match(line, match, msvc))
+                continue;
+            std::filesystem::path includer(match[1].str());
+            if (includer.is_relative())
+                includer = std::filesystem::current_path() / includer;
+            std::string name = match[2];
+
+            // Searched through include/, or next to the including file for quoted includes
+            std::vector<std::filesystem::path> candidates = {projectDir / "include" / name, includer.parent_path() / name};
+            for (const auto &candidate : candidates)
+            {
+                auto header = candidate.lexically_normal().lexically_relative(projectDir.lexically_normal()).generic_string();
+                if (digests.count(header) && std::find(headers.begin(), headers.end(), header) == headers.end())
+                {
+                    headers.push_back(header);
+                    break;
+                }
+            }
+        }
+        return headers;
+    }
+
+    // Write a header from the store into the project. Throws when the store no longer has it.
+    void materialize(const std::string &header) const
+    {
+        auto found = digests.find(header);
+        if (found == digests.end())
+            throw std::runtime_error(header + " is not a lazily installed header");
+        auto target = projectDir / header;
+        std::filesystem::create_directories(target.parent_path());
+        // A private name first: parallel compiles may miss the same header at once
+        auto staged = target;
+        staged += "." + std::to_string(processId());
+        store.materialize(found->second, staged);
+        std::filesystem::rename(staged, target);
+    }
+
+    // Note headers a compile asked for, for the next build to keep (one append, safe across compiles)
+    void recordUse(const std::vector<std::string> &headers) const
+    {
+        if (headers.empty())
+            return;
+        std::string lines;
+        for (const auto &header : headers)
+            lines += header + "\n";
+        if (FILE *out = std::fopen(usedLog(projectDir).string().c_str(), "ab"))
+        {
+            std::fwrite(lines.data(), 1, lines.size(), out);
+            std::fclose(out);
+        }
+    }
+
+    // Headers recorded since the last call; the log is emptied
+    static std::set<std::string> takeUsed(const std::filesystem::path &projectDir)
+    {
+        std::set<std::string> used;
+        auto log = usedLog(projectDir);
+        std::ifstream in(log);
+        for (std::string line; std::getline(in, line);)
+            if (!line.empty())
+                used.insert(line);
+        in.close();
+        std::error_code ec;
+        std::filesystem::remove(log, ec);
+        return used;
+    }
+
+    // Retry hook for the compile launcher: materialize what the failed compile missed and say
+    // whether that is worth another attempt. Empty when the project has no lazy packages.
+    static std::function<bool(const std::string &)> retryCompile(const std::filesystem::path &projectDir)
+    {
+        if (projectDir.empty() || !std::filesystem::exists(indexFile(projectDir)))
+            return nullptr;
+        // Headers found already written are retried once each, so a compile that misses one for
+        // another reason (a wrong include path, say) still fails
+        return [projectDir, retried = std::set<std::string>()](const std::string &errors) mutable
+        {
+            LazyHeaders lazy(projectDir);
+            auto headers = lazy.missing(errors);
+            std::vector<std::string> written;
+            bool resolved = false;
+            for (const auto &header : headers)
+            {
+                if (std::filesystem::exists(projectDir / header))
+                {
+                    resolved = retried.insert(header).second || resolved;
+                    continue;
+                }
+                try
+                {
+                    lazy.materialize(header);
+                    written.push_back(header);
+                    retried.insert(header);
+                    resolved = true;
+                }
+                catch (const std::exception &e)
+                {
+                    std::fprintf(stderr, "tegen: cannot materialize %s: %s\n", header.c_str(), e.what());
+                }
+            }
+            lazy.recordUse(written);
+            return resolved;
+        };
+    }
+
+private:
+    std::filesystem::path projectDir;
+    ChunkStore store;
+    std::map<std::string, std::string> digests;
+
+    static long processId()
+    {
+#ifdef _WIN32
+        return long(::_getpid());
+#else
+        return long(::getpid());
+#endif
+    }
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef LINE_PROFILE_HPP
+#define LINE_PROFILE_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "json.hpp"
+
+// Per-source-line weights of one profiled run of the project (written by 'tegen run
+// --profile'). Keys are "path:line" relative to the project root.
+//
+// With perf the weight is the share of cycle samples (in percent) that landed on the
+// line. Without perf it is the line's execution count from a --coverage run, which
+// ranks loops just as well, since a loop header runs once per iteration.
+class LineProfile
+{
+public:
+    std::string source; // "perf" or "gcov"
+    std::string target;
+    std::map<std::string, double> weights;
+
+    bool empty() const
+    {
+        return weights.empty();
+    }
+
+    double weight(const std::string &file, unsigned line) const
+    {
+        auto found = weights.find(file + ":" + std::to_string(line));
+        return found == weights.end() ? 0 : found->second;
+    }
+
+    std::string unit() const
+    {
+        return source == "perf" ? "% samples" : "executions";
+    }
+
+    void save(const std::filesystem::path &file) const
+    {
+        nlohmann::json out;
+        out["source"] = source;
+        out["target"] = target;
+        out["lines"] = weights;
+        std::filesystem::create_directories(file.parent_path());
+        std::ofstream(file) << out.dump(1);
+    }
+
+    static LineProfile load(const std::filesystem::path &file)
+    {
+        LineProfile profile;
+        std::ifstream in(file);
+        auto data = in ? nlohmann::json::parse(in, nullptr, false) : nlohmann::json();
+        if (data.is_discarded() || !data.is_object())
+            return profile;
+        profile.source = data.value("source", "");
+        profile.target = data.value("target", "");
+        profile.weights = data.value("lines", std::map<std::string, double>());
+        return profile;
+    }
+
+    // Line execution counts from gcov JSON reports
+    static LineProfile fromGcov(const std::vector<nlohmann::json> &reports, const std::filesystem::path &projectDir)
+    {
+        LineProfile profile;
+        profile.source = "gcov";
+        for (const auto &report : reports)
+        {
+            std::filesystem::path cwd = report.value("current_working_directory", "");
+            for (const auto &file : report.value("files", nlohmann::json::array()))
+            {
+                std::filesystem::path path = file.value("file", "");
+                auto relative = projectRelative(path.is_relative() ? cwd / path : path, projectDir);
+                if (relative.empty())
+                    continue;
+                for (const auto &line : file.value("lines", nlohmann::json::array()))
+                {
+                    double count = line.value("count", 0.0);
+                    if (count > 0)
+                        profile.weights[relative + ":" + std::to_string(line.value("line_number", 0))] += count;
+                }
+            }
+        }
+        return profile;
+    }
+
+    // Lines of `perf report --sort srcline -F overhead,srcline --full-source-path --stdio -q`
+    static LineProfile fromPerfReport(const std::string &report, const std::filesystem::path &projectDir)
+    {
+        LineProfile profile;
+        profile.source = "perf";
+        std::istringstream lines(report);
+        for (std::string line; std::getline(lines, line);)
+        {
+            std::istringstream fields(line);
+            std::string percent;
+            std::string location;
+            if (!(fields >> percent >> location) || percent.empty() || percent.back() != '%')
+                continue;
+            auto colon = location.rfind(':');
+            if (colon == std::string::npos)
+                continue;
+            auto relative = projectRelative(location.substr(0, colon), projectDir);
+            if (!relative.empty())
+                profile.weights[relative + location.substr(colon)] += std::atof(percent.c_str());
+        }
+        return profile;
+    }
+
+    // Path relative to the project root with '/' separators, or empty when outside it or under build/
+    static std::string projectRelative(const std::filesystem::path &path, const std::filesystem::path &projectDir)
+    {
+        auto relative = path.lexically_normal().lexically_relative(projectDir);
+        if (relative.empty() || *relative.begin() == ".." || *relative.begin() == "build")
+            return "";
+        return relative.generic_string();
+    }
+};
+
+#endif
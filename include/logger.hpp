@@ -0,0 +1,377 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <ios>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "json.hpp"
+
+// Tegen's console output. Every line has a level and goes into a buffer owned by the thread
+// that logged it, so parallel actions neither wait on stdout nor split each other's lines.
+// A sink thread writes the buffers out in batches, in the order the lines were logged:
+// errors and warnings to stderr, the rest to stdout. The mode decides what is shown:
+//
+//   normal   errors, warnings and info
+//   quiet    errors and warnings
+//   verbose  all of it, including the commands Tegen runs
+//   json     what normal shows, as one JSON object per line on stdout
+//
+// Tools Tegen starts write to the same terminal, so flush() comes before each of them, and
+// shutdown() before the process exits.
+class Log
+{
+public:
+    enum class Level
+    {
+        Error,
+        Warning,
+        Info,
+        Verbose
+    };
+
+    enum class Mode
+    {
+        Normal,
+        Quiet,
+        Verbose,
+        Json
+    };
+
+    // One line, logged when it goes out of scope: Log::info() << "Built " << count << " objects";
+    class Line
+    {
+    public:
+        explicit Line(Level level) : level(level), shown(Log::enabled(level)) {}
+        Line(const Line &) = delete;
+        Line &operator=(const Line &) = delete;
+
+        ~Line()
+        {
+            if (shown)
+                Log::instance().append(level, text.str(), false);
+        }
+
+        template <typename T>
+        Line &operator<<(const T &value)
+        {
+            if (shown)
+                text << value;
+            return *this;
+        }
+
+        // Manipulators (std::setw and the like are objects and go through the template)
+        Line &operator<<(std::ostream &(*manipulator)(std::ostream &))
+        {
+            if (shown)
+                manipulator(text);
+            return *this;
+        }
+
+        Line &operator<<(std::ios_base &(*manipulator)(std::ios_base &))
+        {
+            if (shown)
+                manipulator(text);
+            return *this;
+        }
+
+    private:
+        Level level;
+        bool shown;
+        std::ostringstream text;
+    };
+
+    static Line error()
+    {
+        return Line(Level::Error);
+    }
+
+    static Line warning()
+    {
+        return Line(Level::Warning);
+    }
+
+    static Line info()
+    {
+        return Line(Level::Info);
+    }
+
+    static Line verbose()
+    {
+        return Line(Level::Verbose);
+    }
+
+    // A progress line redrawn in place (text starts with '\r'); the next line logged ends it.
+    // Only shown in normal and verbose mode.
+    static void status(const std::string &text)
+    {
+        if (enabled(Level::Info) && mode() != Mode::Json)
+            instance().append(Level::Info, text, true);
+    }
+
+    static void setMode(Mode mode)
+    {
+        instance().currentMode = mode;
+    }
+
+    static Mode mode()
+    {
+        return instance().currentMode;
+    }
+
+    static bool enabled(Level level)
+    {
+        switch (mode())
+        {
+        case Mode::Quiet:
+            return level <= Level::Warning;
+        case Mode::Verbose:
+            return true;
+        default:
+            return level <= Level::Info;
+        }
+    }
+
+    // Write out everything logged so far; returns once it is on the terminal
+    static void flush()
+    {
+        instance().drain();
+    }
+
+    // Flush and stop the sink thread (logging afterwards still works, written by flush() alone)
+    static void shutdown()
+    {
+        instance().stop();
+    }
+
+private:
+    struct Record
+    {
+        uint64_t sequence = 0;
+        Level level = Level::Info;
+        bool status = false;
+        unsigned thread = 0;
+        double seconds = 0; // Since the first line
+        std::string text;
+    };
+
+    struct Buffer
+    {
+        std::mutex lock;
+        std::vector<Record> records;
+        unsigned thread = 0;
+    };
+
+    // How long a line may wait in its buffer when nothing asks for a flush
+    static constexpr std::chrono::milliseconds sinkInterval{50};
+
+    std::atomic<Mode> currentMode{Mode::Normal};
+    std::atomic<uint64_t> sequence{0};
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    std::mutex registryLock;
+    std::vector<std::shared_ptr<Buffer>> buffers;
+    unsigned threads = 0;
+
+    std::mutex writeLock; // One drain at a time, so batches stay in order
+    bool statusShown = false;
+
+    std::mutex wakeLock;
+    std::condition_variable wake;
+    bool urgent = false;
+    bool stopping = false;
+    std::thread sink;
+
+    Log() = default;
+
+    ~Log()
+    {
+        stop();
+    }
+
+    static Log &instance()
+    {
+        static Log log;
+        return log;
+    }
+
+    Buffer &local()
+    {
+        thread_local std::shared_ptr<Buffer> buffer;
+        if (!buffer)
+        {
+            buffer = std::make_shared<Buffer>();
+            std::lock_guard<std::mutex> guard(registryLock);
+            buffer->thread = threads++;
+            buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    void append(Level level, std::string text, bool status)
+    {
+        Record record;
+        record.sequence = sequence++;
+        record.level = level;
+        record.status = status;
+        record.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch).count();
+        record.text = std::move(text);
+        auto &buffer = local();
+        record.thread = buffer.thread;
+        {
+            std::lock_guard<std::mutex> guard(buffer.lock);
+            buffer.records.push_back(std::move(record));
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(wakeLock);
+            if (!stopping)
+            {
+                if (!sink.joinable())
+                    sink = std::thread([this] { run(); });
+                // Problems are shown at once
+                if (level <= Level::Warning)
+                {
+                    urgent = true;
+                    wake.notify_one();
+                }
+                return;
+            }
+        }
+        drain();
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> guard(wakeLock);
+        while (true)
+        {
+            wake.wait_for(guard, sinkInterval, [this] { return urgent || stopping; });
+            urgent = false;
+            bool last = stopping;
+            guard.unlock();
+            drain();
+            if (last)
+                return;
+            guard.lock();
+        }
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> guard(wakeLock);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (sink.joinable())
+            sink.join();
+        drain();
+        std::lock_guard<std::mutex> writing(writeLock);
+        if (statusShown)
+        {
+            std::fputs("\n", stdout);
+            std::fflush(stdout);
+            statusShown = false;
+        }
+    }
+
+    void drain()
+    {
+        std::lock_guard<std::mutex> writing(writeLock);
+        std::vector<Record> batch;
+        {
+            std::lock_guard<std::mutex> guard(registryLock);
+            for (const auto &buffer : buffers)
+            {
+                std::lock_guard<std::mutex> bufferGuard(buffer->lock);
+                std::move(buffer->records.begin(), buffer->records.end(), std::back_inserter(batch));
+                buffer->records.clear();
+            }
+            // Buffers of finished threads are only held here
+            buffers.erase(std::remove_if(buffers.begin(), buffers.end(), [](const std::shared_ptr<Buffer> &buffer)
+                                         { return buffer.use_count() == 1; }),
+                          buffers.end());
+        }
+        if (batch.empty())
+            return;
+        std::sort(batch.begin(), batch.end(), [](const Record &a, const Record &b) { return a.sequence < b.sequence; });
+
+        // Consecutive lines for the same stream are written at once
+        FILE *stream = nullptr;
+        std::string pending;
+        auto write = [&](FILE *to)
+        {
+            if (stream && stream != to && !pending.empty())
+            {
+                std::fwrite(pending.data(), 1, pending.size(), stream);
+                std::fflush(stream);
+                pending.clear();
+            }
+            stream = to;
+        };
+        bool json = mode() == Mode::Json;
+        for (const auto &record : batch)
+        {
+            FILE *to = !json && record.level <= Level::Warning ? stderr : stdout;
+            write(to);
+            if (json)
+            {
+                // Written by hand to keep the fields in this order
+                std::ostringstream line;
+                line << "{\"time\":" << std::fixed << std::setprecision(6) << record.seconds << ",\"level\":\""
+                     << levelName(record.level) << "\",\"thread\":" << record.thread << ",\"message\":"
+                     << nlohmann::json(record.text).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) << "}\n";
+                pending += line.str();
+                continue;
+            }
+            if (statusShown && !record.status)
+            {
+                // End the progress line before anything else appears, on whichever stream
+                if (to != stdout)
+                {
+                    std::fputs("\n", stdout);
+                    std::fflush(stdout);
+                }
+                else
+                {
+                    pending += "\n";
+                }
+            }
+            statusShown = record.status;
+            pending += record.text;
+            if (!record.status)
+                pending += "\n";
+        }
+        write(nullptr);
+    }
+
+    static const char *levelName(Level level)
+    {
+        switch (level)
+        {
+        case Level::Error:
+            return "error";
+        case Level::Warning:
+            return "warning";
+        case Level::Verbose:
+            return "verbose";
+        default:
+            return "info";
+        }
+    }
+};
+
+#endif
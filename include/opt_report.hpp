@@ -0,0 +1,147 @@
+#ifndef OPT_REPORT_HPP
+#define OPT_REPORT_HPP
+
+#include <algorithm>
+#include <filesystem>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "line_profile.hpp"
+
+// Missed-vectorization remarks from a compile, deduplicated per loop (source line)
+// and ranked by a LineProfile when one is available.
+//
+// GCC reports through -fopt-info-vec-missed ("file:line:col: missed: ..."), Clang
+// through -Rpass-missed/-Rpass-analysis=loop-vectorize ("file:line:col: remark: loop
+// not vectorized: ... [-Rpass-...]"). Remarks outside the project (system headers)
+// are dropped; installed dependency headers under include/ are kept.
+class OptReport
+{
+public:
+    struct Loop
+    {
+        std::string file; // Relative to the project root
+        unsigned line = 0;
+        std::vector<std::string> reasons; // Distinct, in the compiler's order
+        double weight = 0;
+    };
+
+    static std::string compilerFlags(const std::string &compilerId)
+    {
+        if (compilerId.find("Clang") != std::string::npos)
+            return "-Rpass-missed=loop-vectorize -Rpass-analysis=loop-vectorize";
+        return "-fopt-info-vec-missed";
+    }
+
+    // Parse compiler output (build log) into one entry per loop
+    static std::vector<Loop> parse(const std::string &output, const std::filesystem::path &projectDir)
+    {
+        static const std::regex remark(R"(^(.+?):(\d+):\d+: (?:missed|remark): (.*?)(?: \[-R[^\]]*\])?\s*$)");
+        std::vector<Loop> loops;
+        std::istringstream lines(output);
+        for (std::string line; std::getline(lines, line);)
+        {
+            std::smatch match;
+            if (!std::regex_match(line, match, remark))
+                continue;
+            std::filesystem::path path = match[1].str();
+            if (path.is_relative())
+                path = projectDir / path;
+            auto file = LineProfile::projectRelative(path, projectDir);
+            if (file.empty())
+                continue;
+            unsigned number = unsigned(std::stoul(match[2].str()));
+            std::string reason = match[3].str();
+
+            auto loop = std::find_if(loops.begin(), loops.end(), [&](const Loop &existing)
+                                     { return existing.file == file && existing.line == number; });
+            if (loop == loops.end())
+            {
+                loops.push_back({file, number, {}, 0});
+                loop = loops.end() - 1;
+            }
+            // Every translation unit that includes a header repeats its remarks
+            std::vector<std::string> found = {normalize(reason)};
+            if (reason == "couldn't vectorize loop" || reason.rfind("loop not vectorized", 0) == 0)
+                found.push_back(genericReason);
+            for (const auto &entry : found)
+                if (std::find(loop->reasons.begin(), loop->reasons.end(), entry) == loop->reasons.end())
+                    loop->reasons.push_back(entry);
+        }
+
+        // Basic-block (SLP) remarks share the output; keep only lines with a loop-level verdict
+        loops.erase(std::remove_if(loops.begin(), loops.end(), [](const Loop &loop)
+                                   { return std::find(loop.reasons.begin(), loop.reasons.end(), genericReason) == loop.reasons.end(); }),
+                    loops.end());
+        for (auto &loop : loops)
+        {
+            loop.reasons.erase(std::remove_if(loop.reasons.begin(), loop.reasons.end(), [&](const std::string &reason)
+                                              { return reason != genericReason && !isLoopReason(reason); }),
+                               loop.reasons.end());
+        }
+        return loops;
+    }
+
+    // Hottest first when the profile has weights; otherwise by location
+    static void rank(std::vector<Loop> &loops, const LineProfile &profile)
+    {
+        for (auto &loop : loops)
+            loop.weight = profile.weight(loop.file, loop.line);
+        std::stable_sort(loops.begin(), loops.end(), [](const Loop &a, const Loop &b)
+                         {
+                             if (a.weight != b.weight)
+                                 return a.weight > b.weight;
+                             return a.file != b.file ? a.file < b.file : a.line < b.line; });
+    }
+
+    // The specific reasons; the generic verdict only when it is all there is
+    static std::string summary(const Loop &loop)
+    {
+        std::string text;
+        for (const auto &reason : loop.reasons)
+        {
+            if (loop.reasons.size() > 1 && reason == genericReason)
+                continue;
+            text += (text.empty() ? "" : " | ") + reason;
+        }
+        return text;
+    }
+
+private:
+    static constexpr const char *genericReason = "loop not vectorized";
+
+    // One wording for both compilers, without GIMPLE statements that differ per instantiation
+    static std::string normalize(std::string reason)
+    {
+        if (reason == "couldn't vectorize loop" || reason.rfind("loop not vectorized", 0) == 0)
+        {
+            // Clang: "loop not vectorized: <why>" carries the reason itself
+            auto colon = reason.find(": ");
+            if (colon == std::string::npos)
+                return genericReason;
+            reason = reason.substr(colon + 2);
+        }
+        for (const char *prefix : {"not vectorized: ", "missed: "})
+            if (reason.rfind(prefix, 0) == 0)
+                reason = reason.substr(std::string(prefix).size());
+        auto statement = reason.find(" stmt: ");
+        if (statement != std::string::npos)
+            reason = reason.substr(0, statement + 5);
+        while (!reason.empty() && (reason.back() == '.' || reason.back() == ';' || reason.back() == ' '))
+            reason.pop_back();
+        return reason;
+    }
+
+    static bool isLoopReason(const std::string &reason)
+    {
+        static const std::set<std::string> blockOnly = {"statement clobbers memory", "splitting region at dominance boundary"};
+        for (const auto &prefix : blockOnly)
+            if (reason.rfind(prefix, 0) == 0)
+                return false;
+        return true;
+    }
+};
+
+#endif
@@ -8,7 +8,53 @@
 #include <filesystem> // C++17 for filesystem operations
 #include <chrono>
 #include <system_error>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <iomanip>
+#include <regex>
+#include <set>
+#include <ctime>
+#include <condition_variable>
+#include <mutex>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 #include "json.hpp"
+#include "chunk_store.hpp"
+#include "async_io.hpp"
+#include "dir_scanner.hpp"
+#include "bounded_queue.hpp"
+#include "trash.hpp"
+#include "child_process.hpp"
+#include "file_watcher.hpp"
+#include "cmake_file_api.hpp"
+#include "test_runner.hpp"
+#include "test_impact.hpp"
+#include "action_graph.hpp"
+#include "gcov_reader.hpp"
+#include "layout_optimizer.hpp"
+#include "allocators.hpp"
+#include "line_profile.hpp"
+#include "opt_report.hpp"
+#include "package_manifest.hpp"
+#include "size_report.hpp"
+#include "header_cost.hpp"
+#include "header_units.hpp"
+#include "lazy_headers.hpp"
+#include "compile_history.hpp"
+#include "build_deps.hpp"
+#include "toolchain_cache.hpp"
+#include "configure_cache.hpp"
+#include "build_progress.hpp"
+#include "install_plan.hpp"
+#include "startup_profile.hpp"
+#include "flag_tuner.hpp"
+#include "logger.hpp"
 
 using json = nlohmann::json;
 
@@ -17,6 +63,18 @@ class PackageManager
 private:
     std::string configFileName = "TegenConfig.json";
 
+    // Library files at least this large are deduplicated through the chunk store
+    static constexpr uintmax_t chunkedFileThreshold = 1024 * 1024;
+
+    // Copy jobs the scanner may run ahead of the copy workers during install
+    static constexpr size_t streamQueueCapacity = 1024;
+
+    // Peak RSS growth allowed while 'bench --io' streams a tree (TEGEN_BENCH_RSS_LIMIT_MB overrides)
+    static constexpr uint64_t benchRssLimitMb = 64;
+
+    // Quiet period 'watch' waits for after a change before acting on it
+    static constexpr std::chrono::milliseconds watchDebounce{150};
+
     // Helper function to get the current working directory
     std::string getCurrentDirectory()
     {
@@ -50,384 +108,3181 @@ private:
         file << config.dump(4); // Pretty print with 4 spaces
     }
 
-    // Helper function to prompt for user input
-    std::string prompt(const std::string &message, const std::string &defaultValue = "")
+    // Helper function to locate Tegen's global store (TEGEN_HOME overrides the default)
+    std::filesystem::path getStoreDirectory()
     {
-        std::string input;
-        std::cout << message << (defaultValue.empty() ? ": " : " [" + defaultValue + "]: ");
-        std::getline(std::cin, input);
-        return input.empty() ? defaultValue : input;
+        if (const char *home = std::getenv("TEGEN_HOME"))
+            return std::filesystem::path(home) / "store";
+#ifdef _WIN32
+        const char *userHome = std::getenv("USERPROFILE");
+#else
+        const char *userHome = std::getenv("HOME");
+#endif
+        std::filesystem::path base = userHome ? std::filesystem::path(userHome) : std::filesystem::temp_directory_path();
+        return base / ".tegen" / "store";
     }
 
-    // Helper function to execute a system command and handle paths with spaces
-    void executeCommand(const std::string &command)
+    // Helper function to format a byte count for humans
+    static std::string formatBytes(uint64_t bytes)
     {
-        int result = std::system(command.c_str());
-        if (result != 0)
+        const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+        double value = double(bytes);
+        int unit = 0;
+        while (value >= 1024.0 && unit < 4)
         {
-            throw std::runtime_error("Command failed: " + command);
+            value /= 1024.0;
+            unit++;
         }
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << value << " " << units[unit];
+        return out.str();
     }
 
-public:
-    // Initialize a new TegenConfig.json file in the current directory
-    void init()
+    // Helper function to format a duration in milliseconds for humans
+    static std::string formatDuration(double ms)
     {
-        if (configExists())
-        {
-            std::cout << "TegenConfig.json already exists in the current directory." << std::endl;
-            return;
-        }
-
-        json config;
-        std::cout << "Initializing TegenConfig.json and CMake project..." << std::endl;
-
-        // Prompt for project details
-        config["name"] = prompt("Enter project name", "my-package");
-        config["version"] = prompt("Enter project version", "1.0.0");
-        config["author"] = prompt("Enter author name", "Anonymous");
-        config["license"] = prompt("Enter license type", "MIT");
-        config["description"] = prompt("Enter project description", "A C++ project");
-        config["dependencies"] = json::object(); // Initialize dependencies as an empty object
+        std::ostringstream out;
+        if (ms < 1000)
+            out << std::fixed << std::setprecision(0) << ms << " ms";
+        else if (ms < 60000)
+            out << std::fixed << std::setprecision(1) << ms / 1000 << " s";
+        else
+            out << int(ms / 60000) << " min " << int(ms / 1000) % 60 << " s";
+        return out.str();
+    }
 
-        // Save the TegenConfig.json
-        saveConfig(config);
-        std::cout << "Initialized TegenConfig.json in " << getCurrentDirectory() << " with the following details:" << std::endl;
-        std::cout << config.dump(4) << std::endl;
+    // Helper function to copy a directory tree while it is being scanned. The scanner
+    // feeds a bounded queue, so memory does not grow with the number of files and the
+    // first copy starts as soon as the first directory has been read.
+    size_t streamCopyTree(const std::filesystem::path &sourceDir, const std::filesystem::path &targetDir,
+                          AsyncFileIo &io, const AsyncFileIo::Progress &progress = nullptr)
+    {
+        BoundedQueue<AsyncFileIo::CopyJob> queue(streamQueueCapacity);
+        std::atomic<size_t> queued{0};
+        std::exception_ptr scanFailure;
+        std::filesystem::create_directories(targetDir);
 
-        // Create CMake project structure
+        std::thread scanner([&]
+                            {
+            try
+            {
+                DirScanner::Options options;
+                options.sizes = true;
+                DirScanner::scan(sourceDir, options, [&](std::string_view relative, const DirScanner::Entry &entry)
+                                 {
+                    std::string name(relative);
+                    if (entry.type == DirScanner::EntryType::Directory)
+                    {
+                        // Directories arrive before their contents, so targets exist by the time files are queued
+                        std::filesystem::create_directories(targetDir / name);
+                    }
+                    else if (entry.type == DirScanner::EntryType::File)
+                    {
+                        if (!queue.push({sourceDir / name, targetDir / name, entry.size}))
+                            throw std::runtime_error("copy aborted");
+                        queued++;
+                    } });
+            }
+            catch (...)
+            {
+                scanFailure = std::current_exception();
+            }
+            queue.close(); });
 
-        // Create 'src' and 'include' directories
-        std::filesystem::create_directory("src");
-        std::filesystem::create_directory("include");
+        try
+        {
+            io.copy(queue, progress);
+        }
+        catch (...)
+        {
+            queue.close();
+            scanner.join();
+            throw;
+        }
+        scanner.join();
+        if (scanFailure)
+            std::rethrow_exception(scanFailure);
+        return queued;
+    }
 
-        // Create a basic main.cpp in the 'src' folder
-        std::ofstream mainCpp("src/main.cpp");
-        mainCpp << "#include <iostream>" << std::endl;
-        mainCpp << std::endl;
-        mainCpp << "int main() {" << std::endl;
-        mainCpp << "    std::cout << \"Hello, World!\" << std::endl;" << std::endl;
-        mainCpp << "    return 0;" << std::endl;
-        mainCpp << "}" << std::endl;
-        mainCpp.close();
+    // Helper function to reset the process's peak RSS counter; false if the kernel does not support it
+    static bool resetPeakRss()
+    {
+#ifdef __linux__
+        std::ofstream clearRefs("/proc/self/clear_refs");
+        clearRefs << "5";
+        clearRefs.flush();
+        return clearRefs.good();
+#else
+        return false;
+#endif
+    }
 
-        // Create a basic CMakeLists.txt
-        std::ofstream cmakeLists("CMakeLists.txt");
-        cmakeLists << "cmake_minimum_required(VERSION 3.10)" << std::endl;
-        cmakeLists << "project(" << config["name"].get<std::string>() << " VERSION " << config["version"].get<std::string>() << ")" << std::endl;
-        cmakeLists << std::endl;
-        cmakeLists << "set(CMAKE_CXX_STANDARD 17)" << std::endl;
-        cmakeLists << std::endl;
-        cmakeLists << "include_directories(include)" << std::endl;
-        cmakeLists << "add_executable(" << config["name"].get<std::string>() << " src/main.cpp)" << std::endl;
-        cmakeLists.close();
+    // Helper function to read the process's peak RSS in bytes (0 when unknown)
+    static uint64_t peakRssBytes()
+    {
+#ifdef __linux__
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.rfind("VmHWM:", 0) == 0)
+                return std::stoull(line.substr(6)) * 1024;
+        }
+#endif
+        return 0;
+    }
 
-        std::cout << "CMake project structure created:" << std::endl;
-        std::cout << "- src/main.cpp" << std::endl;
-        std::cout << "- include/ (empty for now)" << std::endl;
-        std::cout << "- CMakeLists.txt" << std::endl;
+    // Helper function to pick an executable target from the CMake File API reply: the
+    // named one, else the only one, else the one named after the project
+    bool resolveExecutable(const json &config, const std::string &target, CMakeFileApi::Target &found)
+    {
+        CMakeFileApi api(std::filesystem::current_path() / "build");
+        if (!api.hasReply())
+            return false;
 
-        // Inform user that CMake needs to be installed
-        std::cout << std::endl;
-        std::cout << "Note: You need to have CMake installed on your system to build and install the project." << std::endl;
-        std::cout << "You can download CMake from https://cmake.org/download/" << std::endl;
-        std::cout << std::endl;
+        auto executables = api.executables();
+        std::string wanted = target.empty() ? config["name"].get<std::string>() : target;
+        for (const auto &executable : executables)
+        {
+            if (executable.name == wanted)
+            {
+                found = executable;
+                return true;
+            }
+        }
+        if (target.empty() && executables.size() == 1)
+        {
+            found = executables.front();
+            return true;
+        }
+        return false;
+    }
 
-        // Instructions for building and running with Tegen
-        std::cout << "To build and run your project using Tegen, follow these steps:" << std::endl;
-        std::cout << "1. Install required dependencies:" << std::endl;
-        std::cout << "   tegen install <package-name>" << std::endl;
-        std::cout << "2. Build your project using Tegen:" << std::endl;
-        std::cout << "   tegen build" << std::endl;
-        std::cout << "3. After the build completes, run your project:" << std::endl;
-        std::cout << "   tegen run" << std::endl;
-        std::cout << std::endl;
-        std::cout << "Your project is now ready to build and run with Tegen!" << std::endl;
+    // Why resolveExecutable() found nothing; command is how the user would name a target
+    std::string unresolvedExecutable(const std::string &target, const std::string &command)
+    {
+        if (!target.empty())
+            return "No executable target named '" + target + "'";
+        if (CMakeFileApi(std::filesystem::current_path() / "build").executables().empty())
+            return "The project has no executable targets";
+        return "Several executables found; choose one with '" + command + " <target>'";
     }
 
-    // Install a new package from GitHub
-    void install(const std::string &repository, const std::string &version = "")
+    // resolveTarget for addBuildActions: fills in executable, or fails saying why none was picked
+    std::function<std::string()> executableResolver(const json &config, const std::string &target, CMakeFileApi::Target &executable,
+                                                    const std::string &command)
     {
-        if (!configExists())
+        return [this, &config, target, &executable, command]
         {
-            std::cerr << "TegenConfig.json not found. Run 'init' first." << std::endl;
-            return;
-        }
-
-        json config = loadConfig();
-        std::filesystem::path projectDir = std::filesystem::current_path();
-        std::filesystem::path modulesDir = projectDir / "TegenModules";
-        std::filesystem::path projectInclude = projectDir / "include";
-        std::filesystem::path projectLib = projectDir / "lib";
+            if (!resolveExecutable(config, target, executable))
+                throw std::runtime_error(unresolvedExecutable(target, command));
+            return executable.name;
+        };
+    }
 
-        std::filesystem::create_directories(modulesDir);
-        std::filesystem::create_directories(projectInclude);
-        std::filesystem::create_directories(projectLib);
+    // Helper function to get the path of the project's executable in build/
+    std::filesystem::path executablePath(const json &config, const std::string &target = "")
+    {
+        CMakeFileApi::Target executable;
+        if (resolveExecutable(config, target, executable))
+            return executable.artifacts.front();
 
-        std::string osBranch;
+        // No File API reply yet: fall back to the conventional location
+        std::filesystem::path buildPath = std::filesystem::current_path() / "build" / (target.empty() ? config["name"].get<std::string>() : target);
 #ifdef _WIN32
-        osBranch = "WindowsBranch";
-#elif __APPLE__
-        osBranch = "MacBranch";
-#else
-        osBranch = "LinuxBranch";
+        buildPath += ".exe";
 #endif
+        return buildPath;
+    }
 
-        std::string resolvedVersion = version.empty() ? osBranch : version;
+    std::filesystem::path actionCacheFile()
+    {
+        return std::filesystem::current_path() / "build" / ".tegen" / "actions.json";
+    }
 
-        if (config["dependencies"].contains(repository))
-        {
-            std::cout << "Repository " << repository << " is already installed with version "
-                      << config["dependencies"][repository] << "." << std::endl;
-            return;
-        }
+    // Add the configure and compile actions that build, run, test and bench start from.
+    // resolveTarget runs once configure is done and names the target to build ("" builds all).
+    void addBuildActions(ActionGraph &graph, std::function<std::string()> resolveTarget = nullptr)
+    {
+        prepareAllocators();
+        prepareTunedFlags();
+        prepareCompileHistory();
+        prepareLazyHeaders();
+        bool headerUnits = prepareHeaderUnits();
 
-        try
+        ActionGraph::Action configure;
+        configure.name = "configure";
+        configure.keyParts = {"cmake -S . -B build"};
+        configure.outputs = {"build/CMakeCache.txt"};
+        configure.prepare = [this](ActionGraph::Action &action)
         {
-            std::cout << "Installing package: " << repository << " (branch/version: " << resolvedVersion << ")..." << std::endl;
-
-            std::filesystem::path repoDir = modulesDir / repository;
-
-            // Clone or update repo
-            if (!std::filesystem::exists(repoDir))
+            CMakeFileApi api("build");
+            api.writeQuery();
+            action.inputs = {"CMakeLists.txt", configFileName};
+            for (const auto &file : api.cmakeFiles())
+                action.inputs.push_back(file);
+            // Without a reply the executables are unknown, so configure even if nothing changed
+            action.cacheable = api.hasReply();
+        };
+        configure.work = [this](const ActionGraph::Action &action)
+        {
+            // A fresh build directory starts from the compiler detection and check results of an earlier one
+            std::string key = configureCacheKey();
+            int checks = ConfigureCache::restore("build", getStoreDirectory(), key);
+            if (checks < 0)
             {
-                executeCommand("git clone -b " + resolvedVersion + " https://github.com/TegenPackages/" + repository + ".git \"" + repoDir.string() + "\"");
+                executeCommand(action.keyParts.front());
             }
             else
             {
-                std::cout << "Repository already cloned. Fetching latest changes..." << std::endl;
-                executeCommand("git -C \"" + repoDir.string() + "\" fetch");
-                executeCommand("git -C \"" + repoDir.string() + "\" checkout " + resolvedVersion);
-                executeCommand("git -C \"" + repoDir.string() + "\" pull");
-            }
-
-            // -------------------- COPY HEADERS --------------------
-            auto sourceIncludeDir = repoDir / "include";
-            if (std::filesystem::exists(sourceIncludeDir))
-            {
-                std::cout << "Copying header files..." << std::endl;
-                std::vector<std::filesystem::path> headerFiles;
-                for (const auto &file : std::filesystem::recursive_directory_iterator(sourceIncludeDir))
-                    if (file.is_regular_file())
-                        headerFiles.push_back(file.path());
-
-                size_t total = headerFiles.size();
-                size_t count = 0;
-                for (const auto &file : headerFiles)
+                Log::info() << "Configure: reusing compiler detection and " << checks << " check results from the store.";
+                try
                 {
-                    auto relative = std::filesystem::relative(file, sourceIncludeDir);
-                    auto target = projectInclude / relative;
-                    std::filesystem::create_directories(target.parent_path());
-                    std::filesystem::copy_file(file, target, std::filesystem::copy_options::overwrite_existing);
-                    count++;
-                    int percent = int((count * 100) / total);
-                    std::cout << "\rHeaders [" << std::string(percent / 2, '#') << std::string(50 - percent / 2, ' ')
-                              << "] " << percent << "% (" << count << "/" << total << ")" << std::flush;
+                    executeCommand(action.keyParts.front() + " -C \"" + ConfigureCache::seedFile("build").string() + "\"");
+                }
+                catch (const std::runtime_error &)
+                {
+                    Log::info() << "Configure failed with cached results; configuring from scratch...";
+                    ConfigureCache::discard("build");
+                    executeCommand(action.keyParts.front());
                 }
-                std::cout << std::endl;
             }
+            ConfigureCache::save("build", getStoreDirectory(), key);
+        };
+        graph.add(configure);
 
-            // -------------------- COPY LIBS --------------------
-            auto libDir = repoDir / "lib";
-            while (std::filesystem::exists(libDir) && std::filesystem::is_directory(libDir) && std::distance(std::filesystem::directory_iterator(libDir), std::filesystem::directory_iterator{}) == 1)
+        if (headerUnits)
+        {
+            ActionGraph::Action units;
+            units.name = "header-units";
+            units.deps = {"configure"};
+            units.keyParts = {"header-units"};
+            units.inputs = {"include", "build/CMakeCache.txt", configFileName, ".tegen/manifest.json"};
+            units.outputs = {headerUnitsMapper()};
+            units.work = [this](const ActionGraph::Action &)
+            { updateHeaderUnits(); };
+            graph.add(units);
+        }
+
+        // CMake tracks the individual compile and link steps; this action stands for the whole 'cmake --build'
+        ActionGraph::Action compile;
+        compile.name = "compile";
+        compile.deps = {"configure"};
+        if (headerUnits)
+            compile.deps.push_back("header-units");
+        compile.prepare = [this, resolveTarget, headerUnits](ActionGraph::Action &action)
+        {
+            std::string target = resolveTarget ? resolveTarget() : "";
+            action.keyParts = {"cmake --build build" + (target.empty() ? "" : " --target \"" + target + "\"")};
+            // A compiler upgraded in place leaves CMakeCache.txt as it was
+            std::string compiler = cmakeCacheValue("build", "CMAKE_CXX_COMPILER");
+            if (!compiler.empty())
+                action.keyParts.push_back("toolchain " + ToolchainCache::probe(compiler, getStoreDirectory()).fingerprint());
+            action.inputs = {"src", "include", "lib", "build/CMakeCache.txt"};
+            if (headerUnits)
+                action.inputs.push_back(headerUnitsMapper());
+            CMakeFileApi api("build");
+            for (const auto &file : api.cmakeFiles())
+                action.inputs.push_back(file);
+            // Every target's sources count, since the built target may link the others
+            for (const auto &candidate : api.targets())
             {
-                libDir = *std::filesystem::directory_iterator(libDir);
+                action.inputs.insert(action.inputs.end(), candidate.sources.begin(), candidate.sources.end());
+                if (target.empty() || candidate.name == target)
+                    action.outputs.insert(action.outputs.end(), candidate.artifacts.begin(), candidate.artifacts.end());
             }
-
-            if (std::filesystem::exists(libDir))
+            // Headers outside the directories above (common/, generated, installed) are only known
+            // from the depfiles of the last build; without those, leave it to CMake
+            std::set<std::string> headers;
+            for (const auto &[object, dependencies] : BuildDeps::load("build"))
+                headers.insert(dependencies.begin(), dependencies.end());
+            action.inputs.insert(action.inputs.end(), headers.begin(), headers.end());
+            action.cacheable = !headers.empty();
+        };
+        compile.work = [this](const ActionGraph::Action &action)
+        {
+            std::ifstream in(headerUnitsMapper());
+            std::stringstream mapper;
+            mapper << in.rdbuf();
+            if (mapper.str().empty())
             {
-                std::cout << "Copying library files..." << std::endl;
-                std::vector<std::filesystem::path> libFiles;
-                for (const auto &file : std::filesystem::recursive_directory_iterator(libDir))
-                    if (file.is_regular_file() && (file.path().extension() == ".a" || file.path().extension() == ".lib"))
-                        libFiles.push_back(file.path());
-
-                size_t total = libFiles.size();
-                size_t count = 0;
-                for (const auto &file : libFiles)
-                {
-                    auto target = projectLib / file.filename();
-                    std::filesystem::copy_file(file, target, std::filesystem::copy_options::overwrite_existing);
-                    count++;
-                    int percent = int((count * 100) / total);
-                    std::cout << "\rLibraries [" << std::string(percent / 2, '#') << std::string(50 - percent / 2, ' ')
-                              << "] " << percent << "% (" << count << "/" << total << ")" << std::flush;
-                }
-                std::cout << std::endl;
+                runBuild(action.keyParts.front());
+                return;
             }
-
-            // -------------------- UPDATE CMakeLists.txt --------------------
-            std::filesystem::path cmakeFile = projectDir / "CMakeLists.txt";
-            std::ofstream cmakeOut(cmakeFile, std::ios::app);
-            cmakeOut << "\n# Added by Tegen for " << repository << "\n";
-            cmakeOut << "include_directories(include)\n";
-
-            // Link copied libs
-            for (const auto &libFile : std::filesystem::directory_iterator(projectLib))
+            try
+            {
+                runBuild(action.keyParts.front());
+            }
+            catch (const std::runtime_error &)
             {
-                if (libFile.path().extension() == ".lib" || libFile.path().extension() == ".a")
+                // Header unit support is young in compilers; a clean textual build tells whether they were the cause
+                Log::info() << "Build failed with header units; retrying with textual includes...";
+                auto marker = std::filesystem::path("build") / ".tegen" / "header-units-off";
+                std::filesystem::create_directories(marker.parent_path());
+                std::ofstream(marker) << sha256Hex(mapper.str());
+                std::ofstream(headerUnitsMapper(), std::ios::trunc).close();
+                try
+                {
+                    runBuild(action.keyParts.front() + " --clean-first", true);
+                }
+                catch (const std::runtime_error &)
                 {
-                    cmakeOut << "target_link_libraries(${PROJECT_NAME} PRIVATE \"" << libFile.path().string() << "\")\n";
+                    // Fails either way, so the error is in the project; keep header units
+                    std::filesystem::remove(marker);
+                    std::ofstream(headerUnitsMapper()) << mapper.str();
+                    throw;
                 }
+                Log::info() << "Header units are off for this toolchain and these headers until either changes.";
             }
+        };
+        graph.add(compile);
+    }
 
-#ifdef _WIN32
-            cmakeOut << "target_link_libraries(${PROJECT_NAME} PRIVATE ws2_32 mswsock advapi32)\n";
-#endif
-
-            cmakeOut.close();
-
-            // -------------------- UPDATE CONFIG --------------------
-            config["dependencies"][repository] = resolvedVersion;
-            saveConfig(config);
-
-            // -------------------- CLEAN UP --------------------
-            std::error_code ec;
-            removeFolderRecursively(modulesDir);
-            if (ec)
-                std::cerr << "Warning: could not remove temporary folder " << modulesDir << ": " << ec.message() << std::endl;
+    // What configure results depend on: CMake, the compilers CMake will pick, the generator, the flag
+    // environment and the project (check results are named by the project, not by what they test)
+    std::string configureCacheKey()
+    {
+        auto store = getStoreDirectory();
+        auto environment = [](const char *name)
+        {
+            const char *value = std::getenv(name);
+            return std::string(value ? value : "");
+        };
+        std::string cxx = environment("CXX");
+        std::string cc = environment("CC");
+        Sha256 hasher;
+        hasher.update("cmake " + TestRunner::capture("cmake --version") + '\n');
+        hasher.update("cxx " + ToolchainCache::probe(cxx.empty() ? "c++" : cxx, store).fingerprint() + '\n');
+        hasher.update("cc " + ToolchainCache::probe(cc.empty() ? "cc" : cc, store).fingerprint() + '\n');
+        for (const char *name : {"CMAKE_GENERATOR", "CFLAGS", "CXXFLAGS", "LDFLAGS"})
+            hasher.update(std::string(name) + " " + environment(name) + '\n');
+        hasher.update("project " + loadConfig().value("name", "") + '\n');
+        return hasher.hexDigest();
+    }
 
-            std::cout << "Package " << repository << " successfully installed, integrated, and cleaned up!" << std::endl;
+    // 'cmake --build' without a status line: its output is logged line by line, which in quiet mode shows only
+    // when the build fails
+    void runBuildPlain(const std::string &command)
+    {
+        Log::flush();
+        FILE *pipe = TEGEN_POPEN((command + " 2>&1").c_str(), "r");
+        if (!pipe)
+            throw std::runtime_error("Command failed: " + command);
+        std::vector<std::string> lines;
+        char buffer[4096];
+        std::string line;
+        while (std::fgets(buffer, sizeof(buffer), pipe))
+        {
+            line += buffer;
+            if (line.back() != '\n')
+                continue;
+            line.pop_back();
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            Log::info() << line;
+            lines.push_back(line);
+            line.clear();
         }
-        catch (const std::exception &e)
+        if (!line.empty())
         {
-            std::cerr << "Failed to install package: " << e.what() << std::endl;
+            Log::info() << line;
+            lines.push_back(line);
         }
+        if (TEGEN_PCLOSE(pipe) == 0)
+            return;
+        if (Log::mode() == Log::Mode::Quiet)
+            for (const auto &output : lines)
+                Log::error() << output;
+        throw std::runtime_error("Command failed: " + command);
     }
 
-    void removeFolderRecursively(const std::filesystem::path &folder)
+    // Parallel jobs 'cmake --build' runs: Makefiles build one at a time unless told otherwise; Ninja uses every core
+    static unsigned buildJobs()
     {
-        std::error_code ec;
+        if (const char *level = std::getenv("CMAKE_BUILD_PARALLEL_LEVEL"))
+            return unsigned(std::max(1, std::atoi(level)));
+        if (std::filesystem::exists("build/build.ninja"))
+            return std::max(1u, std::thread::hardware_concurrency());
+        return 1;
+    }
 
-#ifdef _WIN32
-        for (auto &entry : std::filesystem::recursive_directory_iterator(folder, std::filesystem::directory_options::skip_permission_denied))
+    // What the next build would do, from the last build's depfiles and compile times; nothing is configured or compiled
+    void planBuild()
+    {
+        Log::info() << "Plan for building the project:";
+        if (!std::filesystem::exists("build/CMakeCache.txt"))
         {
-            std::filesystem::permissions(entry, std::filesystem::perms::owner_all, std::filesystem::perm_options::add, ec);
-            // ignore ec, just try to make it writable
+            bool cached = std::filesystem::exists(getStoreDirectory() / "configure-cache" / configureCacheKey() / "seed.cmake");
+            Log::info() << "  Configure:    fresh build directory" << (cached ? " (compiler detection and checks from the store)" : "");
+            Log::info() << "  Compile:      every source; no earlier build to compare with";
+            Log::info() << "Dry run: nothing was built.";
+            return;
         }
-#endif
-
-        std::filesystem::remove_all(folder, ec);
-        if (ec)
+        CompileHistory history("build");
+        auto plan = BuildProgress::plan("build", CMakeFileApi("build").targets(), history, false);
+        size_t objects = plan.objects.size() + plan.unknownObjects;
+        unsigned jobs = buildJobs();
+        auto compile = Log::info();
+        compile << "  Compile:      " << objects << " objects";
+        if (plan.unknownObjects > 0)
+            compile << " (" << plan.unknownObjects << " never compiled)";
+        compile << ", " << plan.links.size() << " links";
+        if (objects + plan.links.size() > 0)
         {
-            std::cerr << "Warning: Failed to completely remove " << folder << ": " << ec.message() << std::endl;
+            if (history.empty())
+                Log::info() << "  Time:         unknown until a build has been timed here";
+            else
+                Log::info() << "  Time:         about " << formatDuration(BuildProgress("build", plan, history, jobs, false).predictedMs())
+                            << " with " << jobs << " job" << (jobs == 1 ? "" : "s");
         }
+        Log::info() << "Dry run: nothing was built.";
     }
 
-    // List all dependencies
-    void listDependencies()
+    // Run 'cmake --build' showing what is compiling and the time left (see BuildProgress); throws when it fails
+    void runBuild(const std::string &command, bool clean = false)
     {
-        if (!configExists())
+        if (Log::mode() == Log::Mode::Quiet || Log::mode() == Log::Mode::Json)
         {
-            std::cerr << "TegenConfig.json not found in the current directory." << std::endl;
+            runBuildPlain(command);
             return;
         }
+        CompileHistory history("build");
+        auto plan = BuildProgress::plan("build", CMakeFileApi("build").targets(), history, clean);
+        BuildProgress progress("build", plan, history, buildJobs(), terminalOutput());
+
+        Log::flush();
+        FILE *pipe = TEGEN_POPEN((command + " 2>&1").c_str(), "r");
+        if (!pipe)
+            throw std::runtime_error("Command failed: " + command);
+        std::mutex lock;
+        std::condition_variable wake;
+        bool done = false;
+        std::thread ticker([&]
+                           {
+                               std::unique_lock<std::mutex> guard(lock);
+                               while (!wake.wait_for(guard, std::chrono::milliseconds(250), [&] { return done; }))
+                                   progress.tick(); });
+        char buffer[4096];
+        std::string line;
+        while (std::fgets(buffer, sizeof(buffer), pipe))
+        {
+            line += buffer;
+            if (line.back() != '\n')
+                continue;
+            line.pop_back();
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            progress.output(line);
+            line.clear();
+        }
+        if (!line.empty())
+            progress.output(line);
+        int status = TEGEN_PCLOSE(pipe);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            done = true;
+        }
+        wake.notify_one();
+        ticker.join();
+        progress.finish(status == 0);
+        if (status != 0)
+            throw std::runtime_error("Command failed: " + command);
+    }
+
+    std::string headerUnitsMapper()
+    {
+        return ".tegen/header-units.map";
+    }
 
+    static std::string sha256Hex(const std::string &data)
+    {
+        Sha256 hasher;
+        hasher.update(data);
+        return hasher.hexDigest();
+    }
+
+    // Keep cmake/TegenHeaderUnits.cmake and the mapper file in place; returns whether "headerUnits" is on.
+    // Turning it off leaves an empty mapper, which is the same as textual includes.
+    bool prepareHeaderUnits()
+    {
         json config = loadConfig();
-        std::cout << "Dependencies:" << std::endl;
+        bool enabled = config.value("headerUnits", false);
+        auto projectDir = std::filesystem::current_path();
+        auto mapper = projectDir / headerUnitsMapper();
+        if (!enabled)
+        {
+            if (std::filesystem::exists(mapper) && std::filesystem::file_size(mapper) > 0)
+                std::ofstream(mapper, std::ios::trunc).close();
+            return false;
+        }
 
-        for (const auto &[key, value] : config["dependencies"].items())
+        if (!std::filesystem::exists(mapper))
         {
-            std::cout << "  - " << key << ": " << value << std::endl;
+            std::filesystem::create_directories(mapper.parent_path());
+            std::ofstream(mapper).close();
         }
+        writeCMakeModule("TegenHeaderUnits.cmake", HeaderUnits::cmakeModule(headerUnitsMapper()), "header units");
+        return true;
     }
 
-    // Build the project using CMake
-    void build()
+    // Build (or take from the store) header units for every dependency and write the mapper
+    void updateHeaderUnits()
     {
-        if (!configExists())
+        auto projectDir = std::filesystem::current_path();
+        auto mapperFile = projectDir / headerUnitsMapper();
+        auto disable = [&](const std::string &reason)
         {
-            std::cerr << "TegenConfig.json not found in the current directory. Run 'init' first." << std::endl;
-            return;
-        }
+            Log::info() << "Header units off (" << reason << "); using textual includes.";
+            std::ofstream(mapperFile, std::ios::trunc).close();
+        };
 
-        std::cout << "Building the project..." << std::endl;
+        std::string compiler = cmakeCacheValue("build", "CMAKE_CXX_COMPILER");
+        std::string reason;
+        if (compiler.empty())
+            return disable("no configured C++ compiler");
+        auto info = ToolchainCache::probe(compiler, getStoreDirectory());
+        if (!HeaderUnits::supported(info, reason))
+            return disable(reason);
 
-        // Create build directory if it doesn't exist
-        std::filesystem::create_directory("build");
+        // Units must be built with the dialect and build-type flags the project's sources use
+        auto options = headerCostOptions();
+        std::string buildType = cmakeCacheValue("build", "CMAKE_BUILD_TYPE");
+        std::transform(buildType.begin(), buildType.end(), buildType.begin(), [](unsigned char c)
+                       { return char(std::toupper(c)); });
+        HeaderUnits::Toolchain toolchain;
+        toolchain.compiler = compiler;
+        toolchain.flags = "-std=gnu++" + options.standard + " " + cmakeCacheValue("build", "CMAKE_CXX_FLAGS") +
+                          (buildType.empty() ? "" : " " + cmakeCacheValue("build", "CMAKE_CXX_FLAGS_" + buildType));
+        toolchain.fingerprint = HeaderUnits::fingerprint(info, toolchain.flags);
 
-        // Run cmake to configure the project
-        executeCommand("cmake -S . -B build");
+        json config = loadConfig();
+        PackageManifest manifest(projectDir);
+        std::map<std::string, std::filesystem::path> units;
+        size_t built = 0;
+        for (const auto &[name, version] : config["dependencies"].items())
+        {
+            auto headers = packageHeaders(name, manifest);
+            // Lazily installed headers not materialized yet are not included by anything
+            headers.erase(std::remove_if(headers.begin(), headers.end(), [&](const std::string &header)
+                                         { return !std::filesystem::exists(projectDir / header); }),
+                          headers.end());
+            if (headers.empty())
+                continue;
+            auto prepared = HeaderUnits::prepare(headers, projectDir, getStoreDirectory(), toolchain, &built);
+            units.insert(prepared.begin(), prepared.end());
+        }
 
-        // Run make to build the project
-        executeCommand("cmake --build build");
+        std::string content = HeaderUnits::mapper(units, projectDir);
+        std::ifstream marker(projectDir / "build" / ".tegen" / "header-units-off");
+        std::string failed;
+        std::getline(marker, failed);
+        if (!content.empty() && failed == sha256Hex(content))
+            return disable("a build with these units failed");
+        std::ofstream(mapperFile, std::ios::trunc) << content;
+        Log::info() << "Header units: " << units.size() << " dependency headers precompiled (" << built << " built now, "
+                    << units.size() - std::min(built, units.size()) << " from the store).";
+    }
 
-        std::cout << "Build completed successfully. The project is located in the 'build/' directory." << std::endl;
+    // Headers a dependency installed, from the manifest or, for older installs, include/<name>/
+    std::vector<std::string> packageHeaders(const std::string &name, const PackageManifest &manifest)
+    {
+        auto found = manifest.packages().find(name);
+        if (found != manifest.packages().end())
+            return found->second.headers;
+        std::vector<std::string> headers;
+        auto root = std::filesystem::path("include") / name;
+        if (!std::filesystem::is_directory(root))
+            return headers;
+        auto scan = DirScanner::scan(root);
+        for (const auto &entry : scan.entries())
+            if (entry.type == DirScanner::EntryType::File)
+                headers.push_back("include/" + name + "/" + std::string(scan.relative(entry)));
+        std::sort(headers.begin(), headers.end());
+        return headers;
     }
 
-    void run()
+    // Keep cmake/TegenAllocator.cmake current with the allocators the build profiles name
+    void prepareAllocators()
     {
-        if (!configExists())
-        {
-            // Red for errors
-#ifdef _WIN32
-            std::cerr << "\x1B[31m"; // Red
-#endif
-            std::cerr << "TegenConfig.json not found in the current directory. Run 'init' first." << std::endl;
-#ifdef _WIN32
-            std::cerr << "\x1B[0m"; // Reset
-#endif
+        json config = loadConfig();
+        auto profiles = Allocators::profiles(config);
+        if (profiles.empty())
             return;
-        }
 
+        writeCMakeModule("TegenAllocator.cmake", Allocators::cmakeModule(config), "allocator profiles");
+    }
+
+    // Keep cmake/TegenFlags.cmake current once 'tegen tune' has saved flags for a profile
+    void prepareTunedFlags()
+    {
         json config = loadConfig();
-        std::string projectName = config["name"].get<std::string>();
+        if (FlagTuner::hasFlags(config))
+            writeCMakeModule("TegenFlags.cmake", FlagTuner::cmakeModule(config), "tuned compiler flags");
+    }
 
-        // Yellow for info
-#ifdef _WIN32
-        std::cout << "\x1B[33m"; // Yellow
-#endif
-        std::cout << "Running the project..." << std::endl;
-#ifdef _WIN32
-        std::cout << "\x1B[0m"; // Reset
-#endif
+    // Keep a generated cmake/<name> current (rewritten only when it changes, so CMake does not
+    // reconfigure needlessly) and include it once at the end of CMakeLists.txt
+    void writeCMakeModule(const std::string &name, const std::string &content, const std::string &purpose)
+    {
+        auto projectDir = std::filesystem::current_path();
+        auto module = projectDir / "cmake" / name;
+        std::ifstream current(module);
+        std::stringstream existing;
+        existing << current.rdbuf();
+        if (existing.str() != content)
+        {
+            std::filesystem::create_directories(module.parent_path());
+            std::ofstream(module) << content;
+        }
 
-        // Build cross-platform executable path
-        std::filesystem::path buildPath = std::filesystem::current_path() / "build" / projectName;
-#ifdef _WIN32
-        buildPath += ".exe";
-#endif
+        std::ifstream cmakeIn(projectDir / "CMakeLists.txt");
+        std::stringstream cmakeLists;
+        cmakeLists << cmakeIn.rdbuf();
+        if (cmakeLists.str().find("cmake/" + name) == std::string::npos)
+        {
+            std::ofstream cmakeOut(projectDir / "CMakeLists.txt", std::ios::app);
+            cmakeOut << "\n# Added by Tegen for " << purpose << "\n";
+            cmakeOut << "include(cmake/" << name << " OPTIONAL)\n";
+        }
+    }
 
-        if (!std::filesystem::exists(buildPath))
+    // Time every compile through tegen itself (see CompileHistory)
+    void prepareCompileHistory()
+    {
+        if (!compileLauncher())
         {
-#ifdef _WIN32
-            std::cerr << "\x1B[31m"; // Red
-#endif
-            std::cerr << "Executable not found: " << buildPath << std::endl;
-            std::cerr << "Make sure the project is built before running." << std::endl;
-#ifdef _WIN32
-            std::cerr << "\x1B[0m"; // Reset
-#endif
+            // Turned off after being on: the OPTIONAL include in CMakeLists.txt then finds nothing
+            std::filesystem::remove(std::filesystem::current_path() / "cmake" / "TegenCompileHistory.cmake");
             return;
         }
+        std::string self = selfExecutable();
+        writeCMakeModule("TegenCompileHistory.cmake", CompileHistory::cmakeModule(std::filesystem::path(self).generic_string()),
+                         "compile timing");
+    }
 
-        std::string command = "\"" + buildPath.string() + "\"";
+    // Whether compiles run through tegen (see CompileHistory): only when TegenConfig.json asks for it
+    // with "compileHistory": true, since it edits CMakeLists.txt and wraps every compile and link
+    bool compileLauncher()
+    {
+        return loadConfig().value("compileHistory", false) && std::filesystem::path(selfExecutable()).is_absolute();
+    }
 
-        auto start = std::chrono::high_resolution_clock::now();
-        int result = std::system(command.c_str());
-        auto end = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    // Keep the launcher's index of lazily installed headers current, fold the headers compiles asked for into
+    // the manifest, and put back used headers missing from include/ (a fresh checkout, say)
+    void prepareLazyHeaders()
+    {
+        auto projectDir = std::filesystem::current_path();
+        PackageManifest manifest(projectDir);
+        std::map<std::string, std::string> digests;
+        for (const auto &[name, package] : manifest.packages())
+            if (package.lazy)
+                digests.insert(package.digests.begin(), package.digests.end());
+        LazyHeaders::writeIndex(projectDir, getStoreDirectory(), digests);
+        if (digests.empty())
+            return;
 
-        if (result != 0)
-        {
-#ifdef _WIN32
-            std::cerr << "\x1B[31m"; // Red
-#endif
-            std::cerr << "Failed to run the project. Make sure it's built correctly." << std::endl;
-#ifdef _WIN32
-            std::cerr << "\x1B[0m"; // Reset
-#endif
-        }
-        else
+        // Without the launcher nothing materializes on demand, so everything is
+        bool onDemand = compileLauncher();
+        auto used = LazyHeaders::takeUsed(projectDir);
+        LazyHeaders lazy(projectDir);
+        size_t restored = 0;
+        bool changed = false;
+        auto packages = manifest.packages();
+        for (auto &[name, package] : packages)
         {
-#ifdef _WIN32
-            std::cout << "\x1B[32m"; // Green
-#endif
-            std::cout << "Project finished successfully in " << duration << " ms." << std::endl;
-#ifdef _WIN32
-            std::cout << "\x1B[0m"; // Reset
-#endif
-        }
+            if (!package.lazy)
+                continue;
+            for (const auto &header : used)
+            {
+                if (package.digests.count(header) && std::find(package.used.begin(), package.used.end(), header) == package.used.end())
+                {
+                    package.used.push_back(header);
+                    changed = true;
+                }
+            }
+            std::sort(package.used.begin(), package.used.end());
+            for (const auto &header : onDemand ? package.used : package.headers)
+            {
+                if (std::filesystem::exists(projectDir / header))
+                    continue;
+                try
+                {
+                    lazy.materialize(header);
+                    restored++;
+                }
+                catch (const std::exception &e)
+                {
+                    Log::error() << "Cannot restore " << header << " (" << e.what() << "); reinstall " << name << ".";
+                }
+            }
+            manifest.set(name, package);
+        }
+        if (changed)
+            manifest.save();
+        if (restored > 0)
+            Log::info() << "Materialized " << restored << " lazily installed headers from the store.";
+    }
+
+    // VAR=value prefix for launching the executable with spec's allocator settings ("" on Windows)
+    std::string allocatorEnvironment(const Allocators::Spec &spec)
+    {
+        std::string prefix;
+        for (const auto &[key, value] : allocatorVariables(spec))
+            prefix += key + "=" + TestRunner::shellQuote(value) + " ";
+        return prefix;
+    }
+
+    // The same settings as variables, preload first
+    std::vector<std::pair<std::string, std::string>> allocatorVariables(const Allocators::Spec &spec)
+    {
+        std::vector<std::pair<std::string, std::string>> variables;
+#ifndef _WIN32
+        if (spec.mode == "preload" && spec.name != "system")
+        {
+            auto library = Allocators::findShared(spec.name, std::filesystem::current_path() / "lib");
+            if (library.empty())
+                Log::error() << "Allocator " << spec.name << " is not installed (" << Allocators::installHint(spec.name)
+                             << "); running with the system allocator.";
+            else
+                variables.emplace_back(Allocators::preloadVariable(), library.string());
+        }
+        for (const auto &[key, value] : Allocators::environment(spec))
+            variables.emplace_back(key, value);
+#endif
+        return variables;
+    }
+
+    std::string cmakeCacheValue(const std::filesystem::path &buildDir, const std::string &name)
+    {
+        std::ifstream cache(buildDir / "CMakeCache.txt");
+        for (std::string line; std::getline(cache, line);)
+            if (line.rfind(name + ":", 0) == 0)
+                return line.substr(line.find('=') + 1);
+        return "";
+    }
+
+    // Compiler and language standard the project builds with, for scoring headers
+    HeaderCost::Options headerCostOptions()
+    {
+        HeaderCost::Options options;
+        std::string compiler = cmakeCacheValue("build", "CMAKE_CXX_COMPILER");
+        const char *cxx = std::getenv("CXX");
+        options.compiler = !compiler.empty() ? compiler : (cxx && *cxx ? cxx : "c++");
+        std::ifstream cmakeLists("CMakeLists.txt");
+        std::stringstream text;
+        text << cmakeLists.rdbuf();
+        std::smatch match;
+        std::string content = text.str();
+        static const std::regex standard(R"(CMAKE_CXX_STANDARD\s+(\d+))");
+        if (std::regex_search(content, match, standard))
+            options.standard = match[1];
+        options.includeDir = std::filesystem::current_path() / "include";
+        options.workDir = std::filesystem::current_path() / "build" / ".tegen" / "header-cost";
+        return options;
+    }
+
+    // Measure a package's headers into its manifest entry (MSVC has no -H/-fsyntax-only; skipped there)
+    bool scoreHeaders(PackageManifest::Package &package)
+    {
+        auto options = headerCostOptions();
+        auto compiler = std::filesystem::path(options.compiler).stem().string();
+        if (compiler == "cl" || compiler == "clang-cl")
+            return false;
+        // Lazily installed headers are scored once a compile has brought them in
+        std::vector<std::string> present;
+        for (const auto &header : package.headers)
+            if (std::filesystem::exists(header))
+                present.push_back(header);
+        if (present.empty())
+            return false;
+        package.costs = HeaderCost::measureAll(present, std::filesystem::current_path(), options);
+        Trash::removeTree(options.workDir);
+        return true;
+    }
+
+    // Configure and build a flag variant of the project in its own tree (buildType defaults to the main
+    // build's). Returns the artifact of target, or an empty path when target is empty. With a log, the
+    // build output (compiler diagnostics included) goes there instead of the terminal.
+    std::filesystem::path buildVariant(const std::filesystem::path &dir, const std::string &compileFlags,
+                                       const std::string &linkFlags, const std::string &target,
+                                       const std::string &buildType = "", const std::filesystem::path &log = "")
+    {
+        CMakeFileApi api(dir);
+        api.writeQuery();
+        std::string type = buildType.empty() ? cmakeCacheValue("build", "CMAKE_BUILD_TYPE") : buildType;
+        std::string configure = "cmake -S . -B \"" + dir.string() + "\" -DCMAKE_BUILD_TYPE=\"" + type +
+                                "\" -DCMAKE_C_FLAGS=\"" + compileFlags + "\" -DCMAKE_CXX_FLAGS=\"" + compileFlags +
+                                "\" -DCMAKE_EXE_LINKER_FLAGS=\"" + linkFlags + "\"";
+        std::string build = "cmake --build \"" + dir.string() + "\"" + (target.empty() ? "" : " --target \"" + target + "\"");
+        if (!log.empty())
+        {
+            // Every object is rebuilt so each one reports, not just the ones that changed
+            std::string redirect = " >> \"" + log.string() + "\" 2>&1";
+            std::filesystem::remove(log);
+            configure += redirect;
+            build += " --clean-first" + redirect;
+        }
+        Log::flush();
+        if (ChildProcess::run(configure) != 0 || ChildProcess::run(build) != 0)
+            throw std::runtime_error("Failed to build the variant in " + dir.string() + (log.empty() ? "" : " (see " + log.string() + ")"));
+        if (target.empty())
+            return {};
+        for (const auto &candidate : api.executables())
+            if (candidate.name == target)
+                return candidate.artifacts.front();
+        throw std::runtime_error("The variant in " + dir.string() + " has no executable " + target);
+    }
+
+    // Configure and build one 'tegen tune' variant in build/.tegen/tune/<key>, which is kept so the next search
+    // only recompiles what changed. The flags reach the project through cmake/TegenFlags.cmake; a fresh tree is
+    // seeded from the configure cache. Output goes to <key>.log. Returns the artifact of target.
+    std::filesystem::path buildTuneVariant(const std::filesystem::path &workDir, const FlagTuner::Flags &flags, const std::string &buildType,
+                                           const std::string &target, const std::string &configureKey, const std::string &launcher,
+                                           unsigned parallel, std::mutex &storeLock)
+    {
+        auto dir = workDir / FlagTuner::key(flags);
+        auto log = workDir / (FlagTuner::key(flags) + ".log");
+        std::filesystem::remove(log);
+        std::string redirect = " >> \"" + log.string() + "\" 2>&1";
+        CMakeFileApi api(dir);
+        api.writeQuery();
+        std::string configure = "cmake -S . -B \"" + dir.string() + "\" -DCMAKE_BUILD_TYPE=\"" + buildType + "\" -DTEGEN_TUNE_COMPILE=\"" +
+                                flags.compile + "\" -DTEGEN_TUNE_LINK=\"" + flags.link + "\"";
+        if (!launcher.empty())
+            configure += " -DCMAKE_C_COMPILER_LAUNCHER=" + launcher + " -DCMAKE_CXX_COMPILER_LAUNCHER=" + launcher;
+        bool seeded = ConfigureCache::restore(dir, getStoreDirectory(), configureKey) >= 0;
+        if (ChildProcess::run(configure + (seeded ? " -C \"" + ConfigureCache::seedFile(dir).string() + "\"" : "") + redirect) != 0)
+        {
+            if (!seeded)
+                throw std::runtime_error("configure failed (see " + log.string() + ")");
+            ConfigureCache::discard(dir);
+            if (ChildProcess::run(configure + redirect) != 0)
+                throw std::runtime_error("configure failed (see " + log.string() + ")");
+        }
+        {
+            std::lock_guard<std::mutex> guard(storeLock);
+            ConfigureCache::save(dir, getStoreDirectory(), configureKey);
+        }
+        if (ChildProcess::run("cmake --build \"" + dir.string() + "\" --target \"" + target + "\" -j " + std::to_string(parallel) + redirect) != 0)
+            throw std::runtime_error("build failed (see " + log.string() + ")");
+        for (const auto &candidate : api.executables())
+            if (candidate.name == target)
+                return candidate.artifacts.front();
+        throw std::runtime_error("no executable " + target + " in " + dir.string());
+    }
+
+    // Helper function to locate the running tegen binary, for re-invoking it as a child
+    static std::string selfExecutable()
+    {
+#ifdef __linux__
+        std::error_code ec;
+        auto self = std::filesystem::read_symlink("/proc/self/exe", ec);
+        if (!ec)
+            return self.string();
+#endif
+        return "tegen";
+    }
+
+    // Set by the SIGINT handler while 'watch' is running
+    static inline volatile std::sig_atomic_t interrupted = 0;
+
+    // Whether stdout is a terminal, so a status line can be redrawn in place
+    static bool terminalOutput()
+    {
+#ifdef _WIN32
+        return _isatty(_fileno(stdout)) != 0;
+#else
+        return ::isatty(STDOUT_FILENO) != 0;
+#endif
+    }
+
+    // Whether stdin is a terminal, so a question can be asked
+    static bool interactive()
+    {
+#ifdef _WIN32
+        return _isatty(_fileno(stdin)) != 0;
+#else
+        return ::isatty(STDIN_FILENO) != 0;
+#endif
+    }
+
+    // ANSI color around run's messages, which only Windows consoles have been given
+    static const char *color(const char *code)
+    {
+#ifdef _WIN32
+        return code;
+#else
+        (void)code;
+        return "";
+#endif
+    }
+
+    // Helper function to prompt for user input
+    std::string prompt(const std::string &message, const std::string &defaultValue = "")
+    {
+        std::string input;
+        Log::flush();
+        std::cout << message << (defaultValue.empty() ? ": " : " [" + defaultValue + "]: ");
+        std::getline(std::cin, input);
+        return input.empty() ? defaultValue : input;
+    }
+
+    // Where the output of a tool Tegen runs goes: nowhere in quiet mode, and to stderr in JSON mode so
+    // that stdout holds nothing but log records
+    static std::string toolOutputRedirect()
+    {
+        if (Log::mode() == Log::Mode::Json)
+            return " 1>&2";
+        if (Log::mode() != Log::Mode::Quiet)
+            return "";
+#ifdef _WIN32
+        return " >NUL";
+#else
+        return " >/dev/null";
+#endif
+    }
+
+    // Helper function to execute a system command and handle paths with spaces
+    void executeCommand(const std::string &command)
+    {
+        Log::verbose() << "$ " << command;
+        Log::flush();
+        int result = std::system((command + toolOutputRedirect()).c_str());
+        if (result != 0)
+        {
+            throw std::runtime_error("Command failed: " + command);
+        }
+    }
+
+    // Branch packages publish for this platform, used when no version is given
+    static std::string defaultBranch()
+    {
+#ifdef _WIN32
+        return "WindowsBranch";
+#elif __APPLE__
+        return "MacBranch";
+#else
+        return "LinuxBranch";
+#endif
+    }
+
+    static std::string packageUrl(const std::string &repository)
+    {
+        return "https://github.com/TegenPackages/" + repository + ".git";
+    }
+
+    // Clone a package into repoDir, or bring an existing clone to version. A fresh clone downloads only
+    // the files the store does not have (see InstallPlan) and returns the package's file list; a full
+    // clone (no partial clone support) or an existing one returns nothing.
+    std::vector<InstallPlan::File> fetchPackage(const std::string &repository, const std::string &version,
+                                                const std::filesystem::path &repoDir)
+    {
+        // Clone or update repo
+        if (!std::filesystem::exists(repoDir))
+        {
+            auto storeDir = getStoreDirectory();
+            if (InstallPlan::cloneTree(packageUrl(repository), version, repoDir))
+            {
+                auto tree = InstallPlan::listTree(repoDir);
+                auto plan = InstallPlan::classify(repository, version, false, tree, storeDir);
+                auto started = std::chrono::steady_clock::now();
+                if (!plan.fetch.empty())
+                {
+                    // One checkout, so the missing blobs come down in one batch
+                    auto pathspecs = repoDir / ".git" / "tegen-fetch";
+                    std::ofstream list(pathspecs, std::ios::binary);
+                    for (const auto &file : plan.fetch)
+                        list << file.path << '\0';
+                    list.close();
+                    executeCommand("git --literal-pathspecs -C \"" + repoDir.string() + "\" checkout --quiet HEAD --pathspec-from-file=\"" +
+                                   pathspecs.string() + "\" --pathspec-file-nul");
+                    InstallPlan::record(storeDir, "fetch", double(plan.fetchBytes()),
+                                        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count());
+                }
+                ChunkStore store(storeDir);
+                auto blobs = InstallPlan::loadBlobs(storeDir);
+                for (const auto &file : plan.reused)
+                {
+                    std::filesystem::create_directories((repoDir / file.path).parent_path());
+                    store.materialize(blobs[file.blob], repoDir / file.path);
+                }
+                if (!plan.reused.empty())
+                    Log::info() << "Fetched " << plan.fetch.size() << " files (" << formatBytes(plan.fetchBytes()) << "); "
+                                << plan.reused.size() << " (" << formatBytes(plan.reusedBytes()) << ") came from the store.";
+                return tree;
+            }
+            std::error_code ec;
+            std::filesystem::remove_all(repoDir, ec);
+            executeCommand("git clone -b " + version + " " + packageUrl(repository) + " \"" + repoDir.string() + "\"");
+        }
+        else
+        {
+            Log::info() << "Repository already cloned. Fetching latest changes...";
+            executeCommand("git -C \"" + repoDir.string() + "\" fetch");
+            executeCommand("git -C \"" + repoDir.string() + "\" checkout " + version);
+            executeCommand("git -C \"" + repoDir.string() + "\" pull");
+        }
+        return {};
+    }
+
+    // Note the blob ids of files a package put in the store (lazy headers, large libraries), so the next
+    // install of a version sharing them materializes them instead of downloading them
+    void rememberStoredBlobs(const std::filesystem::path &repoDir, const std::vector<InstallPlan::File> &tree,
+                             const PackageManifest::Package &owned)
+    {
+        auto storeDir = getStoreDirectory();
+        auto known = InstallPlan::loadBlobs(storeDir);
+        std::map<std::string, std::string> added;
+        for (const auto &file : tree)
+        {
+            if (known.count(file.blob))
+                continue;
+            auto digest = owned.digests.find(file.path);
+            auto extension = std::filesystem::path(file.path).extension();
+            if (digest != owned.digests.end())
+                added[file.blob] = digest->second;
+            else if (file.path.rfind("lib/", 0) == 0 && (extension == ".a" || extension == ".lib") && file.size >= chunkedFileThreshold)
+                added[file.blob] = Sha256::hashFile(repoDir / file.path);
+        }
+        InstallPlan::rememberBlobs(storeDir, added);
+    }
+
+    // Copy a fetched package's include/ into the project, recording the files it brings in. A lazy package's
+    // headers only go into the store; those already in include/ (used by earlier compiles) are refreshed.
+    void copyPackageHeaders(const std::filesystem::path &repoDir, const std::filesystem::path &projectInclude,
+                            PackageManifest::Package &owned)
+    {
+        auto sourceIncludeDir = repoDir / "include";
+        if (!std::filesystem::exists(sourceIncludeDir))
+            return;
+        if (owned.lazy)
+        {
+            Log::info() << "Storing header files for lazy use...";
+            ChunkStore store(getStoreDirectory());
+            auto sourceHeaders = DirScanner::scan(sourceIncludeDir);
+            size_t refreshed = 0;
+            owned.digests.clear();
+            for (const auto &entry : sourceHeaders.entries())
+            {
+                if (entry.type != DirScanner::EntryType::File)
+                    continue;
+                std::string relative(sourceHeaders.relative(entry));
+                std::string header = "include/" + relative;
+                owned.headers.push_back(header);
+                owned.digests[header] = store.put(sourceHeaders.path(entry)).digest;
+                if (std::filesystem::exists(projectInclude / relative))
+                {
+                    store.materialize(owned.digests[header], projectInclude / relative);
+                    refreshed++;
+                }
+            }
+            Log::info() << "Headers recorded: " << owned.headers.size() << " (" << refreshed
+                        << " in include/; the rest are copied in when a compile includes them)";
+            return;
+        }
+        Log::info() << "Copying header files...";
+        auto sourceHeaders = DirScanner::scan(sourceIncludeDir);
+        for (const auto &entry : sourceHeaders.entries())
+            if (entry.type == DirScanner::EntryType::File)
+                owned.headers.push_back("include/" + std::string(sourceHeaders.relative(entry)));
+        AsyncFileIo io;
+        size_t copied = streamCopyTree(sourceIncludeDir, projectInclude, io);
+        Log::info() << "Headers copied: " << copied;
+    }
+
+    // Copy a fetched package's static libraries into lib/, recording their names
+    void copyPackageLibraries(const std::filesystem::path &repoDir, const std::filesystem::path &projectLib,
+                              PackageManifest::Package &owned)
+    {
+        auto libDir = repoDir / "lib";
+        if (std::filesystem::is_directory(libDir))
+        {
+            // Descend through single-directory wrappers (e.g. lib/x64/) to the real library root
+            DirScanner::Options shallow;
+            shallow.recursive = false;
+            shallow.threads = 1;
+            auto level = DirScanner::scan(libDir, shallow);
+            while (level.size() == 1 && level.entries()[0].type == DirScanner::EntryType::Directory)
+            {
+                libDir = level.path(level.entries()[0]);
+                level = DirScanner::scan(libDir, shallow);
+            }
+
+            Log::info() << "Copying library files...";
+            std::vector<std::filesystem::path> libFiles;
+            auto libraries = DirScanner::scan(libDir);
+            for (const auto &entry : libraries.entries())
+            {
+                if (entry.type != DirScanner::EntryType::File)
+                    continue;
+                auto relative = libraries.relative(entry);
+                auto dot = relative.rfind('.');
+                auto extension = dot == std::string_view::npos ? std::string_view() : relative.substr(dot);
+                if (extension == ".a" || extension == ".lib")
+                    libFiles.push_back(libraries.path(entry));
+            }
+            for (const auto &file : libFiles)
+                owned.libraries.push_back(file.filename().string());
+
+            ChunkStore store(getStoreDirectory());
+            ChunkStore::PutResult stored;
+            size_t total = libFiles.size();
+            size_t count = 0;
+            for (const auto &file : libFiles)
+            {
+                auto target = projectLib / file.filename();
+                if (std::filesystem::file_size(file) >= chunkedFileThreshold)
+                {
+                    // Large archives go through the chunk store so shared content between versions is kept once
+                    auto result = store.put(file);
+                    store.materialize(result.digest, target);
+                    stored.bytes += result.bytes;
+                    stored.newBytes += result.newBytes;
+                    stored.chunks += result.chunks;
+                    stored.newChunks += result.newChunks;
+                }
+                else
+                {
+                    std::filesystem::copy_file(file, target, std::filesystem::copy_options::overwrite_existing);
+                }
+                count++;
+                int percent = int((count * 100) / total);
+                Log::status("\rLibraries [" + std::string(percent / 2, '#') + std::string(50 - percent / 2, ' ') + "] " +
+                            std::to_string(percent) + "% (" + std::to_string(count) + "/" + std::to_string(total) + ")");
+            }
+
+            if (stored.chunks > 0 && stored.newBytes == 0)
+            {
+                Log::info() << "Chunk store: all " << stored.chunks << " chunks (" << formatBytes(stored.bytes)
+                            << ") were already stored.";
+            }
+            else if (stored.chunks > 0)
+            {
+                double ratio = double(stored.bytes) / double(stored.newBytes);
+                Log::info() << "Chunk store: " << stored.chunks << " chunks (" << stored.newChunks << " new), "
+                            << formatBytes(stored.bytes) << " stored as " << formatBytes(stored.newBytes)
+                            << " new data, dedup ratio " << std::fixed << std::setprecision(2) << ratio << "x"
+                            << std::defaultfloat;
+            }
+        }
+    }
+
+    // Work out what installing repository at version would take, without touching the project: only the
+    // package's trees are cloned, into a scratch directory
+    InstallPlan::Package planPackage(const std::string &repository, const std::string &version, bool lazy)
+    {
+        auto scratch = std::filesystem::temp_directory_path() / ("tegen-plan-" + repository);
+        std::error_code ec;
+        std::filesystem::remove_all(scratch, ec);
+        if (!InstallPlan::cloneTree(packageUrl(repository), version, scratch))
+        {
+            std::filesystem::remove_all(scratch, ec);
+            throw std::runtime_error("cannot list " + repository + " " + version + " (unknown package or version, or no partial clone support)");
+        }
+        auto plan = InstallPlan::classify(repository, version, lazy, InstallPlan::listTree(scratch), getStoreDirectory());
+        removeFolderRecursively(scratch);
+        return plan;
+    }
+
+    // Print a plan with its time predicted from earlier installs. Header cost is what this project's
+    // scored headers typically take to include (the package's own, when it has been scored before).
+    void printInstallPlan(const InstallPlan::Package &plan, const PackageManifest::Package *current = nullptr)
+    {
+        auto rates = InstallPlan::throughput(getStoreDirectory());
+        std::vector<double> parse;
+        if (current)
+            for (const auto &[header, cost] : current->costs)
+                parse.push_back(cost.parseMs);
+        PackageManifest manifest(std::filesystem::current_path());
+        if (parse.empty())
+            for (const auto &[name, package] : manifest.packages())
+                for (const auto &[header, cost] : package.costs)
+                    parse.push_back(cost.parseMs);
+        std::sort(parse.begin(), parse.end());
+
+        size_t scored = plan.lazy ? 0 : plan.headers;
+        Log::info() << "  Fetch:        " << plan.fetch.size() << " files, " << formatBytes(plan.fetchBytes());
+        Log::info() << "  From store:   " << plan.reused.size() << " files, " << formatBytes(plan.reusedBytes());
+        {
+            auto materialize = Log::info();
+            materialize << "  Materialize:  " << plan.materialized() << " files into the project (" << (plan.lazy ? 0 : plan.headers)
+                        << " headers, " << plan.libraries << " libraries)";
+            if (plan.lazy)
+                materialize << "; " << plan.headers << " headers wait in the store until a compile includes them";
+        }
+        {
+            auto cost = Log::info();
+            cost << "  Header cost:  " << plan.headers << " headers";
+            if (!parse.empty())
+                cost << ", typically " << formatDuration(parse[parse.size() / 2]) << " each to include (from " << parse.size()
+                     << " scored headers)";
+        }
+
+        double download = rates.bytesPerMs > 0 ? double(plan.fetchBytes()) / rates.bytesPerMs : -1;
+        double copy = rates.filesPerMs > 0 ? double(plan.materialized()) / rates.filesPerMs : -1;
+        double scoring = rates.msPerHeader > 0 ? double(scored) * rates.msPerHeader : -1;
+        if (download < 0 && copy < 0 && scoring < 0)
+        {
+            Log::info() << "  Time:         unknown until an install has been timed here";
+            return;
+        }
+        auto part = [this](double ms)
+        { return ms < 0 ? std::string("unknown") : formatDuration(ms); };
+        Log::info() << "  Time:         about " << formatDuration(std::max(0.0, download) + std::max(0.0, copy) + std::max(0.0, scoring))
+                    << " (download " << part(download) << ", copy " << part(copy) << ", header scoring " << part(scoring) << ")";
+    }
+
+    // Which translation units including changed headers (absolute paths) an update recompiles and roughly
+    // how long that takes, from the last build's depfiles and compile times; the counts go into record
+    void reportRebuild(const std::string &repository, const std::set<std::string> &changed, size_t libraries, json &record)
+    {
+        auto projectDir = std::filesystem::current_path();
+        if (changed.empty() && libraries == 0)
+        {
+            Log::info() << "The installed files are already identical.";
+            return;
+        }
+        auto deps = BuildDeps::load(projectDir / "build");
+        if (deps.empty())
+        {
+            Log::info() << "No depfiles from a previous build; build once to see which files an update recompiles.";
+            return;
+        }
+        auto affected = BuildDeps::affected(deps, changed);
+        CompileHistory history(projectDir / "build");
+        size_t timed = 0;
+        double estimate = history.estimate(affected, &timed);
+        std::stable_sort(affected.begin(), affected.end(), [&](const std::string &a, const std::string &b)
+                         { return history.duration(a) > history.duration(b); });
+        {
+            auto summary = Log::info();
+            summary << "Rebuild: " << affected.size() << " of " << deps.size() << " translation units include changed headers";
+            if (!affected.empty() && !history.empty())
+                summary << ", about " << formatDuration(estimate) << " of compiling (" << timed << " timed in earlier builds)";
+            summary << ".";
+        }
+        for (size_t i = 0; i < affected.size() && i < 10; i++)
+        {
+            double ms = history.duration(affected[i]);
+            auto line = Log::info();
+            line << "  " << affected[i];
+            if (ms >= 0)
+                line << "  (" << formatDuration(ms) << ")";
+        }
+        if (affected.size() > 10)
+            Log::info() << "  ... " << affected.size() - 10 << " more";
+        if (libraries > 0)
+            Log::info() << "Targets linking " << repository << " relink.";
+        record["units"] = affected.size();
+        record["estimateMs"] = estimate;
+    }
+
+    // Git blob ids of files (relative to the project root) as they are on disk; files that do not exist are left out
+    std::map<std::string, std::string> installedBlobs(const std::vector<std::string> &files)
+    {
+        std::vector<std::string> present;
+        for (const auto &file : files)
+            if (std::filesystem::is_regular_file(file))
+                present.push_back(file);
+        std::map<std::string, std::string> blobs;
+        if (present.empty())
+            return blobs;
+        auto list = std::filesystem::temp_directory_path() / "tegen-plan-paths";
+        {
+            std::ofstream out(list);
+            for (const auto &file : present)
+                out << file << "\n";
+        }
+        std::istringstream ids(TestRunner::capture("git hash-object --stdin-paths < \"" + list.string() + "\""));
+        std::string id;
+        for (size_t i = 0; i < present.size() && std::getline(ids, id); i++)
+            blobs[present[i]] = id;
+        std::filesystem::remove(list);
+        return blobs;
+    }
+
+    // 'update --dry-run': the new version's install plan and the rebuild its changed headers cause. The
+    // installed files are compared with the new tree by git blob id, so only trees are downloaded.
+    void planUpdate(const std::string &repository, const std::string &installedVersion, const std::string &version)
+    {
+        auto projectDir = std::filesystem::current_path();
+        PackageManifest manifest(projectDir);
+        auto installedPackage = manifest.packages().find(repository);
+        PackageManifest::Package current = installedPackage != manifest.packages().end() ? installedPackage->second
+                                                                                          : PackageManifest::Package();
+        auto plan = planPackage(repository, version, current.lazy);
+        std::vector<InstallPlan::File> files = plan.fetch;
+        files.insert(files.end(), plan.reused.begin(), plan.reused.end());
+
+        // Where each file of the new version goes: include/ keeps its path, libraries land in lib/ by name
+        std::map<std::string, std::string> targets;
+        for (const auto &file : files)
+        {
+            auto extension = std::filesystem::path(file.path).extension();
+            if (file.path.rfind("include/", 0) == 0)
+                targets[file.path] = file.path;
+            else if (file.path.rfind("lib/", 0) == 0 && (extension == ".a" || extension == ".lib"))
+                targets[file.path] = "lib/" + std::filesystem::path(file.path).filename().string();
+        }
+        std::vector<std::string> installedFiles;
+        for (const auto &[path, target] : targets)
+            installedFiles.push_back(target);
+        auto blobs = installedBlobs(installedFiles);
+        // Lazy headers not in include/ are known by their store digest
+        std::map<std::string, std::string> digestBlobs;
+        for (const auto &[blob, digest] : InstallPlan::loadBlobs(getStoreDirectory()))
+            digestBlobs[digest] = blob;
+        for (const auto &[header, digest] : current.digests)
+            if (!blobs.count(header) && digestBlobs.count(digest))
+                blobs[header] = digestBlobs[digest];
+
+        std::set<std::string> incoming;
+        std::set<std::string> changed;
+        size_t libraries = 0;
+        for (const auto &file : files)
+        {
+            auto target = targets.find(file.path);
+            if (target == targets.end())
+                continue;
+            auto installed = blobs.find(target->second);
+            bool differs = installed == blobs.end() || installed->second != file.blob;
+            if (target->second.rfind("include/", 0) == 0)
+            {
+                incoming.insert(target->second);
+                if (differs)
+                    changed.insert(BuildDeps::normalize(projectDir / target->second, projectDir));
+            }
+            else if (differs)
+            {
+                libraries++;
+            }
+        }
+        size_t removedCount = 0;
+        for (const auto &header : packageHeaders(repository, manifest))
+        {
+            if (incoming.count(header))
+                continue;
+            changed.insert(BuildDeps::normalize(projectDir / header, projectDir));
+            removedCount++;
+        }
+
+        Log::info() << "Plan for updating " << repository << " " << installedVersion << " -> " << version << ":";
+        printInstallPlan(plan, &current);
+        Log::info() << "Changes: " << changed.size() - removedCount << " headers changed or added, " << removedCount << " removed, "
+                    << libraries << " libraries changed.";
+        json impact = json::object();
+        reportRebuild(repository, changed, libraries, impact);
+        Log::info() << "Dry run: nothing was updated.";
+    }
+
+public:
+    // Initialize a new TegenConfig.json file in the current directory (a dry run lists what it would create)
+    void init(bool dryRun = false)
+    {
+        if (configExists())
+        {
+            Log::info() << "TegenConfig.json already exists in the current directory.";
+            return;
+        }
+        if (dryRun)
+        {
+            Log::info() << "Would create in " << getCurrentDirectory() << ":";
+            for (const char *path : {"TegenConfig.json", "src/main.cpp", "CMakeLists.txt"})
+                Log::info() << "- " << path << (std::filesystem::exists(path) ? " (exists; overwritten)" : "");
+            Log::info() << "- include/";
+            return;
+        }
+
+        json config;
+        Log::info() << "Initializing TegenConfig.json and CMake project...";
+
+        // Prompt for project details
+        config["name"] = prompt("Enter project name", "my-package");
+        config["version"] = prompt("Enter project version", "1.0.0");
+        config["author"] = prompt("Enter author name", "Anonymous");
+        config["license"] = prompt("Enter license type", "MIT");
+        config["description"] = prompt("Enter project description", "A C++ project");
+        config["dependencies"] = json::object(); // Initialize dependencies as an empty object
+
+        // Save the TegenConfig.json
+        saveConfig(config);
+        Log::info() << "Initialized TegenConfig.json in " << getCurrentDirectory() << " with the following details:";
+        Log::info() << config.dump(4);
+
+        // Create CMake project structure
+
+        // Create 'src' and 'include' directories
+        std::filesystem::create_directory("src");
+        std::filesystem::create_directory("include");
+
+        // Create a basic main.cpp in the 'src' folder
+        std::ofstream mainCpp("src/main.cpp");
+        mainCpp << "#include <iostream>" << std::endl;
+        mainCpp << std::endl;
+        mainCpp << "int main() {" << std::endl;
+        mainCpp << "    std::cout << \"Hello, World!\" << std::endl;" << std::endl;
+        mainCpp << "    return 0;" << std::endl;
+        mainCpp << "}" << std::endl;
+        mainCpp.close();
+
+        // Create a basic CMakeLists.txt
+        std::ofstream cmakeLists("CMakeLists.txt");
+        cmakeLists << "cmake_minimum_required(VERSION 3.10)" << std::endl;
+        cmakeLists << "project(" << config["name"].get<std::string>() << " VERSION " << config["version"].get<std::string>() << ")" << std::endl;
+        cmakeLists << std::endl;
+        cmakeLists << "set(CMAKE_CXX_STANDARD 17)" << std::endl;
+        cmakeLists << std::endl;
+        cmakeLists << "include_directories(include)" << std::endl;
+        cmakeLists << "add_executable(" << config["name"].get<std::string>() << " src/main.cpp)" << std::endl;
+        cmakeLists.close();
+
+        Log::info() << "CMake project structure created:";
+        Log::info() << "- src/main.cpp";
+        Log::info() << "- include/ (empty for now)";
+        Log::info() << "- CMakeLists.txt";
+
+        // Inform user that CMake needs to be installed
+        Log::info();
+        Log::info() << "Note: You need to have CMake installed on your system to build and install the project.";
+        Log::info() << "You can download CMake from https://cmake.org/download/";
+        Log::info();
+
+        // Instructions for building and running with Tegen
+        Log::info() << "To build and run your project using Tegen, follow these steps:";
+        Log::info() << "1. Install required dependencies:";
+        Log::info() << "   tegen install <package-name>";
+        Log::info() << "2. Build your project using Tegen:";
+        Log::info() << "   tegen build";
+        Log::info() << "3. After the build completes, run your project:";
+        Log::info() << "   tegen run";
+        Log::info();
+        Log::info() << "Your project is now ready to build and run with Tegen!";
+    }
+
+    // Install a new package from GitHub; a lazy install leaves its headers in the store until compiles ask for them.
+    // A dry run only prints the plan (see InstallPlan).
+    void install(const std::string &repository, const std::string &version = "", bool lazy = false, bool dryRun = false)
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found. Run 'init' first.";
+            return;
+        }
+
+        json config = loadConfig();
+        std::filesystem::path projectDir = std::filesystem::current_path();
+        std::filesystem::path modulesDir = projectDir / "TegenModules";
+        std::filesystem::path projectInclude = projectDir / "include";
+        std::filesystem::path projectLib = projectDir / "lib";
+        std::string resolvedVersion = version.empty() ? defaultBranch() : version;
+
+        if (config["dependencies"].contains(repository))
+        {
+            Log::info() << "Repository " << repository << " is already installed with version "
+                        << config["dependencies"][repository] << ".";
+            return;
+        }
+        if (dryRun)
+        {
+            Log::info() << "Plan for installing " << repository << " (branch/version: " << resolvedVersion << "):";
+            printInstallPlan(planPackage(repository, resolvedVersion, lazy));
+            Log::info() << "Dry run: nothing was installed.";
+            return;
+        }
+
+        std::filesystem::create_directories(modulesDir);
+        std::filesystem::create_directories(projectInclude);
+        std::filesystem::create_directories(projectLib);
+
+        try
+        {
+            Log::info() << "Installing package: " << repository << " (branch/version: " << resolvedVersion << ")...";
+
+            std::filesystem::path repoDir = modulesDir / repository;
+
+            // fetch -> (headers, libs in parallel) -> integrate. The clone is fresh on every install,
+            // so these actions always run; the graph only orders and parallelizes them.
+            ActionGraph graph(actionCacheFile());
+
+            // Files this package brings in, for per-package attribution (tegen size)
+            PackageManifest::Package owned;
+            owned.version = resolvedVersion;
+            owned.lazy = lazy;
+            std::vector<InstallPlan::File> tree;
+            auto fetched = std::chrono::steady_clock::now();
+
+            ActionGraph::Action fetch;
+            fetch.name = "fetch:" + repository;
+            fetch.keyParts = {repository, resolvedVersion};
+            fetch.cacheable = false;
+            fetch.work = [&](const ActionGraph::Action &)
+            {
+                tree = fetchPackage(repository, resolvedVersion, repoDir);
+                fetched = std::chrono::steady_clock::now();
+            };
+            graph.add(fetch);
+
+            // -------------------- COPY HEADERS --------------------
+            ActionGraph::Action headers;
+            headers.name = "headers:" + repository;
+            headers.deps = {fetch.name};
+            headers.cacheable = false;
+            headers.work = [&](const ActionGraph::Action &)
+            { copyPackageHeaders(repoDir, projectInclude, owned); };
+            graph.add(headers);
+
+            // -------------------- COPY LIBS --------------------
+            ActionGraph::Action libs;
+            libs.name = "libs:" + repository;
+            libs.deps = {fetch.name};
+            libs.cacheable = false;
+            libs.work = [&](const ActionGraph::Action &)
+            { copyPackageLibraries(repoDir, projectLib, owned); };
+            graph.add(libs);
+
+            ActionGraph::Action integrate;
+            integrate.name = "integrate:" + repository;
+            integrate.deps = {headers.name, libs.name};
+            integrate.cacheable = false;
+            integrate.work = [&](const ActionGraph::Action &)
+            {
+                // Copy throughput and store blob ids, for the plans of later installs
+                auto storeDir = getStoreDirectory();
+                InstallPlan::record(storeDir, "materialize", double((lazy ? 0 : owned.headers.size()) + owned.libraries.size()),
+                                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - fetched).count());
+                rememberStoredBlobs(repoDir, tree, owned);
+
+                // -------------------- UPDATE CMakeLists.txt --------------------
+                std::filesystem::path cmakeFile = projectDir / "CMakeLists.txt";
+                std::ofstream cmakeOut(cmakeFile, std::ios::app);
+                cmakeOut << "\n# Added by Tegen for " << repository << "\n";
+                cmakeOut << "include_directories(include)\n";
+
+                // Link copied libs
+                for (const auto &libFile : std::filesystem::directory_iterator(projectLib))
+                {
+                    if (libFile.path().extension() == ".lib" || libFile.path().extension() == ".a")
+                    {
+                        cmakeOut << "target_link_libraries(${PROJECT_NAME} PRIVATE \"" << libFile.path().string() << "\")\n";
+                    }
+                }
+
+#ifdef _WIN32
+                cmakeOut << "target_link_libraries(${PROJECT_NAME} PRIVATE ws2_32 mswsock advapi32)\n";
+#endif
+
+                cmakeOut.close();
+
+                // -------------------- UPDATE CONFIG --------------------
+                config["dependencies"][repository] = resolvedVersion;
+                saveConfig(config);
+
+                PackageManifest manifest(projectDir);
+                std::sort(owned.headers.begin(), owned.headers.end());
+                auto scoring = std::chrono::steady_clock::now();
+                if (!owned.headers.empty() && scoreHeaders(owned))
+                {
+                    InstallPlan::record(storeDir, "score", double(owned.costs.size()),
+                                        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - scoring).count());
+                    Log::info() << "What including each header alone costs (details: tegen list --cost):";
+                    printCostSummary(owned);
+                }
+                manifest.set(repository, owned);
+                manifest.save();
+            };
+            graph.add(integrate);
+
+            graph.run();
+
+            // -------------------- CLEAN UP --------------------
+            // The clone is renamed away at once and deleted by a background process
+            Trash::discard(modulesDir);
+
+            Log::info() << "Package " << repository << " successfully installed, integrated, and cleaned up!";
+        }
+        catch (const std::exception &e)
+        {
+            Log::error() << "Failed to install package: " << e.what();
+        }
+    }
+
+    // Update an installed package. Before anything is replaced, the changed headers are matched against the
+    // last build's depfiles to show which translation units will recompile and roughly how long that takes.
+    // The update can then be applied, skipped, or deferred (recorded in .tegen/deferred-updates.json). A dry run
+    // shows the plan and the rebuild without downloading more than the package's trees.
+    bool update(const std::string &repository, const std::string &version, const std::string &decision = "", bool dryRun = false)
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found. Run 'init' first.";
+            return false;
+        }
+
+        json config = loadConfig();
+        auto projectDir = std::filesystem::current_path();
+        auto deferredFile = projectDir / ".tegen" / "deferred-updates.json";
+        std::ifstream deferredIn(deferredFile);
+        json deferred = deferredIn ? json::parse(deferredIn, nullptr, false) : json::object();
+        if (!deferred.is_object())
+            deferred = json::object();
+        deferredIn.close();
+
+        // Without a package, list what was put off
+        if (repository.empty())
+        {
+            if (deferred.empty())
+            {
+                Log::info() << "No deferred updates.";
+                return true;
+            }
+            Log::info() << "Deferred updates:";
+            for (const auto &[name, entry] : deferred.items())
+                Log::info() << "  - " << name << " -> " << entry.value("version", "") << " (" << entry.value("units", 0)
+                            << " translation units to rebuild, deferred " << entry.value("since", "") << ")";
+            Log::info() << "Apply one with 'tegen update <package> <version>'.";
+            return true;
+        }
+        if (!config["dependencies"].contains(repository))
+        {
+            Log::error() << "Package " << repository << " is not installed; use 'tegen install " << repository << "'.";
+            return false;
+        }
+
+        std::string resolvedVersion = version.empty() ? defaultBranch() : version;
+        if (dryRun)
+        {
+            planUpdate(repository, config["dependencies"][repository].get<std::string>(), resolvedVersion);
+            return true;
+        }
+        auto modulesDir = projectDir / "TegenModules";
+        auto repoDir = modulesDir / repository;
+        std::filesystem::create_directories(modulesDir);
+        auto tree = fetchPackage(repository, resolvedVersion, repoDir);
+
+        // Headers that differ, appear or disappear, as absolute paths (the form depfiles use)
+        PackageManifest manifest(projectDir);
+        auto installedPackage = manifest.packages().find(repository);
+        PackageManifest::Package current = installedPackage != manifest.packages().end() ? installedPackage->second
+                                                                                          : PackageManifest::Package();
+        std::set<std::string> incoming;
+        std::set<std::string> changed;
+        size_t removedCount = 0;
+        auto sourceInclude = repoDir / "include";
+        if (std::filesystem::is_directory(sourceInclude))
+        {
+            auto scan = DirScanner::scan(sourceInclude);
+            for (const auto &entry : scan.entries())
+            {
+                if (entry.type != DirScanner::EntryType::File)
+                    continue;
+                std::string header = "include/" + std::string(scan.relative(entry));
+                incoming.insert(header);
+                auto installed = projectDir / header;
+                // A lazy package's headers are compared by their digest in the store (the same SHA-256)
+                auto stored = current.digests.find(header);
+                std::string before = stored != current.digests.end() ? stored->second
+                                     : std::filesystem::exists(installed) ? Sha256::hashFile(installed)
+                                                                          : "";
+                if (before != Sha256::hashFile(scan.path(entry)))
+                    changed.insert(BuildDeps::normalize(installed, projectDir));
+            }
+        }
+        std::vector<std::string> removed;
+        for (const auto &header : packageHeaders(repository, manifest))
+        {
+            if (incoming.count(header))
+                continue;
+            removed.push_back(header);
+            changed.insert(BuildDeps::normalize(projectDir / header, projectDir));
+            removedCount++;
+        }
+        size_t libraries = 0;
+        if (std::filesystem::is_directory(repoDir / "lib"))
+        {
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(repoDir / "lib"))
+            {
+                auto extension = entry.path().extension();
+                auto installed = projectDir / "lib" / entry.path().filename();
+                if (entry.is_regular_file() && (extension == ".a" || extension == ".lib") &&
+                    (!std::filesystem::exists(installed) || Sha256::hashFile(installed) != Sha256::hashFile(entry.path())))
+                    libraries++;
+            }
+        }
+
+        Log::info() << "Updating " << repository << " " << config["dependencies"][repository].get<std::string>() << " -> "
+                    << resolvedVersion << ": " << changed.size() - removedCount << " headers changed or added, " << removedCount
+                    << " removed, " << libraries << " libraries changed.";
+        json impact = json::object();
+        reportRebuild(repository, changed, libraries, impact);
+        for (const auto &[key, value] : impact.items())
+            deferred[repository][key] = value;
+
+        std::string answer = decision;
+        if (answer.empty() && interactive())
+        {
+            answer = prompt("Apply the update? (yes/no/defer)", "yes");
+            if (answer.empty())
+                answer = "yes";
+        }
+        else if (answer.empty())
+        {
+            // Nobody to ask (CI, a pipe): leave the package alone unless told otherwise
+            Log::info() << "Not applying the update without a terminal to ask; pass --yes to apply it or --defer to record it.";
+            answer = "no";
+        }
+        answer = std::string(1, char(std::tolower((unsigned char)answer[0])));
+        if (answer[0] != 'y')
+        {
+            Trash::discard(modulesDir);
+            if (answer[0] == 'd')
+            {
+                auto now = std::time(nullptr);
+                std::ostringstream since;
+                since << std::put_time(std::localtime(&now), "%Y-%m-%d");
+                deferred[repository]["version"] = resolvedVersion;
+                deferred[repository]["since"] = since.str();
+                std::filesystem::create_directories(deferredFile.parent_path());
+                std::ofstream(deferredFile) << deferred.dump(2);
+                Log::info() << "Update deferred; 'tegen update' lists deferred updates.";
+            }
+            else
+            {
+                Log::info() << "Update skipped.";
+            }
+            return true;
+        }
+
+        for (const auto &header : removed)
+            std::filesystem::remove(projectDir / header);
+        PackageManifest::Package owned;
+        owned.version = resolvedVersion;
+        owned.lazy = current.lazy;
+        for (const auto &header : current.used)
+            if (incoming.count(header))
+                owned.used.push_back(header);
+        copyPackageHeaders(repoDir, projectDir / "include", owned);
+        copyPackageLibraries(repoDir, projectDir / "lib", owned);
+        rememberStoredBlobs(repoDir, tree, owned);
+        std::sort(owned.headers.begin(), owned.headers.end());
+        scoreHeaders(owned);
+        manifest.set(repository, owned);
+        manifest.save();
+
+        config["dependencies"][repository] = resolvedVersion;
+        saveConfig(config);
+        if (deferred.contains(repository))
+        {
+            deferred.erase(repository);
+            std::ofstream(deferredFile) << deferred.dump(2);
+        }
+        Trash::discard(modulesDir);
+        Log::info() << "Package " << repository << " updated to " << resolvedVersion << ".";
+        return true;
+    }
+
+    void removeFolderRecursively(const std::filesystem::path &folder)
+    {
+        Trash::removeTree(folder);
+        std::error_code ec;
+        if (std::filesystem::exists(folder, ec))
+        {
+            Log::warning() << "Warning: Failed to completely remove " << folder;
+        }
+    }
+
+    // Remove build output and/or dependency clones, deleting them in the background (a dry run lists them)
+    bool clean(const std::string &scope = "--build", bool dryRun = false)
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found in the current directory.";
+            return false;
+        }
+
+        std::vector<std::string> targets;
+        if (scope == "--build" || scope == "--all")
+            targets.push_back("build");
+        if (scope == "--deps" || scope == "--all")
+            targets.push_back("TegenModules");
+        if (targets.empty())
+        {
+            Log::error() << "Unknown clean option: " << scope << " (expected --build, --deps or --all)";
+            return false;
+        }
+
+        for (const auto &target : targets)
+        {
+            std::filesystem::path folder = std::filesystem::current_path() / target;
+            if (!std::filesystem::exists(folder))
+            {
+                Log::info() << target << "/ is already clean.";
+                continue;
+            }
+            if (dryRun)
+            {
+                size_t files = 0;
+                uint64_t bytes = 0;
+                std::error_code ec;
+                for (const auto &entry : std::filesystem::recursive_directory_iterator(folder, ec))
+                {
+                    if (!entry.is_regular_file(ec))
+                        continue;
+                    files++;
+                    bytes += entry.file_size(ec);
+                }
+                Log::info() << "Would remove " << target << "/ (" << files << " files, " << formatBytes(bytes) << ").";
+                continue;
+            }
+            Trash::discard(folder);
+            Log::info() << "Removed " << target << "/ (finishing deletion in the background).";
+        }
+        return true;
+    }
+
+    // List all dependencies; with cost, how expensive each one's headers are to include
+    void listDependencies(bool cost = false)
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found in the current directory.";
+            return;
+        }
+
+        json config = loadConfig();
+        Log::info() << "Dependencies:";
+
+        PackageManifest manifest(std::filesystem::current_path());
+        bool scored = false;
+        for (const auto &[key, value] : config["dependencies"].items())
+        {
+            Log::info() << "  - " << key << ": " << value;
+            if (!cost)
+                continue;
+
+            // Packages installed before scoring existed are measured now, once
+            auto found = manifest.packages().find(key);
+            PackageManifest::Package package = found != manifest.packages().end() ? found->second : PackageManifest::Package();
+            if (found == manifest.packages().end())
+            {
+                package.version = value.is_string() ? value.get<std::string>() : "";
+                package.headers = packageHeaders(key, manifest);
+            }
+            // A lazy package is scored again once compiles have brought in more of its headers
+            size_t usedHeaders = std::count_if(package.used.begin(), package.used.end(), [](const std::string &header)
+                                               { return HeaderCost::isHeader(header); });
+            if (package.lazy)
+                Log::info() << "    Lazy: " << package.used.size() << " of " << package.headers.size() << " headers used so far";
+            if ((package.costs.empty() || (package.lazy && package.costs.size() < usedHeaders)) && !package.headers.empty())
+            {
+                Log::info() << "    Scoring " << (package.lazy ? usedHeaders : package.headers.size()) << " headers...";
+                if (scoreHeaders(package))
+                {
+                    manifest.set(key, package);
+                    scored = true;
+                }
+            }
+            printCostSummary(package, "    ");
+        }
+        if (scored)
+            manifest.save();
+    }
+
+    // Headers by parse time, with what they pull in and any include problems
+    void printCostSummary(const PackageManifest::Package &package, const std::string &indent = "")
+    {
+        if (package.costs.empty())
+        {
+            Log::info() << indent << "No header costs recorded.";
+            return;
+        }
+        std::vector<std::pair<std::string, PackageManifest::Cost>> costs(package.costs.begin(), package.costs.end());
+        std::stable_sort(costs.begin(), costs.end(), [](const auto &a, const auto &b)
+                         { return a.second.parseMs > b.second.parseMs; });
+        size_t flagged = 0;
+        for (const auto &[header, cost] : costs)
+            flagged += cost.issues.empty() ? 0 : 1;
+
+        const size_t shown = 10;
+        size_t hidden = 0;
+        Log::info() << indent << std::left << std::setw(44) << "header" << std::right << std::setw(10) << "parse ms" << std::setw(10)
+                    << "pp ms" << std::setw(10) << "includes" << std::setw(10) << "tokens";
+        for (size_t i = 0; i < costs.size(); i++)
+        {
+            const auto &[header, cost] = costs[i];
+            // Past the most expensive few, only headers with problems are listed
+            if (i >= shown && cost.issues.empty())
+            {
+                hidden++;
+                continue;
+            }
+            Log::info() << indent << std::left << std::setw(44) << header << std::right << std::fixed << std::setprecision(1)
+                        << std::setw(10) << cost.parseMs << std::setw(10) << cost.preprocessMs << std::defaultfloat
+                        << std::setw(10) << cost.includes << std::setw(10) << cost.tokens;
+            for (const auto &issue : cost.issues)
+                Log::info() << indent << "    ! " << issue;
+        }
+        if (hidden > 0)
+            Log::info() << indent << "... " << hidden << " more headers";
+        if (flagged > 0)
+            Log::info() << indent << flagged << " of " << costs.size() << " headers have include problems.";
+    }
+
+    // Show what Tegen knows about a compiler (the project's by default) and whether it came from the cache
+    void toolchainInfo(const std::string &compiler = "")
+    {
+        std::string name = compiler;
+        if (name.empty())
+            name = cmakeCacheValue("build", "CMAKE_CXX_COMPILER");
+        if (name.empty())
+            name = headerCostOptions().compiler;
+        auto info = ToolchainCache::probe(name, getStoreDirectory());
+        if (info.version.empty())
+        {
+            Log::error() << "Compiler " << name << " not found.";
+            return;
+        }
+        std::istringstream banner(info.version);
+        std::string firstLine;
+        std::getline(banner, firstLine);
+        Log::info() << "Compiler:    " << info.path << (info.cached ? " (cached)" : " (probed now)");
+        Log::info() << "Version:     " << firstLine;
+        Log::info() << "Target:      " << (info.target.empty() ? "unknown" : info.target);
+        Log::info() << "Sysroot:     " << (info.sysroot.empty() ? "none" : info.sysroot);
+        Log::info() << "Macros:      " << (info.macros.empty() ? "unknown" : info.macros.substr(0, 16));
+        Log::info() << "Fingerprint: " << info.fingerprint();
+    }
+
+    // Show chunk store usage and the overall dedup ratio
+    void storeStats()
+    {
+        ChunkStore store(getStoreDirectory());
+        auto stats = store.stats();
+        Log::info() << "Store: " << store.directory().string();
+        Log::info() << "  Files:    " << stats.files << " (" << formatBytes(stats.logicalBytes) << ")";
+        Log::info() << "  Chunks:   " << stats.chunks << " (" << formatBytes(stats.physicalBytes) << " on disk)";
+        Log::info() << "  Dedup:    " << std::fixed << std::setprecision(2) << stats.dedupRatio() << "x" << std::defaultfloat;
+    }
+
+    // Time copying and hashing a directory tree with each I/O backend, checking that
+    // the streaming copy keeps peak RSS flat. Returns false if the RSS check fails.
+    bool benchIo(const std::filesystem::path &sourceDir)
+    {
+        if (!std::filesystem::is_directory(sourceDir))
+        {
+            Log::error() << "Not a directory: " << sourceDir;
+            return false;
+        }
+
+        std::vector<std::filesystem::path> files;
+        uintmax_t totalBytes = 0;
+        auto listing = DirScanner::scan(sourceDir);
+        for (const auto &entry : listing.entries())
+        {
+            if (entry.type == DirScanner::EntryType::File)
+            {
+                files.push_back(listing.path(entry));
+                totalBytes += std::filesystem::file_size(files.back());
+            }
+        }
+        Log::info() << "Benchmarking I/O on " << files.size() << " files (" << formatBytes(totalBytes) << ")...";
+
+        uint64_t rssLimit = benchRssLimitMb;
+        if (const char *limit = std::getenv("TEGEN_BENCH_RSS_LIMIT_MB"))
+            rssLimit = std::stoull(limit);
+        rssLimit *= 1024 * 1024;
+
+        std::filesystem::path scratch = std::filesystem::temp_directory_path() / "tegen-bench-io";
+        removeFolderRecursively(scratch);
+
+        // Untimed pass so every backend starts from a warm page cache
+        AsyncFileIo warmup(AsyncFileIo::Backend::Sequential);
+        streamCopyTree(sourceDir, scratch / "warmup", warmup);
+
+        bool passed = true;
+        for (auto backend : {AsyncFileIo::Backend::Sequential, AsyncFileIo::Backend::Threaded, AsyncFileIo::Backend::IoUring})
+        {
+            AsyncFileIo io(backend);
+            if (io.backend() != backend)
+            {
+                Log::info() << "  " << std::left << std::setw(12) << AsyncFileIo::backendName(backend) << std::right
+                            << "unavailable on this system";
+                continue;
+            }
+
+            bool rssTracked = resetPeakRss();
+            uint64_t rssBefore = peakRssBytes();
+            auto start = std::chrono::steady_clock::now();
+            std::chrono::steady_clock::time_point firstCopy;
+            streamCopyTree(sourceDir, scratch / AsyncFileIo::backendName(backend), io, [&](size_t count)
+                           {
+                if (count > 0 && firstCopy.time_since_epoch().count() == 0)
+                    firstCopy = std::chrono::steady_clock::now(); });
+            auto copied = std::chrono::steady_clock::now();
+            uint64_t rssGrowth = peakRssBytes() - std::min(rssBefore, peakRssBytes());
+            io.hash(files);
+            auto hashed = std::chrono::steady_clock::now();
+
+            auto copyMs = std::chrono::duration<double, std::milli>(copied - start).count();
+            auto firstMs = std::chrono::duration<double, std::milli>(firstCopy - start).count();
+            auto hashMs = std::chrono::duration<double, std::milli>(hashed - copied).count();
+            auto line = Log::info();
+            line << "  " << std::left << std::setw(12) << AsyncFileIo::backendName(backend) << std::right
+                 << "copy " << std::fixed << std::setprecision(1) << std::setw(9) << copyMs << " ms   "
+                 << "first " << std::setw(7) << firstMs << " ms   "
+                 << "hash " << std::setw(9) << hashMs << " ms   "
+                 << std::setprecision(0) << std::setw(7) << (files.size() * 1000.0 / std::max(copyMs, 0.001)) << " files/s   "
+                 << std::defaultfloat;
+
+            if (!rssTracked)
+            {
+                line << "peak RSS n/a";
+            }
+            else
+            {
+                bool ok = rssGrowth <= rssLimit;
+                passed = passed && ok;
+                line << "peak RSS +" << formatBytes(rssGrowth) << (ok ? "" : " (FAIL: over " + formatBytes(rssLimit) + ")");
+            }
+        }
+
+        removeFolderRecursively(scratch);
+        return passed;
+    }
+
+    // Build the project using CMake; a dry run shows what would compile and for how long
+    void build(const std::string &target = "", bool dryRun = false)
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found in the current directory. Run 'init' first.";
+            return;
+        }
+        if (dryRun)
+        {
+            planBuild();
+            return;
+        }
+
+        Log::info() << "Building the project...";
+
+        // Create build directory if it doesn't exist
+        std::filesystem::create_directory("build");
+
+        // Configure, then build the project (or just one target), skipping steps whose inputs are unchanged
+        ActionGraph graph(actionCacheFile());
+        addBuildActions(graph, [target]
+                        { return target; });
+        graph.run();
+
+        Log::info() << "Build completed successfully. The project is located in the 'build/' directory.";
+    }
+
+    void run(const std::string &target = "")
+    {
+        if (!configExists())
+        {
+            // Red for errors
+            Log::error() << color("\x1B[31m") << "TegenConfig.json not found in the current directory. Run 'init' first."
+                         << color("\x1B[0m");
+            return;
+        }
+
+        json config = loadConfig();
+
+        // Yellow for info
+        Log::info() << color("\x1B[33m") << "Running the project..." << color("\x1B[0m");
+
+        // Configure (the File API reply names the executables), then build only the target being run
+        CMakeFileApi::Target executable;
+        bool resolved = true;
+        ActionGraph graph(actionCacheFile());
+        addBuildActions(graph, [&]
+                        {
+                            resolved = resolveExecutable(config, target, executable);
+                            if (!resolved)
+                                throw std::runtime_error("No executable to run");
+                            return executable.name; });
+        try
+        {
+            graph.run();
+        }
+        catch (const std::exception &)
+        {
+            if (resolved)
+                throw;
+        }
+
+        if (!resolved)
+        {
+            CMakeFileApi api("build");
+            // Red for errors
+            Log::error() << color("\x1B[31m") << unresolvedExecutable(target, "tegen run")
+                         << (api.executables().empty() ? "." : (target.empty() ? ":" : ". Available targets:")) << color("\x1B[0m");
+            for (const auto &candidate : api.executables())
+                Log::error() << color("\x1B[31m") << "  - " << candidate.name << color("\x1B[0m");
+            return;
+        }
+
+        std::filesystem::path buildPath = executable.artifacts.front();
+
+        std::string command = allocatorEnvironment(Allocators::active(config, "build")) + "\"" + buildPath.string() + "\"";
+
+        Log::flush();
+        auto start = std::chrono::high_resolution_clock::now();
+        int result = std::system(command.c_str());
+        auto end = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+        if (result != 0)
+        {
+            Log::error() << color("\x1B[31m") << "Failed to run the project. Make sure it's built correctly." << color("\x1B[0m");
+        }
+        else
+        {
+            Log::info() << color("\x1B[32m") << "Project finished successfully in " << duration << " ms." << color("\x1B[0m");
+        }
+    }
+
+    // Build the project if anything changed, then benchmark its executable
+    bool bench(int runs = 10)
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found in the current directory. Run 'init' first.";
+            return false;
+        }
+
+        json config = loadConfig();
+        bool succeeded = false;
+        ActionGraph graph(actionCacheFile());
+        addBuildActions(graph, [&]
+                        {
+                            CMakeFileApi::Target executable;
+                            return resolveExecutable(config, "", executable) ? executable.name : std::string(); });
+
+        ActionGraph::Action benchmark;
+        benchmark.name = "bench";
+        benchmark.deps = {"compile"};
+        benchmark.cacheable = false; // Timings are the point, so never reuse a previous run
+        benchmark.work = [&](const ActionGraph::Action &)
+        { succeeded = benchExecutable(executablePath(config), runs, "", nullptr, allocatorEnvironment(Allocators::active(config, "build"))); };
+        graph.add(benchmark);
+        graph.run();
+        return succeeded;
+    }
+
+    // Benchmark the executable under every installed allocator, preloaded with its default tuning
+    bool benchAllocators(int runs = 10)
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found in the current directory. Run 'init' first.";
+            return false;
+        }
+
+        json config = loadConfig();
+        ActionGraph graph(actionCacheFile());
+        addBuildActions(graph, [&]
+                        {
+                            CMakeFileApi::Target executable;
+                            return resolveExecutable(config, "", executable) ? executable.name : std::string(); });
+        graph.run();
+
+#ifdef _WIN32
+        Log::error() << "Allocator sweeps need LD_PRELOAD or DYLD_INSERT_LIBRARIES and are not available on Windows.";
+        return false;
+#else
+        auto linked = Allocators::active(config, "build");
+        if (linked.mode == "link" && linked.name != "system")
+            Log::info() << "Note: the build links " << linked.name << ", which takes precedence over the preloaded allocators.";
+
+        std::vector<std::pair<std::string, BenchResult>> results;
+        for (const auto &name : Allocators::names())
+        {
+            Allocators::Spec spec;
+            spec.name = name;
+            spec.mode = "preload";
+            if (name != "system" && Allocators::findShared(name, std::filesystem::current_path() / "lib").empty())
+            {
+                Log::info() << name << ": not installed, skipped (" << Allocators::installHint(name) << ").";
+                continue;
+            }
+            Log::info();
+            Log::info() << "[" << name << "]";
+            BenchResult result;
+            if (benchExecutable(executablePath(config), runs, "", &result, allocatorEnvironment(spec)))
+                results.push_back({name, result});
+        }
+        if (results.empty())
+            return false;
+
+        double baseline = results.front().second.medianMs;
+        Log::info();
+        Log::info() << std::left << std::setw(12) << "allocator" << std::right << std::setw(12) << "median ms" << std::setw(12)
+                    << "runs/s" << std::setw(10) << "vs first" << std::setw(12) << "peak RSS";
+        for (const auto &[name, result] : results)
+        {
+            double perSecond = result.medianMs > 0 ? 1000.0 / result.medianMs : 0;
+            double change = baseline > 0 ? (result.medianMs - baseline) * 100.0 / baseline : 0;
+            std::ostringstream delta;
+            delta << std::fixed << std::setprecision(1) << std::showpos << change << "%";
+            Log::info() << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(2)
+                        << std::setw(12) << result.medianMs << std::setw(12) << perSecond << std::setw(10) << delta.str()
+                        << std::setw(12) << formatBytes(result.peakRss) << std::defaultfloat;
+        }
+        return true;
+#endif
+    }
+
+    struct BenchResult
+    {
+        double medianMs = 0;
+        double meanMs = 0;
+        uint64_t peakRss = 0;
+    };
+
+    // Time repeated runs of one executable (with optional shell-quoted arguments and a VAR=value prefix)
+    // and report wall time and peak RSS
+    bool benchExecutable(const std::filesystem::path &buildPath, int runs, const std::string &arguments = "",
+                         BenchResult *result = nullptr, const std::string &environment = "")
+    {
+        if (!std::filesystem::exists(buildPath))
+        {
+            Log::error() << "Executable not found: " << buildPath;
+            Log::error() << "Make sure the project is built before benchmarking.";
+            return false;
+        }
+        if (runs < 1)
+        {
+            Log::error() << "Benchmarking needs at least one run (got " << runs << ").";
+            return false;
+        }
+
+#ifdef _WIN32
+        std::string command = "\"" + buildPath.string() + "\"" + arguments + " > NUL";
+#else
+        std::string command = environment + "\"" + buildPath.string() + "\"" + arguments + " > /dev/null";
+#endif
+
+        Log::info() << "Benchmarking " << buildPath.filename().string() << " (" << runs << " runs after 1 warm-up)...";
+        Log::flush();
+        ChildProcess::run(command);
+
+        std::vector<double> times;
+        uint64_t peakRss = 0;
+        for (int i = 0; i < runs; i++)
+        {
+            ChildProcess process;
+            process.start(command);
+            if (process.wait() != 0)
+            {
+                Log::error() << "Run " << i + 1 << " failed with exit code " << process.result() << ".";
+                return false;
+            }
+            times.push_back(std::chrono::duration<double, std::milli>(process.duration()).count());
+            peakRss = std::max(peakRss, process.peakRssBytes());
+        }
+
+        std::sort(times.begin(), times.end());
+        double mean = 0;
+        for (double time : times)
+            mean += time;
+        mean /= double(times.size());
+
+        Log::info() << std::fixed << std::setprecision(2) << "  min     " << times.front() << " ms";
+        Log::info() << std::fixed << std::setprecision(2) << "  median  " << times[times.size() / 2] << " ms";
+        Log::info() << std::fixed << std::setprecision(2) << "  mean    " << mean << " ms";
+        Log::info() << std::fixed << std::setprecision(2) << "  max     " << times.back() << " ms";
+        if (peakRss > 0)
+            Log::info() << "  peak RSS " << formatBytes(peakRss);
+        if (result)
+            *result = {times[times.size() / 2], mean, peakRss};
+        return true;
+    }
+
+    // Search the flag space (see FlagTuner) for the fastest build of an executable under one build profile
+    // (the main build's type unless buildType is given). Variants are built jobs at a time and benchmarked one
+    // at a time; the best flags and their speedup are saved to the profile in TegenConfig.json.
+    bool tune(const std::string &target, const std::string &arguments, const std::string &buildType, int runs, unsigned jobs)
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found in the current directory. Run 'init' first.";
+            return false;
+        }
+
+        json config = loadConfig();
+        CMakeFileApi::Target executable;
+        ActionGraph graph(actionCacheFile());
+        addBuildActions(graph, executableResolver(config, target, executable, "tegen tune"));
+        graph.run();
+
+        json settings = config.value("tune", json::object());
+        // Read signed, so a negative setting is clamped rather than wrapped around; 0 would divide by zero
+        runs = runs > 0 ? runs : std::max(1, settings.value("runs", 10));
+        jobs = jobs > 0 ? jobs : unsigned(std::max(1, settings.value("jobs", 2)));
+        std::string type = buildType.empty() ? cmakeCacheValue("build", "CMAKE_BUILD_TYPE") : buildType;
+        std::string profile = FlagTuner::profileName(type);
+        std::string compiler = cmakeCacheValue("build", "CMAKE_CXX_COMPILER");
+        // Asked of the compiler, since a "c++" or "cc" symlink tells nothing by its name
+        bool clang = !compiler.empty() && ToolchainCache::probe(compiler, getStoreDirectory()).clang;
+        auto space = FlagTuner::space(config, clang);
+        if (space.empty())
+        {
+            Log::error() << "\"tune\".\"space\" in TegenConfig.json has no dimension with more than one alternative.";
+            return false;
+        }
+
+        // Variants pick their flags up from the generated module
+        writeCMakeModule("TegenFlags.cmake", FlagTuner::cmakeModule(config), "tuned compiler flags");
+        auto workDir = std::filesystem::current_path() / "build" / ".tegen" / "tune";
+        std::filesystem::create_directories(workDir);
+        std::string configureKey = configureCacheKey();
+        std::string launcher = cmakeCacheValue("build", "CMAKE_CXX_COMPILER_LAUNCHER").empty() && LayoutOptimizer::hasTool("ccache") ? "ccache" : "";
+        unsigned parallel = std::max(1u, std::thread::hardware_concurrency() / jobs);
+        std::string environment = allocatorEnvironment(Allocators::active(config, "build"));
+        std::mutex storeLock;
+
+        // Median ms per variant key; negative when the variant did not build or run
+        std::map<std::string, double> measured;
+        auto measure = [&](const std::vector<std::vector<size_t>> &choices)
+        {
+            std::vector<FlagTuner::Flags> pending;
+            std::set<std::string> queued;
+            for (const auto &choice : choices)
+            {
+                auto flags = FlagTuner::combine(space, choice);
+                if (!measured.count(FlagTuner::key(flags)) && queued.insert(FlagTuner::key(flags)).second)
+                    pending.push_back(flags);
+            }
+
+            std::map<std::string, std::filesystem::path> binaries;
+            std::mutex lock;
+            std::atomic<size_t> next{0};
+            std::vector<std::thread> workers;
+            for (size_t i = 0; i < std::min<size_t>(jobs, pending.size()); i++)
+                workers.emplace_back([&]
+                                     {
+                                         for (size_t index; (index = next++) < pending.size();)
+                                         {
+                                             const auto &flags = pending[index];
+                                             try
+                                             {
+                                                 auto binary = buildTuneVariant(workDir, flags, type, executable.name, configureKey, launcher, parallel, storeLock);
+                                                 std::lock_guard<std::mutex> guard(lock);
+                                                 binaries[FlagTuner::key(flags)] = binary;
+                                             }
+                                             catch (const std::exception &e)
+                                             {
+                                                 Log::warning() << "  " << FlagTuner::describe(flags) << ": " << e.what();
+                                             }
+                                         } });
+            for (auto &worker : workers)
+                worker.join();
+
+            // Timed one after the other, so variants do not compete for the machine
+            for (const auto &flags : pending)
+            {
+                auto key = FlagTuner::key(flags);
+                measured[key] = -1;
+                BenchResult result;
+                Log::info() << "Variant " << FlagTuner::describe(flags) << ":";
+                if (binaries.count(key) && benchExecutable(binaries[key], runs, arguments, &result, environment))
+                    measured[key] = result.medianMs;
+            }
+            std::vector<double> times;
+            for (const auto &choice : choices)
+                times.push_back(measured[FlagTuner::key(FlagTuner::combine(space, choice))]);
+            return times;
+        };
+
+        Log::info() << "Tuning " << executable.name << " for profile " << profile << ": " << space.size() << " flag dimensions, "
+                    << jobs << " variant builds at a time.";
+        std::vector<size_t> current(space.size(), 0);
+        double baselineMs = measure({current}).front();
+        if (baselineMs < 0)
+        {
+            Log::error() << "The starting flags did not build or run; see the logs in " << workDir.string() << ".";
+            return false;
+        }
+        double currentMs = baselineMs;
+        for (size_t d = 0; d < space.size(); d++)
+        {
+            std::vector<std::vector<size_t>> candidates;
+            for (size_t alternative = 0; alternative < space[d].alternatives.size(); alternative++)
+            {
+                if (alternative == current[d])
+                    continue;
+                candidates.push_back(current);
+                candidates.back()[d] = alternative;
+            }
+            Log::info() << "Trying " << candidates.size() << " alternatives for " << space[d].name << "...";
+            auto times = measure(candidates);
+            size_t best = candidates.size();
+            for (size_t i = 0; i < candidates.size(); i++)
+                if (times[i] > 0 && times[i] < currentMs * (1 - FlagTuner::noiseMargin) && (best == candidates.size() || times[i] < times[best]))
+                    best = i;
+            if (best < candidates.size())
+            {
+                current = candidates[best];
+                currentMs = times[best];
+            }
+        }
+
+        auto flags = FlagTuner::combine(space, current);
+        Log::info() << "Best flags for " << profile << ":";
+        for (size_t d = 0; d < space.size(); d++)
+            Log::info() << "  " << std::left << std::setw(16) << space[d].name << std::right
+                        << FlagTuner::describe(space[d].alternatives[current[d]]);
+        Log::info() << std::fixed << std::setprecision(2) << "Median " << baselineMs << " ms -> " << currentMs << " ms ("
+                    << baselineMs / currentMs << "x).";
+
+        config = loadConfig();
+        FlagTuner::save(config, profile, flags, baselineMs, currentMs);
+        saveConfig(config);
+        writeCMakeModule("TegenFlags.cmake", FlagTuner::cmakeModule(config), "tuned compiler flags");
+        Log::info() << "Saved to profiles." << profile << ".flags in TegenConfig.json; builds of that profile use them from now on.";
+        return true;
+    }
+
+    // Profile the executable on a training run (arguments are passed to it), then write a layout-optimized
+    // copy next to it (<name>.optimized) and benchmark the two against each other
+    bool optimize(const std::string &target, const std::string &arguments, int runs, bool forceOrderFile)
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found in the current directory. Run 'init' first.";
+            return false;
+        }
+
+        json config = loadConfig();
+        CMakeFileApi::Target executable;
+        ActionGraph graph(actionCacheFile());
+        addBuildActions(graph, executableResolver(config, target, executable, "tegen optimize"));
+        graph.run();
+
+        auto projectDir = std::filesystem::current_path();
+        auto workDir = projectDir / "build" / ".tegen" / "optimize";
+        std::filesystem::path original = executable.artifacts.front();
+        auto optimized = original.parent_path() / (original.stem().string() + ".optimized" + original.extension().string());
+        std::filesystem::create_directories(workDir);
+
+        // Variants are built in their own trees with the project's build type, so only the layout differs
+        auto buildVariant = [&](const std::string &name, const std::string &compileFlags, const std::string &linkFlags)
+        { return this->buildVariant(workDir / name, compileFlags, linkFlags, executable.name); };
+
+        // What the optimized binary is measured against
+        std::filesystem::path baseline = original;
+        if (LayoutOptimizer::pick(forceOrderFile) == LayoutOptimizer::Method::Bolt)
+        {
+            Log::info() << "Optimizing " << executable.name << " with BOLT...";
+            auto binary = buildVariant("bolt-build", "", LayoutOptimizer::boltLinkFlags());
+            // The variant is built from its own flags, so the project's build is no fair baseline
+            baseline = binary;
+            auto profile = workDir / "bolt.fdata";
+            if (LayoutOptimizer::lbrAvailable())
+            {
+                Log::info() << "Profiling with perf branch sampling (LBR)...";
+                auto samples = workDir / "perf.data";
+                executeCommand("perf record -q -e cycles:u -j any,u -o \"" + samples.string() + "\" -- \"" + binary.string() + "\"" + arguments);
+                executeCommand("perf2bolt -p \"" + samples.string() + "\" -o \"" + profile.string() + "\" \"" + binary.string() + "\"");
+            }
+            else
+            {
+                Log::info() << "No LBR sampling available; profiling with BOLT instrumentation...";
+                auto instrumented = workDir / (executable.name + ".instrumented");
+                executeCommand("llvm-bolt \"" + binary.string() + "\" -instrument -instrumentation-file=\"" + profile.string() +
+                               "\" -o \"" + instrumented.string() + "\"");
+                executeCommand("\"" + instrumented.string() + "\"" + arguments);
+            }
+            executeCommand(LayoutOptimizer::boltCommand(binary, profile, optimized));
+        }
+        else
+        {
+            auto linker = LayoutOptimizer::orderingLinker();
+            if (linker.empty())
+            {
+                Log::error() << "Layout optimization needs llvm-bolt, or the gold or lld linker for an order file.";
+                return false;
+            }
+            Log::info() << "Optimizing " << executable.name << " with a function order file (" << linker << ")...";
+
+            // Function call counts from a --coverage training run
+            auto instrumented = buildVariant("profile-build", "--coverage -ffunction-sections", "--coverage");
+            auto prefix = workDir / "profile";
+            Trash::removeTree(prefix);
+            executeCommand("GCOV_PREFIX=\"" + prefix.string() + "\" GCOV_PREFIX_STRIP=0 \"" + instrumented.string() + "\"" + arguments);
+            auto hot = LayoutOptimizer::hotFunctions(GcovReader::reports(prefix));
+            if (hot.empty())
+            {
+                Log::error() << "The training run recorded no function counts; is gcov available?";
+                return false;
+            }
+
+            auto orderFile = workDir / "order.txt";
+            LayoutOptimizer::writeOrderFile(hot, linker, orderFile);
+            Log::info() << "Ordered " << hot.size() << " hot functions (" << orderFile.string() << ").";
+            auto laidOut = buildVariant("layout-build", "-ffunction-sections", LayoutOptimizer::orderingLinkFlags(linker, orderFile));
+            std::filesystem::copy_file(laidOut, optimized, std::filesystem::copy_options::overwrite_existing);
+        }
+
+        Log::info() << "Optimized binary: " << optimized.string();
+        Log::info();
+        BenchResult before;
+        BenchResult after;
+        if (!benchExecutable(baseline, runs, arguments, &before) || !benchExecutable(optimized, runs, arguments, &after))
+            return false;
+        double change = before.medianMs > 0 ? (after.medianMs - before.medianMs) * 100.0 / before.medianMs : 0;
+        Log::info();
+        Log::info() << "Median " << std::fixed << std::setprecision(2) << before.medianMs << " ms -> " << after.medianMs << " ms ("
+                    << std::showpos << change << std::noshowpos << "%).";
+        return true;
+    }
+
+    // Run the executable once under a profiler and save per-line weights to build/.tegen/profile.json:
+    // perf cycle samples when perf works here, line execution counts from a --coverage build otherwise
+    bool profile(const std::string &target, const std::string &arguments)
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found in the current directory. Run 'init' first.";
+            return false;
+        }
+
+        json config = loadConfig();
+        CMakeFileApi::Target executable;
+        ActionGraph graph(actionCacheFile());
+        addBuildActions(graph, executableResolver(config, target, executable, "tegen run --profile"));
+        graph.run();
+
+        auto projectDir = std::filesystem::current_path();
+        auto workDir = projectDir / "build" / ".tegen" / "profile";
+        std::filesystem::create_directories(workDir);
+        std::string environment = allocatorEnvironment(Allocators::active(config, "build"));
+
+        LineProfile result;
+        if (LayoutOptimizer::hasTool("perf") && std::system("perf record -q -o /dev/null -- true >/dev/null 2>&1") == 0)
+        {
+            Log::info() << "Profiling " << executable.name << " with perf...";
+            auto samples = workDir / "perf.data";
+            executeCommand(environment + "perf record -q -F 2999 -o \"" + samples.string() + "\" -- \"" +
+                           executable.artifacts.front().string() + "\"" + arguments);
+            result = LineProfile::fromPerfReport(TestRunner::capture("perf report -i \"" + samples.string() +
+                                                                     "\" --stdio -q --no-children --sort srcline -F overhead,srcline --full-source-path 2>/dev/null"),
+                                                 projectDir);
+            if (result.empty())
+                Log::info() << "perf found no project source lines (build with debug info, e.g. RelWithDebInfo); using execution counts.";
+        }
+        if (result.empty())
+        {
+            Log::info() << "Profiling " << executable.name << " with line execution counts...";
+            auto instrumented = buildVariant(workDir / "build", "--coverage", "--coverage", executable.name);
+            auto counters = workDir / "counters";
+            Trash::removeTree(counters);
+            executeCommand(environment + "GCOV_PREFIX=\"" + counters.string() + "\" GCOV_PREFIX_STRIP=0 \"" +
+                           instrumented.string() + "\"" + arguments);
+            result = LineProfile::fromGcov(GcovReader::reports(counters), projectDir);
+        }
+        if (result.empty())
+        {
+            Log::error() << "The profile has no project source lines.";
+            return false;
+        }
+
+        result.target = executable.name;
+        auto file = projectDir / "build" / ".tegen" / "profile.json";
+        result.save(file);
+
+        std::vector<std::pair<std::string, double>> hottest(result.weights.begin(), result.weights.end());
+        std::sort(hottest.begin(), hottest.end(), [](const auto &a, const auto &b)
+                  { return a.second > b.second; });
+        Log::info() << "Hottest lines (" << result.unit() << "):";
+        for (size_t i = 0; i < hottest.size() && i < 10; i++)
+            Log::info() << "  " << std::setw(12) << std::fixed << std::setprecision(result.source == "perf" ? 2 : 0)
+                        << hottest[i].second << std::defaultfloat << "  " << hottest[i].first;
+        Log::info() << "Profile saved to " << file.string() << ".";
+        return true;
+    }
+
+    // Break the start of a run down into exec, dynamic loading, static initializers and the time to main
+    // and to the first output, and suggest what would shorten it (see StartupProfile)
+    bool startupProfile(const std::string &target, const std::vector<std::string> &arguments, size_t runs = 10)
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found in the current directory. Run 'init' first.";
+            return false;
+        }
+#ifdef _WIN32
+        Log::error() << "Startup profiles need fork/exec and the glibc loader; they are not available on Windows.";
+        return false;
+#endif
+
+        json config = loadConfig();
+        CMakeFileApi::Target executable;
+        ActionGraph graph(actionCacheFile());
+        addBuildActions(graph, executableResolver(config, target, executable, "tegen run --startup"));
+        graph.run();
+
+        auto projectDir = std::filesystem::current_path();
+        auto workDir = projectDir / "build" / ".tegen" / "startup";
+        std::filesystem::create_directories(workDir);
+        std::vector<std::string> environment;
+        for (const auto &[key, value] : allocatorVariables(Allocators::active(config, "build")))
+            environment.push_back(key + "=" + value);
+        runs = std::max<size_t>(runs, 1);
+
+        // Plain runs, after one that brings the binary and its libraries into the page cache
+        Log::info() << "Timing " << runs << " starts of " << executable.name << "...";
+        auto binary = executable.artifacts.front();
+        StartupProfile::run(binary, arguments, environment);
+        std::vector<double> firstOutput, exits;
+        for (size_t i = 0; i < runs; i++)
+        {
+            auto timed = StartupProfile::run(binary, arguments, environment);
+            if (timed.firstOutputMs >= 0)
+                firstOutput.push_back(timed.firstOutputMs);
+            exits.push_back(timed.exitMs);
+        }
+        auto loader = StartupProfile::loader(binary, arguments, environment, workDir);
+        double cyclesPerMs = StartupProfile::cyclesPerMs();
+        double loaderMs = cyclesPerMs > 0 ? loader.startupCycles / cyclesPerMs : 0;
+
+        Log::info() << "Building an instrumented " << executable.name << " for its static initializers...";
+        auto hooks = workDir / "startup-hooks.cpp";
+        std::ofstream(hooks) << StartupProfile::hooksSource();
+        std::string compiler = cmakeCacheValue("build", "CMAKE_CXX_COMPILER");
+        bool gcc = !ToolchainCache::probe(compiler.empty() ? "c++" : compiler, getStoreDirectory()).clang;
+        auto hooksObject = workDir / "startup-hooks.o";
+        executeCommand("\"" + (compiler.empty() ? std::string("c++") : compiler) + "\" -O2 -c \"" + hooks.string() + "\" -o \"" +
+                       hooksObject.string() + "\"");
+        auto instrumentedBinary = buildVariant(workDir / "build", StartupProfile::compileFlags(gcc), StartupProfile::linkFlags(hooksObject),
+                                               executable.name, "", workDir / "build.log");
+        long long mainOffset = StartupProfile::mainOffset(instrumentedBinary);
+        std::vector<StartupProfile::Instrumented> instrumentedRuns;
+        for (size_t i = 0; i < std::min<size_t>(runs, 5); i++)
+            instrumentedRuns.push_back(StartupProfile::instrumented(instrumentedBinary, arguments, environment, mainOffset, workDir));
+        auto startup = StartupProfile::combine(instrumentedRuns);
+
+        double toFirstOutput = firstOutput.empty() ? -1 : StartupProfile::median(firstOutput);
+        auto row = [](const std::string &label, double ms, const std::string &detail = "")
+        {
+            auto line = Log::info();
+            line << "  " << std::left << std::setw(28) << label << std::right << std::setw(9) << std::fixed << std::setprecision(2) << ms
+                 << " ms" << (detail.empty() ? "" : "  " + detail);
+        };
+        Log::info() << "Startup of " << executable.name << " (median of " << runs << " runs):";
+        std::ostringstream counts;
+        counts << loader.relocations << " relocations (" << loader.relativeRelocations << " relative), " << loader.lookups
+               << " symbol lookups";
+        if (loader.dynamic && loaderMs > 0)
+        {
+            counts << std::fixed << std::setprecision(2) << ", " << loader.relocationCycles / cyclesPerMs << " ms relocating, "
+                   << loader.loadCycles / cyclesPerMs << " ms loading objects";
+            row("exec and library init", std::max(0.0, startup.initMs - loaderMs));
+            row("dynamic loader", loaderMs, counts.str());
+        }
+        else
+        {
+            row(loader.dynamic ? "exec and dynamic loading" : "exec (static executable)", startup.initMs, loader.dynamic ? counts.str() : "");
+        }
+        row("static initializers", startup.mainMs - startup.initMs, "instrumented build");
+        row("time to main", startup.mainMs);
+        if (toFirstOutput >= 0)
+        {
+            row("main to first output", std::max(0.0, toFirstOutput - startup.mainMs));
+            row("time to first output", toFirstOutput);
+        }
+        else
+        {
+            Log::info() << "  (no output)";
+        }
+        row("exit", StartupProfile::median(exits), loader.dynamic ? std::to_string(loader.lazyLookups) + " lazy symbol lookups after main" : "");
+
+        if (!startup.initializers.empty())
+        {
+            Log::info() << "Static initializers by file:";
+            for (size_t i = 0; i < startup.initializers.size() && i < 10; i++)
+            {
+                const auto &initializer = startup.initializers[i];
+                Log::info() << "  " << std::setw(9) << std::fixed << std::setprecision(3) << initializer.ms << " ms  "
+                            << StartupProfile::relative(initializer.source, projectDir)
+                            << (initializer.function.empty() ? "" : "  (" + initializer.function + ")");
+            }
+        }
+
+        std::vector<std::filesystem::path> libraries;
+        for (const auto &candidate : CMakeFileApi(projectDir / "build").targets())
+            if (candidate.type == "SHARED_LIBRARY")
+                libraries.insert(libraries.end(), candidate.artifacts.begin(), candidate.artifacts.end());
+        auto suggestions = StartupProfile::advice(loader, loaderMs, startup, libraries, projectDir);
+        if (suggestions.empty())
+            Log::info() << "No startup change stands out.";
+        for (const auto &suggestion : suggestions)
+            Log::info() << "- " << suggestion;
+        return true;
+    }
+
+    // Rebuild with missed-vectorization remarks and list the loops, hottest first when a profile exists
+    bool optReport(size_t limit = 20)
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found in the current directory. Run 'init' first.";
+            return false;
+        }
+
+        ActionGraph graph(actionCacheFile());
+        addBuildActions(graph);
+        graph.run();
+
+        // The vectorizer only runs in optimized builds
+        std::string buildType = cmakeCacheValue("build", "CMAKE_BUILD_TYPE");
+        std::string lowered = buildType;
+        std::transform(lowered.begin(), lowered.end(), lowered.begin(), [](unsigned char c)
+                       { return char(std::tolower(c)); });
+        if (lowered.empty() || lowered == "debug")
+        {
+            Log::info() << "Build type " << (buildType.empty() ? "(none)" : buildType) << " does not vectorize; reporting on a Release build.";
+            buildType = "Release";
+        }
+
+        auto projectDir = std::filesystem::current_path();
+        auto workDir = projectDir / "build" / ".tegen" / "opt-report";
+        auto log = workDir / "build.log";
+        std::filesystem::create_directories(workDir);
+        std::string compiler = cmakeCacheValue("build", "CMAKE_CXX_COMPILER");
+        bool clang = !compiler.empty() && ToolchainCache::probe(compiler, getStoreDirectory()).clang;
+        std::string compilerId = clang ? "Clang" : "GNU";
+        Log::info() << "Compiling with optimization remarks (" << compilerId << ", " << buildType << ")...";
+        buildVariant(workDir / "build", OptReport::compilerFlags(compilerId), "", "", buildType, log);
+
+        std::ifstream in(log);
+        std::stringstream output;
+        output << in.rdbuf();
+        auto loops = OptReport::parse(output.str(), projectDir);
+        auto profile = LineProfile::load(projectDir / "build" / ".tegen" / "profile.json");
+        OptReport::rank(loops, profile);
+
+        if (loops.empty())
+        {
+            Log::info() << "No missed vectorization in project sources.";
+            return true;
+        }
+        size_t shown = std::min(limit, loops.size());
+        if (profile.empty())
+            Log::info() << loops.size() << " loops not vectorized (no profile; run 'tegen run --profile' to rank them by heat):";
+        else
+            Log::info() << loops.size() << " loops not vectorized, hottest first by " << profile.unit() << " from 'tegen run --profile' ("
+                        << profile.target << "):";
+        for (size_t i = 0; i < shown; i++)
+        {
+            const auto &loop = loops[i];
+            {
+                auto line = Log::info();
+                line << "  " << loop.file << ":" << loop.line;
+                if (!profile.empty())
+                    line << "  [" << std::fixed << std::setprecision(profile.source == "perf" ? 2 : 0) << loop.weight << "]";
+            }
+            Log::info() << "      " << OptReport::summary(loop);
+        }
+        if (shown < loops.size())
+            Log::info() << "  ... " << loops.size() - shown << " more; full compiler output in " << log.string();
+        return true;
+    }
+
+    // Attribute the executable's size to the project and each package. Every run is saved as a snapshot;
+    // with diff, the sizes are compared against the previous snapshot (or the given snapshot file).
+    bool size(const std::string &target, bool diff, const std::string &against = "")
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found in the current directory. Run 'init' first.";
+            return false;
+        }
+
+        json config = loadConfig();
+        CMakeFileApi::Target executable;
+        ActionGraph graph(actionCacheFile());
+        addBuildActions(graph, executableResolver(config, target, executable, "tegen size"));
+        graph.run();
+
+        // The same build with a link map, which the normal build does not write
+        auto projectDir = std::filesystem::current_path();
+        auto workDir = projectDir / "build" / ".tegen" / "size";
+        auto mapFile = workDir / (executable.name + ".map");
+        std::filesystem::create_directories(workDir);
+        auto binary = buildVariant(workDir / "build", "", "-Wl,-Map=" + mapFile.string(), executable.name);
+
+        std::vector<std::string> dependencies;
+        for (const auto &[name, version] : config["dependencies"].items())
+            dependencies.push_back(name);
+        auto report = SizeReport::analyze(binary, mapFile, projectDir, PackageManifest(projectDir), dependencies);
+
+        auto latest = workDir / "latest.json";
+        auto previous = workDir / "previous.json";
+        std::filesystem::path baseline = against.empty() ? latest : std::filesystem::path(against);
+        SizeReport before;
+        if (diff)
+            before = SizeReport::load(baseline);
+        if (std::filesystem::exists(latest))
+            std::filesystem::rename(latest, previous);
+        report.save(latest);
+        if (diff && against.empty())
+            baseline = previous;
+
+        // Owners largest first, "system" last
+        std::vector<std::string> owners;
+        for (const auto &[owner, kinds] : report.owners)
+            owners.push_back(owner);
+        for (const auto &[owner, kinds] : before.owners)
+            if (!report.owners.count(owner))
+                owners.push_back(owner);
+        std::stable_sort(owners.begin(), owners.end(), [&](const std::string &a, const std::string &b)
+                         {
+                             if ((a == "system") != (b == "system"))
+                                 return b == "system";
+                             return report.total(a) > report.total(b); });
+
+        auto cell = [&](uint64_t now, uint64_t was)
+        {
+            std::ostringstream out;
+            if (diff)
+                out << std::showpos << int64_t(now) - int64_t(was);
+            else
+                out << now;
+            return out.str();
+        };
+        auto row = [&](const std::string &label, const std::map<std::string, uint64_t> &now, const std::map<std::string, uint64_t> &was)
+        {
+            auto line = Log::info();
+            line << "  " << std::left << std::setw(20) << label << std::right;
+            uint64_t totalNow = 0;
+            uint64_t totalWas = 0;
+            for (const char *kind : SizeReport::kinds)
+            {
+                auto a = now.count(kind) ? now.at(kind) : 0;
+                auto b = was.count(kind) ? was.at(kind) : 0;
+                totalNow += a;
+                totalWas += b;
+                line << std::setw(11) << cell(a, b);
+            }
+            line << std::setw(12) << cell(totalNow, totalWas);
+        };
+
+        Log::info() << (diff ? "Size change of " : "Size of ") << executable.name << " in bytes"
+                    << (diff ? " since " + baseline.string() : "") << ":";
+        {
+            auto header = Log::info();
+            header << "  " << std::left << std::setw(20) << "owner" << std::right;
+            for (const char *kind : SizeReport::kinds)
+                header << std::setw(11) << kind;
+            header << std::setw(12) << "total";
+        }
+        std::map<std::string, uint64_t> sumNow;
+        std::map<std::string, uint64_t> sumWas;
+        for (const auto &owner : owners)
+        {
+            auto now = report.owners.count(owner) ? report.owners.at(owner) : std::map<std::string, uint64_t>();
+            auto was = before.owners.count(owner) ? before.owners.at(owner) : std::map<std::string, uint64_t>();
+            for (const auto &[kind, bytes] : now)
+                sumNow[kind] += bytes;
+            for (const auto &[kind, bytes] : was)
+                sumWas[kind] += bytes;
+            if (diff && now == was)
+                continue;
+            row(owner, now, was);
+        }
+        row("total", sumNow, sumWas);
+
+        if (diff)
+        {
+            auto changed = SizeReport::symbolDelta(before, report);
+            if (changed.empty())
+            {
+                Log::info() << "No symbol changed size.";
+                return true;
+            }
+            Log::info() << "Largest symbol changes:";
+            for (size_t i = 0; i < changed.size() && i < 15; i++)
+                Log::info() << "  " << std::setw(9) << std::showpos << changed[i].second << std::noshowpos << "  " << changed[i].first;
+            if (changed.size() > 15)
+                Log::info() << "  ... " << changed.size() - 15 << " more";
+            return true;
+        }
+
+        auto groups = report.templateGroups();
+        if (!groups.empty())
+        {
+            Log::info() << "Largest template instantiation groups (code):";
+            for (size_t i = 0; i < groups.size() && i < 10; i++)
+                Log::info() << "  " << std::setw(9) << groups[i].size << "  " << std::setw(4) << groups[i].count << "x  "
+                            << groups[i].name << " [" << groups[i].owner << "]";
+        }
+        Log::info() << "Snapshot saved to " << latest.string() << "; compare a later build with 'tegen size --diff'.";
+        return true;
+    }
+
+    // Rebuild and rerun (or re-bench) the project whenever its sources change
+    void watch(bool benchMode = false)
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found in the current directory. Run 'init' first.";
+            return;
+        }
+
+        // Later stages are implied by earlier ones: a reconfigure is followed by a rebuild and a rerun
+        enum Stage
+        {
+            Idle,
+            Rerun,
+            Rebuild,
+            Reconfigure
+        };
+        const char *stageNames[] = {"idle", benchMode ? "bench" : "run", "build", "configure"};
+
+        CMakeFileApi("build").writeQuery();
+        FileWatcher watcher(std::filesystem::current_path());
+        watcher.watchTree("src");
+        watcher.watchTree("include");
+        watcher.watchTree("cmake");
+        watcher.watchDirectory("", [this](const std::string &name)
+                               { return name == configFileName || name == "CMakeLists.txt" ||
+                                        (name.size() > 6 && name.compare(name.size() - 6, 6, ".cmake") == 0); });
+
+        auto classify = [this](const std::string &path)
+        {
+            std::string name = std::filesystem::path(path).filename().string();
+            if (name == configFileName || name == "CMakeLists.txt" || std::filesystem::path(path).extension() == ".cmake")
+                return Reconfigure;
+            return Rebuild;
+        };
+
+        auto commandFor = [&](Stage stage)
+        {
+            if (stage == Reconfigure)
+                return std::string("cmake -S . -B build");
+            if (stage == Rebuild)
+                return std::string("cmake --build build");
+            if (benchMode)
+                return "\"" + selfExecutable() + "\" bench";
+            return "\"" + executablePath(loadConfig()).string() + "\"";
+        };
+
+        interrupted = 0;
+        auto previousHandler = std::signal(SIGINT, [](int)
+                                           { interrupted = 1; });
+
+        Stage pending = std::filesystem::exists("build/CMakeCache.txt") ? Rebuild : Reconfigure;
+        Stage active = Idle;
+        Stage failed = Idle;
+        ChildProcess job;
+        Log::info() << "Watching src/, include/, CMake files and " << configFileName << ". Press Ctrl+C to stop.";
+
+        while (!interrupted)
+        {
+            if (!job.isRunning() && pending != Idle)
+            {
+                active = pending;
+                pending = Idle;
+                Log::info() << "[watch] " << stageNames[active] << "...";
+                Log::flush();
+                job.start(commandFor(active));
+            }
+
+            auto changes = watcher.wait(std::chrono::milliseconds(job.isRunning() ? 20 : 500));
+
+            if (active != Idle && job.poll())
+            {
+                auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(job.duration()).count();
+                if (job.result() == 0)
+                {
+                    failed = Idle;
+                    pending = std::max(pending, Stage(active - 1));
+                    if (active == Rerun)
+                        Log::info() << "[watch] " << stageNames[active] << " finished in " << ms << " ms. Waiting for changes...";
+                }
+                else
+                {
+                    failed = active;
+                    Log::info() << "[watch] " << stageNames[active] << " failed (exit code " << job.result() << "). Waiting for changes...";
+                }
+                active = Idle;
+            }
+
+            if (changes.empty())
+                continue;
+
+            // Debounce: editors and formatters write in bursts, so wait for a quiet period
+            for (auto more = watcher.wait(watchDebounce); !more.empty(); more = watcher.wait(watchDebounce))
+                changes.insert(changes.end(), more.begin(), more.end());
+
+            Stage needed = Rerun;
+            for (const auto &path : changes)
+                needed = std::max(needed, classify(path));
+
+            if (job.isRunning())
+            {
+                // The running stage is working on stale inputs; restart it (or an earlier one) with the new edits
+                Log::info() << "[watch] " << changes.size() << " change(s); cancelling " << stageNames[active] << ".";
+                job.cancel();
+                needed = std::max(needed, active);
+                active = Idle;
+            }
+            else
+            {
+                Log::info() << "[watch] " << changes.size() << " change(s) detected.";
+            }
+            pending = std::max({pending, needed, failed});
+        }
+
+        job.cancel();
+        std::signal(SIGINT, previousHandler);
+        Log::info();
+        Log::info() << "Stopped watching.";
+    }
+
+    // Record which project files every test executes, for 'tegen test --affected'
+    bool recordTestImpact(TestRunner::Options options)
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found in the current directory. Run 'init' first.";
+            return false;
+        }
+
+        // A separate instrumented tree, so the regular build keeps its flags and objects
+        auto projectDir = std::filesystem::current_path();
+        auto impactDir = projectDir / "build" / ".tegen" / "impact-build";
+        auto profilesDir = projectDir / "build" / ".tegen" / "impact-profiles";
+        CMakeFileApi(impactDir).writeQuery();
+        std::string flags = " -DCMAKE_C_FLAGS=--coverage -DCMAKE_CXX_FLAGS=--coverage -DCMAKE_EXE_LINKER_FLAGS=--coverage"
+                            " -DCMAKE_SHARED_LINKER_FLAGS=--coverage";
+        Log::flush();
+        if (ChildProcess::run("cmake -S . -B \"" + impactDir.string() + "\"" + flags) != 0 ||
+            ChildProcess::run("cmake --build \"" + impactDir.string() + "\"") != 0)
+        {
+            Log::error() << "Failed to build the coverage-instrumented tree in " << impactDir.string();
+            return false;
+        }
+
+        TestRunner runner(impactDir);
+        auto tests = runner.discover();
+        if (tests.empty())
+        {
+            Log::info() << "No tests found. Register them with add_test() or build a GoogleTest/doctest executable.";
+            return true;
+        }
+
+        // Each test dumps its counters under its own GCOV_PREFIX, so they can run in parallel
+        Trash::removeTree(profilesDir);
+        for (size_t i = 0; i < tests.size(); i++)
+        {
+            tests[i].environment.push_back("GCOV_PREFIX=" + (profilesDir / std::to_string(i)).string());
+            tests[i].environment.push_back("GCOV_PREFIX_STRIP=0");
+        }
+        options.useCache = false;
+        options.only.clear();
+        Log::flush();
+        auto summary = runner.run(tests, options);
+
+        TestImpact impact(projectDir, projectDir / "build" / ".tegen");
+        std::map<std::string, std::set<std::string>> mapping;
+        std::set<std::string> known;
+        for (size_t i = 0; i < tests.size(); i++)
+        {
+            auto prefix = profilesDir / std::to_string(i);
+            if (std::filesystem::exists(prefix))
+                mapping[tests[i].id] = impact.coveredFiles(prefix, known);
+        }
+        Trash::removeTree(profilesDir);
+
+        if (mapping.empty())
+        {
+            Log::error() << "No coverage data was written; is the compiler GCC or Clang with gcov available?";
+            return false;
+        }
+        impact.save(mapping, known);
+        auto recorded = Log::info();
+        recorded << "Recorded impact of " << mapping.size() << " tests over " << known.size() << " files";
+        if (summary.failed)
+            recorded << " (" << summary.failed << " failed)";
+        recorded << ".";
+        return true;
+    }
+
+    // Build the project, then run its tests in parallel; returns false if any test failed.
+    // affected: run only tests whose recorded files changed since base (default: the recording commit)
+    bool test(TestRunner::Options options, bool affected = false, const std::string &base = "")
+    {
+        if (!configExists())
+        {
+            Log::error() << "TegenConfig.json not found in the current directory. Run 'init' first.";
+            return false;
+        }
+
+        // Individual tests are cached by TestRunner itself, keyed on their binaries and inputs
+        ActionGraph graph(actionCacheFile());
+        addBuildActions(graph);
+        graph.run();
+
+        TestRunner runner(std::filesystem::current_path() / "build");
+        auto tests = runner.discover();
+        if (tests.empty())
+        {
+            Log::info() << "No tests found. Register them with add_test() or build a GoogleTest/doctest executable.";
+            return true;
+        }
+        if (affected)
+        {
+            std::vector<std::string> ids;
+            for (const auto &test : tests)
+                ids.push_back(test.id);
+            auto projectDir = std::filesystem::current_path();
+            auto selection = TestImpact(projectDir, projectDir / "build" / ".tegen").select(ids, base);
+            if (selection.runAll)
+            {
+                Log::info() << "Running all tests: " << selection.reason << ".";
+            }
+            else if (selection.tests.empty())
+            {
+                Log::info() << "No tests affected by " << selection.changed.size() << " changed files.";
+                return true;
+            }
+            else
+            {
+                Log::info() << selection.tests.size() << " of " << tests.size() << " tests affected by "
+                            << selection.changed.size() << " changed files.";
+                options.only = selection.tests;
+            }
+        }
+        if (options.shardCount > 1)
+            Log::info() << "Shard " << options.shardIndex + 1 << " of " << options.shardCount << ".";
+
+        auto start = std::chrono::steady_clock::now();
+        Log::flush();
+        auto summary = runner.run(tests, options);
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Show the tail of each failing test's log
+        for (const auto &id : summary.failures)
+        {
+            std::ifstream log(runner.logPath(id));
+            std::vector<std::string> lines;
+            for (std::string line; std::getline(log, line);)
+                lines.push_back(line);
+            Log::error();
+            Log::error() << "---- " << id << " (" << runner.logPath(id).string() << ") ----";
+            for (size_t i = lines.size() > 20 ? lines.size() - 20 : 0; i < lines.size(); i++)
+                Log::error() << lines[i];
+        }
+
+        Log::info();
+        Log::info() << summary.passed << " passed (" << summary.cached << " cached), " << summary.failed << " failed in " << std::fixed
+                    << std::setprecision(2) << seconds << " s.";
+        return summary.failed == 0;
     }
 };
 
@@ -0,0 +1,156 @@
+#ifndef PACKAGE_MANIFEST_HPP
+#define PACKAGE_MANIFEST_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include "json.hpp"
+
+// Which installed files belong to which package. install() copies every package into the
+// shared include/ and lib/ directories, so ownership is recorded separately in
+// .tegen/manifest.json at the project root (outside build/, so 'clean' keeps it).
+//
+// Packages installed before the manifest existed are matched by name instead:
+// include/<package>/... and lib/lib<package>*.
+class PackageManifest
+{
+public:
+    // What including one header alone costs a translation unit (see HeaderCost)
+    struct Cost
+    {
+        double preprocessMs = 0;
+        double parseMs = 0; // Preprocessing included
+        unsigned includes = 0; // Distinct files pulled in transitively
+        uint64_t tokens = 0;
+        std::vector<std::string> issues;
+    };
+
+    struct Package
+    {
+        std::string version;
+        std::vector<std::string> headers;   // Relative to the project root, e.g. include/fmt/core.h
+        std::vector<std::string> libraries; // File names in lib/
+        std::map<std::string, Cost> costs;  // By header
+        // Installed with --lazy: headers stay in the chunk store (by digest) until a compile asks for them
+        bool lazy = false;
+        std::map<std::string, std::string> digests;
+        std::vector<std::string> used; // Headers compiles have asked for, materialized on every build
+    };
+
+    explicit PackageManifest(std::filesystem::path projectDir) : file(std::move(projectDir) / ".tegen" / "manifest.json")
+    {
+        std::ifstream in(file);
+        auto data = in ? nlohmann::json::parse(in, nullptr, false) : nlohmann::json();
+        if (data.is_discarded() || !data.is_object())
+            return;
+        auto packages = data.value("packages", nlohmann::json::object());
+        for (const auto &[name, entry] : packages.items())
+        {
+            Package package;
+            package.version = entry.value("version", "");
+            package.headers = entry.value("headers", std::vector<std::string>());
+            package.libraries = entry.value("libraries", std::vector<std::string>());
+            package.lazy = entry.value("lazy", false);
+            package.digests = entry.value("digests", std::map<std::string, std::string>());
+            package.used = entry.value("used", std::vector<std::string>());
+            auto costs = entry.value("costs", nlohmann::json::object());
+            for (const auto &[header, cost] : costs.items())
+            {
+                package.costs[header] = {cost.value("preprocessMs", 0.0), cost.value("parseMs", 0.0), cost.value("includes", 0u),
+                                         cost.value("tokens", uint64_t(0)), cost.value("issues", std::vector<std::string>())};
+            }
+            entries[name] = std::move(package);
+        }
+    }
+
+    const std::map<std::string, Package> &packages() const
+    {
+        return entries;
+    }
+
+    void set(const std::string &name, Package package)
+    {
+        entries[name] = std::move(package);
+    }
+
+    void save() const
+    {
+        nlohmann::json data;
+        data["packages"] = nlohmann::json::object();
+        for (const auto &[name, package] : entries)
+        {
+            auto &entry = data["packages"][name];
+            entry = {{"version", package.version}, {"headers", package.headers}, {"libraries", package.libraries}};
+            if (package.lazy)
+            {
+                entry["lazy"] = true;
+                entry["digests"] = package.digests;
+                entry["used"] = package.used;
+            }
+            if (package.costs.empty())
+                continue;
+            for (const auto &[header, cost] : package.costs)
+            {
+                entry["costs"][header] = {{"preprocessMs", cost.preprocessMs}, {"parseMs", cost.parseMs}, {"includes", cost.includes},
+                                          {"tokens", cost.tokens}, {"issues", cost.issues}};
+            }
+        }
+        std::filesystem::create_directories(file.parent_path());
+        std::ofstream(file) << data.dump(2);
+    }
+
+    // Package owning a header (path relative to the project root), or "" when it is the project's own
+    std::string headerOwner(const std::string &header, const std::vector<std::string> &dependencies) const
+    {
+        for (const auto &[name, package] : entries)
+            for (const auto &owned : package.headers)
+                if (owned == header)
+                    return name;
+        for (const auto &name : dependencies)
+            if (!entries.count(name) && header.rfind("include/" + name + "/", 0) == 0)
+                return name;
+        return "";
+    }
+
+    // Package owning a library file in lib/, or "" when unknown
+    std::string libraryOwner(const std::string &library, const std::vector<std::string> &dependencies) const
+    {
+        for (const auto &[name, package] : entries)
+            for (const auto &owned : package.libraries)
+                if (owned == library)
+                    return name;
+        for (const auto &name : dependencies)
+            if (!entries.count(name) && library.rfind("lib" + name, 0) == 0)
+                return name;
+        return "";
+    }
+
+    // Top-level directories under include/ that a package owns (usually its namespace)
+    std::vector<std::string> headerRoots(const std::string &name) const
+    {
+        std::vector<std::string> roots;
+        auto found = entries.find(name);
+        if (found == entries.end())
+            return {name};
+        for (const auto &header : found->second.headers)
+        {
+            std::filesystem::path relative = std::filesystem::path(header).lexically_relative("include");
+            auto first = relative.begin();
+            if (first == relative.end() || std::next(first) == relative.end())
+                continue;
+            if (std::find(roots.begin(), roots.end(), first->string()) == roots.end())
+                roots.push_back(first->string());
+        }
+        return roots;
+    }
+
+private:
+    std::filesystem::path file;
+    std::map<std::string, Package> entries;
+};
+
+#endif
@@ -0,0 +1,438 @@
+#ifndef SIZE_REPORT_HPP
+#define SIZE_REPORT_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "package_manifest.hpp"
+
+// Binary size of a linked executable, split by owner ("project", a Tegen package or
+// "system") and by kind (text, rodata, data, bss).
+//
+// The link map (-Wl,-Map, GNU ld or gold format) says which object or archive member
+// every input section came from, so sections are attributed exactly. Archives in the
+// project's lib/ belong to the package that installed them (PackageManifest). Code from
+// header-only packages is compiled into the project's own objects; such symbols are
+// moved to the package whose include/ directory matches their namespace. `nm` supplies
+// the symbols inside each section for the per-symbol diff and the template grouping.
+class SizeReport
+{
+public:
+    static constexpr std::array<const char *, 4> kinds = {"text", "rodata", "data", "bss"};
+
+    struct Section
+    {
+        uint64_t address = 0;
+        uint64_t size = 0;
+        std::string kind;
+        std::string owner;
+    };
+
+    struct Symbol
+    {
+        std::string name; // Demangled
+        std::string owner;
+        std::string kind;
+        uint64_t size = 0;
+    };
+
+    std::string target;
+    std::map<std::string, std::map<std::string, uint64_t>> owners; // owner -> kind -> bytes
+    std::vector<Symbol> symbols;
+
+    uint64_t total(const std::string &owner) const
+    {
+        uint64_t sum = 0;
+        auto found = owners.find(owner);
+        if (found != owners.end())
+            for (const auto &[kind, bytes] : found->second)
+                sum += bytes;
+        return sum;
+    }
+
+    // Analyze a binary from its link map and symbol table
+    static SizeReport analyze(const std::filesystem::path &binary, const std::filesystem::path &mapFile,
+                              const std::filesystem::path &projectDir, const PackageManifest &manifest,
+                              const std::vector<std::string> &dependencies)
+    {
+        std::ifstream in(mapFile);
+        std::stringstream text;
+        text << in.rdbuf();
+        auto sections = parseMap(text.str(), [&](const std::string &input)
+                                 { return inputOwner(input, projectDir, manifest, dependencies); });
+        if (sections.empty())
+            throw std::runtime_error("No input sections found in " + mapFile.string());
+
+        SizeReport report;
+        report.target = binary.filename().string();
+        for (const auto &section : sections)
+            report.owners[section.owner][section.kind] += section.size;
+
+        // Namespaces of header-only code, e.g. "fmt::" for a package installing include/fmt/
+        std::vector<std::pair<std::string, std::string>> namespaces;
+        for (const auto &name : dependencies)
+            for (const auto &root : manifest.headerRoots(name))
+                namespaces.push_back({root + "::", name});
+
+        std::sort(sections.begin(), sections.end(), [](const Section &a, const Section &b)
+                  { return a.address < b.address; });
+        for (auto symbol : readSymbols(binary))
+        {
+            auto section = std::upper_bound(sections.begin(), sections.end(), symbol.first, [](uint64_t address, const Section &candidate)
+                                            { return address < candidate.address; });
+            if (section == sections.begin())
+                continue;
+            --section;
+            if (symbol.first >= section->address + section->size)
+                continue;
+            Symbol entry{symbol.second.name, section->owner, section->kind, symbol.second.size};
+            if (entry.owner == "project")
+            {
+                auto qualified = qualifiedName(entry.name);
+                for (const auto &[prefix, package] : namespaces)
+                {
+                    if (qualified.rfind(prefix, 0) != 0)
+                        continue;
+                    entry.owner = package;
+                    report.owners["project"][entry.kind] -= std::min(report.owners["project"][entry.kind], entry.size);
+                    report.owners[package][entry.kind] += entry.size;
+                    break;
+                }
+            }
+            report.symbols.push_back(std::move(entry));
+        }
+        return report;
+    }
+
+    // Input sections of a GNU ld or gold map file with an owner assigned to each
+    template <typename OwnerOf>
+    static std::vector<Section> parseMap(const std::string &map, OwnerOf ownerOf)
+    {
+        static const std::regex inputSection(R"(^ (\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$)");
+        static const std::regex wrapped(R"(^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$)");
+        static const std::regex lone(R"(^ (\S+)\s*$)");
+
+        std::vector<Section> sections;
+        std::map<std::string, std::string> ownerCache;
+        std::istringstream lines(map);
+        bool started = false;
+        std::string pending; // Section name printed alone on its line because it is long
+        for (std::string line; std::getline(lines, line);)
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            // Everything before this is the archive member list and the discarded sections
+            if (!started)
+            {
+                started = line.rfind("Linker script and memory map", 0) == 0;
+                continue;
+            }
+
+            std::smatch match;
+            std::string name;
+            std::string address;
+            std::string size;
+            std::string input;
+            if (std::regex_match(line, match, inputSection))
+            {
+                name = match[1];
+                address = match[2];
+                size = match[3];
+                input = match[4];
+            }
+            else if (!pending.empty() && std::regex_match(line, match, wrapped))
+            {
+                name = pending;
+                address = match[1];
+                size = match[2];
+                input = match[3];
+            }
+            else
+            {
+                pending = std::regex_match(line, match, lone) ? match[1].str() : "";
+                continue;
+            }
+            pending.clear();
+
+            // *fill* padding and linker-generated entries have no input file worth attributing
+            if (name[0] == '*')
+                continue;
+            Section section;
+            section.kind = kindOf(name);
+            section.address = std::stoull(address, nullptr, 16);
+            section.size = std::stoull(size, nullptr, 16);
+            if (section.kind.empty() || section.size == 0)
+                continue;
+            auto cached = ownerCache.find(input);
+            if (cached == ownerCache.end())
+                cached = ownerCache.emplace(input, ownerOf(input)).first;
+            section.owner = cached->second;
+            sections.push_back(std::move(section));
+        }
+        return sections;
+    }
+
+    // Kind of an input section; empty for sections that take no space at run time
+    static std::string kindOf(const std::string &section)
+    {
+        auto is = [&](const char *prefix)
+        {
+            std::string p = prefix;
+            return section == p || section.rfind(p + ".", 0) == 0;
+        };
+        if (is(".text") || is(".init") || is(".fini") || is(".plt"))
+            return "text";
+        if (is(".rodata") || is(".eh_frame") || is(".eh_frame_hdr") || is(".gcc_except_table"))
+            return "rodata";
+        if (is(".data") || is(".tdata") || is(".init_array") || is(".fini_array") || is(".ctors") || is(".dtors"))
+            return "data";
+        if (is(".bss") || is(".tbss") || section == "COMMON")
+            return "bss";
+        return "";
+    }
+
+    // Owner of an object file or archive member named in the map
+    static std::string inputOwner(const std::string &input, const std::filesystem::path &projectDir,
+                                  const PackageManifest &manifest, const std::vector<std::string> &dependencies)
+    {
+        std::string file = input;
+        bool member = false;
+        // libfoo.a(foo.o)
+        auto open = file.find(".a(");
+        if (open == std::string::npos)
+            open = file.find(".lib(");
+        if (open != std::string::npos && file.back() == ')')
+        {
+            file = file.substr(0, file.find('(', open));
+            member = true;
+        }
+
+        std::filesystem::path path(file);
+        // The linker runs in the build directory, so relative paths are the project's own objects
+        if (path.is_relative())
+            return "project";
+        auto relative = path.lexically_normal().lexically_relative(projectDir);
+        if (relative.empty() || *relative.begin() == "..")
+            return "system";
+        if (member && *relative.begin() == "lib")
+        {
+            auto owner = manifest.libraryOwner(path.filename().string(), dependencies);
+            return owner.empty() ? path.filename().string() : owner;
+        }
+        return "project";
+    }
+
+    // Name without return type and parameters, templates collapsed: "std::vector<>::_M_realloc_insert<>"
+    static std::string templateGroup(const std::string &name)
+    {
+        auto qualified = qualifiedName(name);
+        std::string collapsed;
+        int depth = 0;
+        for (char c : qualified)
+        {
+            if (c == '<')
+            {
+                if (depth++ == 0)
+                    collapsed += c;
+            }
+            else if (c == '>' && depth > 0)
+            {
+                if (--depth == 0)
+                    collapsed += c;
+            }
+            else if (depth == 0)
+            {
+                collapsed += c;
+            }
+        }
+        return collapsed;
+    }
+
+    // Template instantiation groups with at least two members, largest first
+    struct TemplateGroup
+    {
+        std::string name;
+        std::string owner;
+        size_t count = 0;
+        uint64_t size = 0;
+    };
+
+    std::vector<TemplateGroup> templateGroups() const
+    {
+        std::map<std::pair<std::string, std::string>, TemplateGroup> groups;
+        for (const auto &symbol : symbols)
+        {
+            if (symbol.kind != "text" || symbol.name.find('<') == std::string::npos)
+                continue;
+            auto name = templateGroup(symbol.name);
+            auto &group = groups[{symbol.owner, name}];
+            group.name = name;
+            group.owner = symbol.owner;
+            group.count++;
+            group.size += symbol.size;
+        }
+        std::vector<TemplateGroup> result;
+        for (auto &[key, group] : groups)
+            if (group.count >= 2)
+                result.push_back(group);
+        std::stable_sort(result.begin(), result.end(), [](const TemplateGroup &a, const TemplateGroup &b)
+                         { return a.size > b.size; });
+        return result;
+    }
+
+    nlohmann::json toJson() const
+    {
+        nlohmann::json out;
+        out["target"] = target;
+        out["owners"] = owners;
+        out["symbols"] = nlohmann::json::array();
+        for (const auto &symbol : symbols)
+            out["symbols"].push_back({{"name", symbol.name}, {"owner", symbol.owner}, {"kind", symbol.kind}, {"size", symbol.size}});
+        return out;
+    }
+
+    static SizeReport fromJson(const nlohmann::json &data)
+    {
+        SizeReport report;
+        report.target = data.value("target", "");
+        report.owners = data.value("owners", std::map<std::string, std::map<std::string, uint64_t>>());
+        auto symbols = data.value("symbols", nlohmann::json::array());
+        for (const auto &symbol : symbols)
+            report.symbols.push_back({symbol.value("name", ""), symbol.value("owner", ""), symbol.value("kind", ""),
+                                      symbol.value("size", uint64_t(0))});
+        return report;
+    }
+
+    void save(const std::filesystem::path &file) const
+    {
+        std::filesystem::create_directories(file.parent_path());
+        std::ofstream(file) << toJson().dump(1);
+    }
+
+    // Throws when the snapshot is missing or unreadable
+    static SizeReport load(const std::filesystem::path &file)
+    {
+        std::ifstream in(file);
+        auto data = in ? nlohmann::json::parse(in, nullptr, false) : nlohmann::json();
+        if (data.is_discarded() || !data.is_object())
+            throw std::runtime_error("No size snapshot at " + file.string());
+        return fromJson(data);
+    }
+
+    // Size change per symbol (summed over same-named symbols), largest change first
+    static std::vector<std::pair<std::string, int64_t>> symbolDelta(const SizeReport &before, const SizeReport &after)
+    {
+        std::map<std::string, int64_t> delta;
+        for (const auto &symbol : before.symbols)
+            delta[symbol.name] -= int64_t(symbol.size);
+        for (const auto &symbol : after.symbols)
+            delta[symbol.name] += int64_t(symbol.size);
+        std::vector<std::pair<std::string, int64_t>> changed;
+        for (const auto &[name, bytes] : delta)
+            if (bytes != 0)
+                changed.push_back({name, bytes});
+        std::stable_sort(changed.begin(), changed.end(), [](const auto &a, const auto &b)
+                         { return std::llabs(a.second) > std::llabs(b.second); });
+        return changed;
+    }
+
+private:
+    struct RawSymbol
+    {
+        std::string name;
+        uint64_t size = 0;
+    };
+
+    // Sized, defined symbols from `nm -C -S --defined-only`, keyed by address
+    static std::vector<std::pair<uint64_t, RawSymbol>> readSymbols(const std::filesystem::path &binary)
+    {
+        std::vector<std::pair<uint64_t, RawSymbol>> result;
+        std::string command = "nm -C -S --defined-only \"" + binary.string() + "\" 2>/dev/null";
+        FILE *pipe = popen(command.c_str(), "r");
+        if (!pipe)
+            return result;
+        std::string output;
+        char buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+            output.append(buffer, read);
+        pclose(pipe);
+
+        std::istringstream lines(output);
+        for (std::string line; std::getline(lines, line);)
+        {
+            // <address> <size> <type> <name, may contain spaces>
+            std::istringstream fields(line);
+            std::string address;
+            std::string size;
+            std::string type;
+            if (!(fields >> address >> size >> type) || type.size() != 1)
+                continue;
+            std::string name;
+            std::getline(fields >> std::ws, name);
+            RawSymbol symbol{name, std::stoull(size, nullptr, 16)};
+            if (symbol.size > 0 && !name.empty())
+                result.push_back({std::stoull(address, nullptr, 16), std::move(symbol)});
+        }
+        return result;
+    }
+
+    static bool followsOperator(const std::string &name, size_t i)
+    {
+        return i >= 8 && name.compare(i - 8, 8, "operator") == 0;
+    }
+
+    // Demangled name without return type and parameter list
+    static std::string qualifiedName(const std::string &name)
+    {
+        static const std::string anonymous = "(anonymous namespace)";
+        // Cut at the parameter list: the first '(' outside template arguments and {lambda(...)#1}
+        int depth = 0;
+        size_t end = name.size();
+        for (size_t i = 0; i < name.size(); i++)
+        {
+            char c = name[i];
+            if (c == '(' && name.compare(i, anonymous.size(), anonymous) == 0)
+                i += anonymous.size() - 1;
+            else if ((c == '<' || c == '{') && !followsOperator(name, i))
+                depth++;
+            else if ((c == '>' || c == '}') && depth > 0 && !followsOperator(name, i) && name[i - 1] != '-')
+                depth--;
+            else if (c == '(' && depth == 0 && followsOperator(name, i))
+                i++; // operator()
+            else if (c == '(' && depth == 0)
+            {
+                end = i;
+                break;
+            }
+        }
+        std::string head = name.substr(0, end);
+
+        // Drop a return type ("void ns::f<int>"): the last space outside template arguments
+        depth = 0;
+        size_t start = 0;
+        for (size_t i = 0; i < head.size(); i++)
+        {
+            if (head[i] == '<' || head[i] == '{')
+                depth++;
+            else if ((head[i] == '>' || head[i] == '}') && depth > 0)
+                depth--;
+            else if (head[i] == ' ' && depth == 0 && !followsOperator(head, i) && head.compare(i + 1, 1, "[") != 0)
+                start = i + 1;
+        }
+        return head.substr(start);
+    }
+};
+
+#endif
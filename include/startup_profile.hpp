@@ -0,0 +1,584 @@
+#ifndef STARTUP_PROFILE_HPP
+#define STARTUP_PROFILE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "test_runner.hpp"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+extern char **environ;
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Where the time goes between starting a program and it doing something, for short-lived
+// tools where that is most of their run. The phases come from three kinds of runs:
+//
+//   plain         fork/exec with the output on a pipe: time to the first byte and to exit
+//   loader        the same with LD_DEBUG=statistics,bindings: the dynamic loader's cycles,
+//                 relocations and symbol lookups before it hands over to the program
+//   instrumented  a variant built with -finstrument-functions and linked with a small hooks
+//                 object, which timestamps the start of the executable's constructors, each
+//                 top-level call they make (per translation unit's initializer) and main
+//
+// Initializer times come from the instrumented build, so they include its overhead.
+class StartupProfile
+{
+public:
+    struct Run
+    {
+        long pid = 0;
+        int status = 0;
+        double firstOutputMs = -1; // -1 when the program printed nothing
+        double exitMs = 0;
+    };
+
+    struct Loader
+    {
+        bool dynamic = false; // False for static executables, which print no statistics
+        double startupCycles = 0;
+        double relocationCycles = 0;
+        double loadCycles = 0;
+        unsigned long relocations = 0;
+        unsigned long relativeRelocations = 0;
+        unsigned long lookups = 0;     // Symbol bindings before control reaches the program
+        unsigned long lazyLookups = 0; // Bindings afterwards (PLT entries resolved on first call)
+        std::map<std::string, unsigned long> lookupsInto; // Object the startup lookups resolved into -> count
+    };
+
+    struct Initializer
+    {
+        std::string source;   // Translation unit
+        std::string function; // Its slowest top-level call
+        double ms = 0;
+    };
+
+    struct Instrumented
+    {
+        double initMs = -1; // Executable's first constructor, since fork
+        double mainMs = -1;
+        std::vector<Initializer> initializers; // Slowest first
+    };
+
+    // Start executable with args and extra environment ("NAME=value"), its stdin on /dev/null and
+    // its stdout and stderr read through a pipe
+    static Run run(const std::filesystem::path &executable, const std::vector<std::string> &args,
+                   const std::vector<std::string> &environment = {})
+    {
+#ifdef _WIN32
+        (void)executable;
+        (void)args;
+        (void)environment;
+        throw std::runtime_error("Startup profiles need fork and exec");
+#else
+        // Everything the child needs is built before the clock starts
+        std::string path = executable.string();
+        std::vector<char *> argv{const_cast<char *>(path.c_str())};
+        for (const auto &arg : args)
+            argv.push_back(const_cast<char *>(arg.c_str()));
+        argv.push_back(nullptr);
+        std::vector<char *> envp;
+        for (char **variable = environ; *variable; variable++)
+            envp.push_back(*variable);
+        for (const auto &variable : environment)
+            envp.push_back(const_cast<char *>(variable.c_str()));
+        envp.push_back(nullptr);
+
+        int output[2];
+        if (::pipe(output) != 0)
+            throw std::runtime_error("Could not create a pipe");
+        Run result;
+        int64_t started = now();
+        pid_t pid = ::fork();
+        if (pid < 0)
+            throw std::runtime_error("Could not start " + path);
+        if (pid == 0)
+        {
+            int null = ::open("/dev/null", O_RDONLY);
+            ::dup2(null, 0);
+            ::dup2(output[1], 1);
+            ::dup2(output[1], 2);
+            ::close(output[0]);
+            ::close(output[1]);
+            ::execve(argv[0], argv.data(), envp.data());
+            ::_exit(127);
+        }
+        ::close(output[1]);
+        char buffer[65536];
+        while (true)
+        {
+            ssize_t bytes = ::read(output[0], buffer, sizeof(buffer));
+            if (bytes < 0 && errno == EINTR)
+                continue;
+            if (bytes <= 0)
+                break;
+            if (result.firstOutputMs < 0)
+                result.firstOutputMs = double(now() - started) / 1e6;
+        }
+        ::close(output[0]);
+        while (::waitpid(pid, &result.status, 0) < 0 && errno == EINTR)
+            ;
+        result.exitMs = double(now() - started) / 1e6;
+        result.pid = long(pid);
+        return result;
+#endif
+    }
+
+    // One run with the loader reporting on itself; its output goes to workDir/loader.<pid>
+    static Loader loader(const std::filesystem::path &executable, const std::vector<std::string> &args,
+                         std::vector<std::string> environment, const std::filesystem::path &workDir)
+    {
+        for (const auto &entry : std::filesystem::directory_iterator(workDir))
+            if (entry.path().filename().string().rfind("loader.", 0) == 0)
+                std::filesystem::remove(entry.path());
+        environment.push_back("LD_DEBUG=statistics,bindings");
+        environment.push_back("LD_DEBUG_OUTPUT=" + (workDir / "loader").string());
+        Run traced = run(executable, args, environment);
+        std::ifstream in(workDir / ("loader." + std::to_string(traced.pid)));
+        return parseLoader(in);
+    }
+
+    static Loader parseLoader(std::istream &in)
+    {
+        Loader result;
+        bool started = false; // Control has reached the program
+        bool statistics = false;
+        for (std::string line; std::getline(in, line);)
+        {
+            // <pid>:\t<message>
+            auto tab = line.find('\t');
+            std::string message = tab == std::string::npos ? line : line.substr(tab + 1);
+            message.erase(0, message.find_first_not_of(' '));
+            if (message.rfind("binding file ", 0) == 0)
+            {
+                if (started)
+                {
+                    result.lazyLookups++;
+                    continue;
+                }
+                result.lookups++;
+                // binding file <from> [n] to <into> [n]: normal symbol `name'
+                auto to = message.find(" to ");
+                auto end = to == std::string::npos ? to : message.find(" [", to);
+                if (end != std::string::npos)
+                    result.lookupsInto[message.substr(to + 4, end - to - 4)]++;
+            }
+            else if (message.rfind("transferring control:", 0) == 0)
+            {
+                started = true;
+            }
+            else if (message.rfind("runtime linker statistics:", 0) == 0)
+            {
+                // The second block, at exit, only has the final counts
+                statistics = !result.dynamic;
+                result.dynamic = true;
+            }
+            else if (statistics)
+            {
+                statistic(message, "total startup time in dynamic loader:", result.startupCycles);
+                statistic(message, "time needed for relocation:", result.relocationCycles);
+                statistic(message, "time needed to load objects:", result.loadCycles);
+                double count = -1;
+                if (statistic(message, "number of relocations:", count))
+                    result.relocations = (unsigned long)count;
+                if (statistic(message, "number of relative relocations:", count))
+                    result.relativeRelocations = (unsigned long)count;
+            }
+        }
+        return result;
+    }
+
+    // The loader counts in time stamp counter cycles; 0 where there is no counter to calibrate
+    static double cyclesPerMs()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        auto start = std::chrono::steady_clock::now();
+        uint64_t first = __rdtsc();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        uint64_t last = __rdtsc();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return ms > 0 ? double(last - first) / ms : 0;
+#else
+        return 0;
+#endif
+    }
+
+    // Flags for the instrumented variant; the hooks object has to be compiled from hooksSource() first
+    static std::string compileFlags(bool gcc)
+    {
+        // Inline library code is left alone, the initializers calling it are what gets timed
+        return std::string("-g -finstrument-functions") + (gcc ? " -finstrument-functions-exclude-file-list=/usr/include" : "");
+    }
+
+    static std::string linkFlags(const std::filesystem::path &hooksObject)
+    {
+        // Exported, for instrumented shared libraries of the project to find
+        return "-rdynamic " + hooksObject.string();
+    }
+
+    static std::string hooksSource()
+    {
+        return R"(// Generated by Tegen for 'tegen run --startup'; linked into an instrumented build.
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+extern "C" char __executable_start;
+
+namespace
+{
+struct Call
+{
+    long long function;
+    long long site;
+    long long enter;
+    long long exit;
+};
+
+const unsigned capacity = 1 << 14;
+Call calls[capacity];
+unsigned count = 0;
+int depth = 0;
+long long started = 0;
+bool done = false;
+// Read by begin() rather than through a function-local static, whose guard would need libstdc++
+// in links CMake's C compiler checks do with the C driver
+const char *mainAt = nullptr;
+
+__attribute__((no_instrument_function)) long long now()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000000000LL + time.tv_nsec;
+}
+
+__attribute__((no_instrument_function)) long long offset(void *address)
+{
+    return (long long)((char *)address - &__executable_start);
+}
+
+__attribute__((no_instrument_function, constructor(101))) void begin()
+{
+    mainAt = getenv("TEGEN_STARTUP_MAIN");
+    started = now();
+}
+
+__attribute__((no_instrument_function)) void report(long long reached)
+{
+    const char *path = getenv("TEGEN_STARTUP_OUT");
+    FILE *out = path ? fopen(path, "w") : nullptr;
+    if (!out)
+        return;
+    fprintf(out, "init %lld\nmain %lld\n", started, reached);
+    for (unsigned i = 0; i < count; i++)
+        fprintf(out, "call %lld %lld %lld %lld\n", calls[i].function, calls[i].site, calls[i].enter, calls[i].exit);
+    fclose(out);
+}
+}
+
+extern "C" __attribute__((no_instrument_function)) void __cyg_profile_func_enter(void *function, void *site)
+{
+    // Shared libraries run their constructors before the executable's
+    if (done || !started)
+        return;
+    if (depth == 0 && mainAt && offset(function) == atoll(mainAt))
+    {
+        done = true;
+        report(now());
+        return;
+    }
+    if (depth++ == 0 && count < capacity)
+        calls[count] = {offset(function), offset(site), now(), 0};
+}
+
+extern "C" __attribute__((no_instrument_function)) void __cyg_profile_func_exit(void *, void *)
+{
+    if (done || !started)
+        return;
+    if (--depth == 0 && count < capacity)
+        calls[count++].exit = now();
+}
+)";
+    }
+
+    // Offset of main from the start of the image, which the hooks compare against
+    static long long mainOffset(const std::filesystem::path &executable)
+    {
+        auto symbols = imageSymbols(executable);
+        if (!symbols.count("main"))
+            throw std::runtime_error(executable.string() + " has no symbol table entry for main");
+        return (long long)(symbols["main"] - symbols["__executable_start"]);
+    }
+
+    // One run of the instrumented variant; mainOffset as given by mainOffset()
+    static Instrumented instrumented(const std::filesystem::path &executable, const std::vector<std::string> &args,
+                                     std::vector<std::string> environment, long long mainOffset, const std::filesystem::path &workDir)
+    {
+        auto out = workDir / "startup-calls.txt";
+        std::filesystem::remove(out);
+        environment.push_back("TEGEN_STARTUP_OUT=" + out.string());
+        environment.push_back("TEGEN_STARTUP_MAIN=" + std::to_string(mainOffset));
+        int64_t started = now();
+        run(executable, args, environment);
+
+        Instrumented result;
+        std::ifstream in(out);
+        struct Call
+        {
+            long long function, site, enter, exit;
+        };
+        std::vector<Call> calls;
+        for (std::string line; std::getline(in, line);)
+        {
+            std::istringstream fields(line);
+            std::string kind;
+            fields >> kind;
+            long long value = 0;
+            if (kind == "init" && fields >> value)
+                result.initMs = double(value - started) / 1e6;
+            else if (kind == "main" && fields >> value)
+                result.mainMs = double(value - started) / 1e6;
+            Call call{};
+            if (kind == "call" && fields >> call.function >> call.site >> call.enter >> call.exit && call.exit >= call.enter)
+                calls.push_back(call);
+        }
+        if (result.mainMs < 0)
+            throw std::runtime_error("The instrumented build of " + executable.filename().string() + " never reached main");
+
+        // A call is charged to the file it was made from (the initializer of a translation unit), or to
+        // the file of the function itself when the caller is outside the executable
+        std::set<long long> offsets;
+        for (const auto &call : calls)
+        {
+            offsets.insert(call.function);
+            if (call.site >= 0)
+                offsets.insert(call.site);
+        }
+        auto locations = symbolize(executable, offsets);
+        std::map<std::string, Initializer> bySource;
+        std::map<std::string, double> slowest;
+        for (const auto &call : calls)
+        {
+            const Location *where = nullptr;
+            auto site = locations.find(call.site);
+            if (call.site >= 0 && site != locations.end() && !site->second.file.empty())
+                where = &site->second;
+            auto function = locations.find(call.function);
+            if (!where && function != locations.end() && !function->second.file.empty())
+                where = &function->second;
+            std::string source = where ? where->file : "(unknown)";
+            double ms = double(call.exit - call.enter) / 1e6;
+            auto &entry = bySource[source];
+            entry.source = source;
+            entry.ms += ms;
+            if (ms > slowest[source] && function != locations.end())
+            {
+                slowest[source] = ms;
+                entry.function = function->second.function;
+            }
+        }
+        for (auto &[source, entry] : bySource)
+            result.initializers.push_back(entry);
+        std::sort(result.initializers.begin(), result.initializers.end(), [](const Initializer &a, const Initializer &b)
+                  { return a.ms > b.ms; });
+        return result;
+    }
+
+    // Medians of several instrumented runs, with each file's initializer time averaged
+    static Instrumented combine(const std::vector<Instrumented> &runs)
+    {
+        Instrumented result;
+        if (runs.empty())
+            return result;
+        std::vector<double> inits, mains;
+        std::map<std::string, Initializer> bySource;
+        for (const auto &run : runs)
+        {
+            inits.push_back(run.initMs);
+            mains.push_back(run.mainMs);
+            for (const auto &initializer : run.initializers)
+            {
+                auto &entry = bySource[initializer.source];
+                entry.source = initializer.source;
+                entry.function = entry.function.empty() ? initializer.function : entry.function;
+                entry.ms += initializer.ms / double(runs.size());
+            }
+        }
+        result.initMs = median(inits);
+        result.mainMs = median(mains);
+        for (auto &[source, entry] : bySource)
+            result.initializers.push_back(entry);
+        std::sort(result.initializers.begin(), result.initializers.end(), [](const Initializer &a, const Initializer &b)
+                  { return a.ms > b.ms; });
+        return result;
+    }
+
+    // Changes worth trying, given the phases. projectLibraries are the shared libraries the project
+    // builds; sources are shown relative to projectDir.
+    static std::vector<std::string> advice(const Loader &loader, double loaderMs, const Instrumented &startup,
+                                           const std::vector<std::filesystem::path> &projectLibraries,
+                                           const std::filesystem::path &projectDir)
+    {
+        std::vector<std::string> result;
+        std::ostringstream line;
+        line.setf(std::ios::fixed);
+        line.precision(2);
+        auto take = [&]
+        {
+            result.push_back(line.str());
+            line.str("");
+        };
+
+        // Loading and relocating every library on each start is what a static PIE does not do
+        bool slowLoader = loaderMs > 0 ? loaderMs >= 2 || loaderMs >= 0.2 * startup.mainMs : loader.lookups >= 5000;
+        if (loader.dynamic && slowLoader)
+        {
+            line << "Link with -static-pie (every linked library needs a static archive): the dynamic loader ";
+            if (loaderMs > 0)
+                line << "takes " << loaderMs << " ms of the " << startup.mainMs << " ms to main, ";
+            line << "applying " << loader.relocations << " relocations and " << loader.lookups << " symbol lookups across "
+                 << loader.lookupsInto.size() << " objects.";
+            take();
+        }
+
+        for (const auto &library : projectLibraries)
+        {
+            unsigned long lookups = 0;
+            for (const auto &[object, count] : loader.lookupsInto)
+                if (std::filesystem::path(object).filename() == library.filename())
+                    lookups += count;
+            if (lookups < 100)
+                continue;
+            line << "Build " << library.filename().string()
+                 << " with -fvisibility=hidden -fvisibility-inlines-hidden (CXX_VISIBILITY_PRESET hidden) and export only its API: "
+                 << lookups << " of the " << loader.lookups << " symbol lookups at startup resolve into it.";
+            take();
+        }
+
+        for (const auto &initializer : startup.initializers)
+        {
+            if (initializer.source == "(unknown)" || initializer.ms < std::max(0.5, 0.1 * startup.mainMs))
+                continue;
+            line << "Construct the globals of " << relative(initializer.source, projectDir)
+                 << " on first use (function-local statics) or make them constexpr: they take " << initializer.ms << " ms before main.";
+            take();
+        }
+        return result;
+    }
+
+    static std::string relative(const std::string &source, const std::filesystem::path &projectDir)
+    {
+        auto path = std::filesystem::path(source).lexically_relative(projectDir);
+        return path.empty() || path.string().rfind("..", 0) == 0 ? source : path.string();
+    }
+
+    static double median(std::vector<double> values)
+    {
+        if (values.empty())
+            return 0;
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    }
+
+private:
+    struct Location
+    {
+        std::string function;
+        std::string file; // Of the outermost inlined frame, i.e. the function the address is really in
+    };
+
+    static int64_t now()
+    {
+#ifdef _WIN32
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+        // The clock the hooks read
+        timespec time;
+        ::clock_gettime(CLOCK_MONOTONIC, &time);
+        return int64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+#endif
+    }
+
+    static bool statistic(const std::string &message, const std::string &key, double &value)
+    {
+        if (message.rfind(key, 0) != 0)
+            return false;
+        value = std::strtod(message.c_str() + key.size(), nullptr);
+        return true;
+    }
+
+    static std::map<std::string, uint64_t> imageSymbols(const std::filesystem::path &executable)
+    {
+        std::map<std::string, uint64_t> symbols;
+        std::istringstream lines(TestRunner::capture("nm --defined-only \"" + executable.string() + "\" 2>/dev/null"));
+        for (std::string line; std::getline(lines, line);)
+        {
+            std::istringstream fields(line);
+            std::string address, type, name;
+            if (fields >> address >> type >> name && (name == "main" || name == "__executable_start"))
+                symbols[name] = std::stoull(address, nullptr, 16);
+        }
+        return symbols;
+    }
+
+    // Function and source file of image offsets, in one addr2line run
+    static std::map<long long, Location> symbolize(const std::filesystem::path &executable, const std::set<long long> &offsets)
+    {
+        std::map<long long, Location> result;
+        if (offsets.empty())
+            return result;
+        uint64_t base = imageSymbols(executable)["__executable_start"];
+        std::ostringstream command;
+        command << "addr2line -a -i -f -C -e \"" << executable.string() << "\"" << std::hex;
+        for (long long offset : offsets)
+            command << " 0x" << base + uint64_t(offset);
+        command << " 2>/dev/null";
+
+        // 0x<address>, then a function and file:line pair per inlined frame, innermost first
+        std::istringstream lines(TestRunner::capture(command.str()));
+        Location *current = nullptr;
+        bool named = false;
+        for (std::string line; std::getline(lines, line);)
+        {
+            if (line.rfind("0x", 0) == 0)
+            {
+                current = &result[(long long)(std::stoull(line, nullptr, 16) - base)];
+                named = false;
+                continue;
+            }
+            if (!current)
+                continue;
+            std::string function = line;
+            if (!std::getline(lines, line))
+                break;
+            if (!named)
+                current->function = function;
+            named = true;
+            auto colon = line.rfind(':');
+            std::string file = line.substr(0, colon);
+            current->file = file == "??" || file.empty() ? "" : file;
+        }
+        return result;
+    }
+};
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef TEST_IMPACT_HPP
+#define TEST_IMPACT_HPP
+
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "gcov_reader.hpp"
+#include "test_runner.hpp"
+
+// Maps each test to the project files (sources and headers, including installed
+// dependency headers) that its code actually executed, and uses that mapping to
+// select the tests affected by a change.
+//
+// Recording runs every test from a --coverage build with its own GCOV_PREFIX, then
+// reads the per-test .gcda files back through GcovReader. A mapping
+// is considered stale, and every test runs, when:
+//   - it was recorded on a commit that is not an ancestor of HEAD
+//   - build files or prebuilt libraries changed
+//   - a changed file never showed up in any recorded profile (for example a new
+//     file, a header with no executable code, or data a test reads)
+class TestImpact
+{
+public:
+    struct Selection
+    {
+        bool runAll = false;
+        std::string reason;
+        std::set<std::string> tests;
+        std::vector<std::string> changed;
+    };
+
+    TestImpact(std::filesystem::path projectDir, std::filesystem::path stateDir)
+        : projectDir(std::move(projectDir)), mappingFile(std::move(stateDir) / "impact.json")
+    {
+    }
+
+    bool exists() const
+    {
+        return std::filesystem::exists(mappingFile);
+    }
+
+    // Project files whose code ran, from the .gcda files one test wrote under prefixDir
+    std::set<std::string> coveredFiles(const std::filesystem::path &prefixDir, std::set<std::string> &known) const
+    {
+        std::set<std::string> covered;
+        for (const auto &report : GcovReader::reports(prefixDir))
+        {
+            std::filesystem::path cwd = report.value("current_working_directory", "");
+            for (const auto &file : report.value("files", json::array()))
+            {
+                std::filesystem::path path = file.value("file", "");
+                if (path.is_relative())
+                    path = cwd / path;
+                auto relative = projectRelative(path);
+                if (relative.empty())
+                    continue;
+                known.insert(relative);
+                for (const auto &line : file.value("lines", json::array()))
+                {
+                    if (line.value("count", 0) > 0)
+                    {
+                        covered.insert(relative);
+                        break;
+                    }
+                }
+            }
+        }
+        return covered;
+    }
+
+    void save(const std::map<std::string, std::set<std::string>> &tests, const std::set<std::string> &known) const
+    {
+        json mapping;
+        mapping["commit"] = trim(TestRunner::capture(git() + "rev-parse HEAD" + quiet(false)));
+        mapping["known"] = known;
+        mapping["tests"] = json::object();
+        for (const auto &[id, files] : tests)
+            mapping["tests"][id] = files;
+        std::filesystem::create_directories(mappingFile.parent_path());
+        std::ofstream(mappingFile) << mapping.dump(2);
+    }
+
+    // Decide which of testIds must run for the changes since base (default: the recorded commit)
+    Selection select(const std::vector<std::string> &testIds, std::string base = "") const
+    {
+        Selection selection;
+        std::ifstream in(mappingFile);
+        json mapping = in ? json::parse(in, nullptr, false) : json();
+        if (mapping.is_discarded() || !mapping.is_object())
+            return all(selection, "no impact mapping recorded (run 'tegen test --record-impact')");
+
+        std::string commit = mapping.value("commit", "");
+        if (commit.empty())
+            return all(selection, "impact mapping was recorded outside a git repository");
+        if (std::system((git() + "merge-base --is-ancestor " + commit + " HEAD" + quiet()).c_str()) != 0)
+            return all(selection, "impact mapping was recorded on a commit that is not an ancestor of HEAD");
+        if (base.empty())
+            base = commit;
+
+        // --relative and ls-files both give paths from the project directory, which is what the
+        // mapping records, even when the project is a subdirectory of the repository
+        std::set<std::string> changed;
+        for (const auto &command : {git() + "diff --relative --name-only " + base + quiet(false), git() + "ls-files --others --exclude-standard" + quiet(false)})
+        {
+            std::istringstream lines(TestRunner::capture(command));
+            for (std::string line; std::getline(lines, line);)
+                if (!line.empty() && line.rfind("build/", 0) != 0)
+                    changed.insert(line);
+        }
+        selection.changed.assign(changed.begin(), changed.end());
+
+        std::set<std::string> known = mapping.value("known", std::set<std::string>());
+        for (const auto &file : changed)
+        {
+            std::filesystem::path path(file);
+            std::string name = path.filename().string();
+            std::string extension = path.extension().string();
+            if (name == "CMakeLists.txt" || name == "TegenConfig.json" || extension == ".cmake" ||
+                extension == ".a" || extension == ".lib" || extension == ".so")
+                return all(selection, file + " changed the build");
+            // Data files and anything else the tests may read never show up in a profile
+            if (!known.count(file))
+                return all(selection, file + " is not covered by the recorded mapping");
+        }
+
+        const json &tests = mapping["tests"];
+        for (const auto &id : testIds)
+        {
+            // Tests added since recording have no mapping, so they always run
+            if (!tests.contains(id))
+            {
+                selection.tests.insert(id);
+                continue;
+            }
+            for (const auto &file : tests[id])
+            {
+                if (changed.count(file.get<std::string>()))
+                {
+                    selection.tests.insert(id);
+                    break;
+                }
+            }
+        }
+        return selection;
+    }
+
+private:
+    using json = nlohmann::json;
+
+    std::filesystem::path projectDir;
+    std::filesystem::path mappingFile;
+
+    static Selection &all(Selection &selection, const std::string &reason)
+    {
+        selection.runAll = true;
+        selection.reason = reason;
+        return selection;
+    }
+
+    // Git run in the project directory
+    std::string git() const
+    {
+        return "git -C " + TestRunner::shellQuote(projectDir.string()) + " ";
+    }
+
+    static std::string quiet(bool silenceStdout = true)
+    {
+#ifdef _WIN32
+        return silenceStdout ? " >NUL 2>NUL" : " 2>NUL";
+#else
+        return silenceStdout ? " >/dev/null 2>&1" : " 2>/dev/null";
+#endif
+    }
+
+    static std::string trim(std::string value)
+    {
+        while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back())))
+            value.pop_back();
+        return value;
+    }
+
+    // Path relative to the project root with '/' separators, or empty when outside it
+    std::string projectRelative(const std::filesystem::path &path) const
+    {
+        auto relative = std::filesystem::path(path).lexically_normal().lexically_relative(projectDir);
+        if (relative.empty() || *relative.begin() == "..")
+            return "";
+        // The recording build lives under build/; its generated files are not project inputs
+        if (*relative.begin() == "build")
+            return "";
+        return relative.generic_string();
+    }
+};
+
+#endif
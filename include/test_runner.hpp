@@ -0,0 +1,515 @@
+#ifndef TEST_RUNNER_HPP
+#define TEST_RUNNER_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "json.hpp"
+#include "async_io.hpp"
+#include "child_process.hpp"
+#include "cmake_file_api.hpp"
+#include "logger.hpp"
+#include "sha256.hpp"
+
+#ifdef _WIN32
+#define TEGEN_POPEN _popen
+#define TEGEN_PCLOSE _pclose
+#else
+#define TEGEN_POPEN popen
+#define TEGEN_PCLOSE pclose
+#endif
+
+// Discovers and runs a project's tests in parallel.
+//
+// Tests come from CTest (ctest --show-only=json-v1) and from GoogleTest or doctest
+// executables that CTest does not already run; those are split into one test per
+// case. Tests are scheduled longest-first from recorded durations, can be sharded
+// across processes or machines by a stable hash of their id, and a passing result
+// is cached under a key made of the test binary's content hash, the shared libraries
+// of the build tree it loads, its command line, environment and input files, so
+// unchanged tests are skipped.
+class TestRunner
+{
+public:
+    struct Test
+    {
+        std::string id;
+        std::vector<std::string> command;
+        std::vector<std::string> environment; // KEY=VALUE
+        std::filesystem::path workingDir;
+        std::filesystem::path binary;
+        std::vector<std::filesystem::path> inputs;
+        double timeoutSeconds = 0;
+    };
+
+    struct Options
+    {
+        unsigned jobs = 0; // 0 picks from hardware_concurrency
+        unsigned shardIndex = 0;
+        unsigned shardCount = 1;
+        bool useCache = true;
+        std::string filter; // Substring of the test id
+        std::set<std::string> only; // Exact test ids to keep; empty keeps every test
+    };
+
+    struct Summary
+    {
+        size_t passed = 0;
+        size_t cached = 0;
+        size_t failed = 0;
+        std::vector<std::string> failures;
+    };
+
+    explicit TestRunner(std::filesystem::path buildDir)
+        : buildDir(std::move(buildDir)), stateDir(this->buildDir / ".tegen")
+    {
+    }
+
+    std::vector<Test> discover()
+    {
+        std::vector<Test> tests = discoverCTest();
+        std::set<std::filesystem::path> covered;
+        for (const auto &test : tests)
+            covered.insert(test.binary);
+
+        // Framework binaries that CTest does not know about get split per test case
+        CMakeFileApi api(buildDir);
+        if (api.hasReply())
+        {
+            for (const auto &executable : api.executables())
+            {
+                const auto &binary = executable.artifacts.front();
+                if (covered.count(binary) || !std::filesystem::exists(binary))
+                    continue;
+                std::string framework = detectFramework(binary);
+                if (framework == "gtest")
+                    discoverGTest(executable.name, binary, tests);
+                else if (framework == "doctest")
+                    discoverDoctest(executable.name, binary, tests);
+            }
+        }
+        return tests;
+    }
+
+    // Stable across machines and runs, so every shard agrees on the split
+    static bool inShard(const std::string &id, unsigned index, unsigned count)
+    {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (unsigned char c : id)
+        {
+            hash ^= c;
+            hash *= 0x100000001b3ULL;
+        }
+        return count <= 1 || hash % count == index;
+    }
+
+    Summary run(std::vector<Test> tests, const Options &options)
+    {
+        Summary summary;
+        tests.erase(std::remove_if(tests.begin(), tests.end(), [&](const Test &test)
+                                   { return !inShard(test.id, options.shardIndex, options.shardCount) ||
+                                            test.id.find(options.filter) == std::string::npos ||
+                                            (!options.only.empty() && !options.only.count(test.id)); }),
+                    tests.end());
+
+        json history = loadHistory();
+        std::filesystem::create_directories(stateDir / "logs");
+
+        auto keys = cacheKeys(tests);
+        std::vector<size_t> queue;
+        for (size_t i = 0; i < tests.size(); i++)
+        {
+            const auto &entry = history.value(tests[i].id, json::object());
+            if (options.useCache && !keys[i].empty() && entry.value("passKey", "") == keys[i])
+            {
+                summary.cached++;
+                summary.passed++;
+                continue;
+            }
+            queue.push_back(i);
+        }
+
+        // Longest first; tests never timed before go first since they may be the long ones
+        auto recorded = [&](size_t i)
+        {
+            return history.value(tests[i].id, json::object()).value("durationMs", 1e18);
+        };
+        std::stable_sort(queue.begin(), queue.end(), [&](size_t a, size_t b)
+                         { return recorded(a) > recorded(b); });
+
+        unsigned jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+        {
+            auto line = Log::info();
+            line << "Running " << queue.size() << " test(s) on " << jobs << " worker(s)";
+            if (summary.cached)
+                line << ", " << summary.cached << " unchanged test(s) cached";
+            line << "...";
+        }
+
+        struct Running
+        {
+            size_t index;
+            std::unique_ptr<ChildProcess> process;
+        };
+        std::vector<Running> running;
+        size_t next = 0, finished = 0;
+
+        while (next < queue.size() || !running.empty())
+        {
+            while (running.size() < jobs && next < queue.size())
+            {
+                size_t index = queue[next++];
+                auto process = std::make_unique<ChildProcess>();
+                process->start(shellCommand(tests[index]));
+                running.push_back({index, std::move(process)});
+            }
+
+            bool progressed = false;
+            for (auto it = running.begin(); it != running.end();)
+            {
+                const Test &test = tests[it->index];
+                auto &process = *it->process;
+                bool timedOut = test.timeoutSeconds > 0 && !process.poll() && elapsedSeconds(process) > test.timeoutSeconds;
+                if (timedOut)
+                    process.cancel();
+                if (!process.poll())
+                {
+                    ++it;
+                    continue;
+                }
+
+                progressed = true;
+                finished++;
+                double ms = std::chrono::duration<double, std::milli>(process.duration()).count();
+                bool passed = process.result() == 0 && !timedOut;
+                json &entry = history[test.id];
+                entry["durationMs"] = ms;
+                if (passed && !keys[it->index].empty())
+                    entry["passKey"] = keys[it->index];
+                else
+                    entry.erase("passKey");
+
+                Log::info() << "[" << std::setw(int(std::to_string(queue.size()).size())) << finished << "/" << queue.size() << "] "
+                            << (passed ? "PASS  " : (timedOut ? "TIME  " : "FAIL  ")) << test.id
+                            << " (" << std::fixed << std::setprecision(0) << ms << " ms)";
+                if (passed)
+                {
+                    summary.passed++;
+                }
+                else
+                {
+                    summary.failed++;
+                    summary.failures.push_back(test.id);
+                }
+                it = running.erase(it);
+            }
+            if (!progressed)
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        saveHistory(history);
+        return summary;
+    }
+
+    std::filesystem::path logPath(const std::string &id) const
+    {
+        std::string name;
+        for (char c : id)
+            name += (std::isalnum(static_cast<unsigned char>(c)) || c == '.' || c == '-' || c == '_') ? c : '_';
+        return stateDir / "logs" / (name + ".log");
+    }
+
+    static std::string shellQuote(const std::string &arg)
+    {
+#ifdef _WIN32
+        std::string quoted = "\"";
+        for (char c : arg)
+            quoted += (c == '"') ? std::string("\\\"") : std::string(1, c);
+        return quoted + "\"";
+#else
+        std::string quoted = "'";
+        for (char c : arg)
+            quoted += (c == '\'') ? std::string("'\\''") : std::string(1, c);
+        return quoted + "'";
+#endif
+    }
+
+    // Run a command and capture its standard output
+    static std::string capture(const std::string &command)
+    {
+        std::string output;
+        FILE *pipe = TEGEN_POPEN(command.c_str(), "r");
+        if (!pipe)
+            return output;
+        char buffer[4096];
+        size_t bytes;
+        while ((bytes = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+            output.append(buffer, bytes);
+        TEGEN_PCLOSE(pipe);
+        return output;
+    }
+
+private:
+    using json = nlohmann::json;
+
+    std::filesystem::path buildDir;
+    std::filesystem::path stateDir;
+
+    static double elapsedSeconds(const ChildProcess &process)
+    {
+        return std::chrono::duration<double>(process.runningFor()).count();
+    }
+
+    std::vector<Test> discoverCTest()
+    {
+        std::vector<Test> tests;
+        std::string output = capture("ctest --test-dir " + shellQuote(buildDir.string()) + " --show-only=json-v1 2>" +
+#ifdef _WIN32
+                                     "NUL"
+#else
+                                     "/dev/null"
+#endif
+        );
+        json info = json::parse(output, nullptr, false);
+        if (info.is_discarded() || !info.contains("tests"))
+            return tests;
+
+        for (const auto &entry : info["tests"])
+        {
+            if (!entry.contains("command") || entry["command"].empty())
+                continue;
+            Test test;
+            test.id = entry.value("name", "");
+            test.command = entry["command"].get<std::vector<std::string>>();
+            test.binary = test.command.front();
+            test.workingDir = buildDir;
+            for (const auto &property : entry.value("properties", json::array()))
+            {
+                std::string name = property.value("name", "");
+                const json &value = property["value"];
+                if (name == "WORKING_DIRECTORY")
+                    test.workingDir = value.get<std::string>();
+                else if (name == "ENVIRONMENT")
+                    test.environment = value.get<std::vector<std::string>>();
+                else if (name == "TIMEOUT")
+                    test.timeoutSeconds = value.get<double>();
+                else if (name == "REQUIRED_FILES")
+                    for (const auto &file : value)
+                        test.inputs.push_back(file.get<std::string>());
+            }
+            // Files named on the command line are inputs too
+            for (size_t i = 1; i < test.command.size(); i++)
+            {
+                std::error_code ec;
+                std::filesystem::path arg = test.command[i];
+                if (arg.is_absolute() && std::filesystem::is_regular_file(arg, ec))
+                    test.inputs.push_back(arg);
+            }
+            tests.push_back(std::move(test));
+        }
+        return tests;
+    }
+
+    static std::string detectFramework(const std::filesystem::path &binary)
+    {
+        std::ifstream in(binary, std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (contents.find("gtest_list_tests") != std::string::npos)
+            return "gtest";
+        if (contents.find("list-test-cases") != std::string::npos)
+            return "doctest";
+        return "";
+    }
+
+    void discoverGTest(const std::string &target, const std::filesystem::path &binary, std::vector<Test> &tests)
+    {
+        std::istringstream listing(capture(shellQuote(binary.string()) + " --gtest_list_tests"));
+        std::string line, suite;
+        while (std::getline(listing, line))
+        {
+            auto comment = line.find('#');
+            if (comment != std::string::npos)
+                line.erase(comment);
+            while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back())))
+                line.pop_back();
+            if (line.empty())
+                continue;
+            if (line[0] != ' ')
+            {
+                suite = line;
+                continue;
+            }
+            std::string name = suite + line.substr(line.find_first_not_of(' '));
+            Test test;
+            test.id = target + ":" + name;
+            test.binary = binary;
+            test.workingDir = buildDir;
+            test.command = {binary.string(), "--gtest_filter=" + name};
+            tests.push_back(std::move(test));
+        }
+    }
+
+    void discoverDoctest(const std::string &target, const std::filesystem::path &binary, std::vector<Test> &tests)
+    {
+        std::istringstream listing(capture(shellQuote(binary.string()) + " --list-test-cases --no-colors"));
+        std::string line;
+        bool inList = false;
+        while (std::getline(listing, line))
+        {
+            if (line.rfind("=====", 0) == 0)
+            {
+                inList = !inList;
+                continue;
+            }
+            if (!inList || line.empty() || line.rfind("[doctest]", 0) == 0)
+                continue;
+
+            // doctest filters treat ',' as a separator and support wildcards; escape the separator
+            std::string filter;
+            for (char c : line)
+                filter += (c == ',') ? std::string("\\,") : std::string(1, c);
+            Test test;
+            test.id = target + ":" + line;
+            test.binary = binary;
+            test.workingDir = buildDir;
+            test.command = {binary.string(), "--test-case=" + filter};
+            tests.push_back(std::move(test));
+        }
+    }
+
+    std::string shellCommand(const Test &test) const
+    {
+        std::string command;
+#ifdef _WIN32
+        command = "cd /d " + shellQuote(test.workingDir.string()) + " && ";
+        for (const auto &variable : test.environment)
+            command += "set " + shellQuote(variable) + " && ";
+#else
+        command = "cd " + shellQuote(test.workingDir.string()) + " && ";
+        if (!test.environment.empty())
+        {
+            command += "env";
+            for (const auto &variable : test.environment)
+                command += " " + shellQuote(variable);
+            command += " ";
+        }
+#endif
+        for (size_t i = 0; i < test.command.size(); i++)
+            command += (i ? " " : "") + shellQuote(test.command[i]);
+        return command + " > " + shellQuote(logPath(test.id).string()) + " 2>&1";
+    }
+
+    // Shared libraries of the build tree that binary loads: a test whose library changed runs different code.
+    // Without ldd every shared library the project builds counts.
+    std::vector<std::filesystem::path> projectLibraries(const std::filesystem::path &binary) const
+    {
+        std::vector<std::filesystem::path> libraries;
+        std::error_code ec;
+#ifdef __linux__
+        auto root = std::filesystem::weakly_canonical(buildDir, ec);
+        // <name> => <path> (<address>)
+        std::istringstream lines(capture("ldd " + shellQuote(binary.string()) + " 2>/dev/null"));
+        for (std::string line; std::getline(lines, line);)
+        {
+            auto arrow = line.find("=> ");
+            auto address = line.rfind(" (");
+            if (arrow == std::string::npos || address == std::string::npos || address <= arrow + 3)
+                continue;
+            auto library = std::filesystem::weakly_canonical(line.substr(arrow + 3, address - arrow - 3), ec);
+            auto relative = library.lexically_relative(root);
+            if (!relative.empty() && relative.begin()->string() != "..")
+                libraries.push_back(library);
+        }
+#else
+        (void)binary;
+        for (const auto &target : CMakeFileApi(buildDir).targets())
+            if (target.type == "SHARED_LIBRARY" || target.type == "MODULE_LIBRARY")
+                libraries.insert(libraries.end(), target.artifacts.begin(), target.artifacts.end());
+#endif
+        return libraries;
+    }
+
+    // Content key per test; empty when an input cannot be hashed (such tests are never cached)
+    std::vector<std::string> cacheKeys(const std::vector<Test> &tests)
+    {
+        std::set<std::filesystem::path> unique;
+        std::map<std::filesystem::path, std::vector<std::filesystem::path>> libraries; // Per binary
+        for (const auto &test : tests)
+        {
+            unique.insert(test.binary);
+            unique.insert(test.inputs.begin(), test.inputs.end());
+            if (!libraries.count(test.binary))
+            {
+                libraries[test.binary] = projectLibraries(test.binary);
+                unique.insert(libraries[test.binary].begin(), libraries[test.binary].end());
+            }
+        }
+        std::vector<std::filesystem::path> files;
+        std::error_code ec;
+        for (const auto &file : unique)
+        {
+            if (std::filesystem::is_regular_file(file, ec))
+                files.push_back(file);
+        }
+
+        std::map<std::filesystem::path, std::string> digests;
+        AsyncFileIo io;
+        auto hashes = io.hash(files);
+        for (size_t i = 0; i < files.size(); i++)
+            digests[files[i]] = hashes[i];
+
+        std::vector<std::string> keys;
+        for (const auto &test : tests)
+        {
+            Sha256 key;
+            bool complete = digests.count(test.binary) > 0;
+            key.update(complete ? digests[test.binary] : "");
+            for (const auto &part : test.command)
+                key.update("\n" + part);
+            for (const auto &variable : test.environment)
+                key.update("\nenv:" + variable);
+            key.update("\ncwd:" + test.workingDir.string());
+            for (const auto &library : libraries[test.binary])
+            {
+                complete = complete && digests.count(library) > 0;
+                key.update("\nlibrary:" + library.string() + "=" + (digests.count(library) ? digests[library] : ""));
+            }
+            for (const auto &input : test.inputs)
+            {
+                complete = complete && digests.count(input) > 0;
+                key.update("\ninput:" + input.string() + "=" + (digests.count(input) ? digests[input] : ""));
+            }
+            keys.push_back(complete ? key.hexDigest() : "");
+        }
+        return keys;
+    }
+
+    json loadHistory() const
+    {
+        std::ifstream in(stateDir / "tests.json");
+        if (!in)
+            return json::object();
+        json history = json::parse(in, nullptr, false);
+        return history.is_object() ? history : json::object();
+    }
+
+    void saveHistory(const json &history) const
+    {
+        std::filesystem::create_directories(stateDir);
+        std::ofstream(stateDir / "tests.json") << history.dump(2);
+    }
+};
+
+#endif
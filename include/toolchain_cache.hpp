@@ -0,0 +1,228 @@
+#ifndef TOOLCHAIN_CACHE_HPP
+#define TOOLCHAIN_CACHE_HPP
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include "json.hpp"
+#include "sha256.hpp"
+#include "test_runner.hpp"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// What a compiler is: version banner, target triple, sysroot, a hash of its predefined
+// macros and the C++ standard library it links, which together decide whether artifacts
+// built with it can be reused. Probing takes several compiler runs, so results are cached
+// in toolchains.json in the global store, keyed by the compiler binary's resolved path. An
+// entry holds while the inode, size and modification time of the binary and of its standard
+// library are unchanged; replacing or upgrading either probes the compiler again.
+class ToolchainCache
+{
+public:
+    struct Info
+    {
+        std::string path; // Resolved compiler binary ("" when not found)
+        std::string version;
+        std::string major; // -dumpversion
+        std::string target;
+        std::string sysroot;
+        std::string macros; // SHA-256 of the predefined macros (-dM -E)
+        std::string stdlib; // Shared C++ standard library it links (-print-file-name), "" when unknown
+        nlohmann::json stdlibStamp;
+        bool clang = false;
+        bool cached = false; // Taken from the cache rather than probed now
+
+        // Everything above in one digest
+        std::string fingerprint() const
+        {
+            Sha256 hasher;
+            hasher.update("compiler " + path + '\n');
+            hasher.update("version " + version + '\n');
+            hasher.update("target " + target + '\n');
+            hasher.update("sysroot " + sysroot + '\n');
+            hasher.update("macros " + macros + '\n');
+            // A libstdc++ upgraded on its own leaves the compiler binary and its banner as they were
+            hasher.update("stdlib " + stdlib + ' ' + stdlibStamp.dump() + '\n');
+            return hasher.hexDigest();
+        }
+    };
+
+    static std::filesystem::path cacheFile(const std::filesystem::path &storeDir)
+    {
+        return storeDir / "toolchains.json";
+    }
+
+    static Info probe(const std::string &compiler, const std::filesystem::path &storeDir)
+    {
+        Info info;
+        std::error_code ec;
+        auto resolved = std::filesystem::canonical(find(compiler), ec);
+        if (ec)
+            return info;
+        info.path = resolved.generic_string();
+
+        auto stamp = fileStamp(resolved);
+        auto file = cacheFile(storeDir);
+        std::ifstream in(file);
+        auto cache = in ? nlohmann::json::parse(in, nullptr, false) : nlohmann::json();
+        in.close();
+        if (cache.is_discarded() || !cache.is_object())
+            cache = nlohmann::json::object();
+        if (cache.contains(info.path) && cache[info.path].value("stamp", nlohmann::json()) == stamp &&
+            stdlibCurrent(cache[info.path]))
+        {
+            const auto &entry = cache[info.path];
+            info.version = entry.value("version", "");
+            info.major = entry.value("major", "");
+            info.target = entry.value("target", "");
+            info.sysroot = entry.value("sysroot", "");
+            info.macros = entry.value("macros", "");
+            info.clang = entry.value("clang", false);
+            info.stdlib = entry.value("stdlib", "");
+            info.stdlibStamp = entry.value("stdlibStamp", nlohmann::json());
+            info.cached = true;
+            return info;
+        }
+
+        std::string quoted = TestRunner::shellQuote(info.path);
+        info.version = capture(quoted + " --version");
+        info.clang = info.version.find("clang") != std::string::npos;
+        info.major = trim(capture(quoted + " -dumpversion"));
+        info.target = trim(capture(quoted + " -dumpmachine"));
+        // GCC only; Clang reports its sysroot among the -v search paths, which the macros cover well enough
+        if (!info.clang)
+            info.sysroot = trim(capture(quoted + " -print-sysroot"));
+        std::string macros = capture(quoted + " -dM -E -x c++ " + nullDevice());
+        info.macros = macros.empty() ? "" : Sha256::hash(macros);
+        info.stdlib = stdlibPath(quoted);
+        if (!info.stdlib.empty())
+            info.stdlibStamp = fileStamp(info.stdlib);
+
+        cache[info.path] = {{"stamp", stamp}, {"version", info.version}, {"major", info.major}, {"target", info.target},
+                            {"sysroot", info.sysroot}, {"macros", info.macros}, {"clang", info.clang},
+                            {"stdlib", info.stdlib}, {"stdlibStamp", info.stdlibStamp}};
+        // Written aside and renamed, so concurrent probes never leave a torn file
+        std::filesystem::create_directories(file.parent_path(), ec);
+        auto temp = file;
+        temp += "." + std::to_string(processId());
+        std::ofstream(temp) << cache.dump(1);
+        std::filesystem::rename(temp, file, ec);
+        if (ec)
+            std::filesystem::remove(temp, ec);
+        return info;
+    }
+
+private:
+    // libstdc++ or, failing that, libc++; a compiler that knows neither just echoes the name back
+    static std::string stdlibPath(const std::string &quoted)
+    {
+        for (const char *library : {"libstdc++.so", "libc++.so", "libc++.dylib"})
+        {
+            std::filesystem::path path = trim(capture(quoted + " -print-file-name=" + library));
+            std::error_code ec;
+            if (path.is_absolute() && std::filesystem::exists(path, ec))
+                return std::filesystem::canonical(path, ec).generic_string();
+        }
+        return "";
+    }
+
+    // A cached entry's standard library still has the stamp it was probed with
+    static bool stdlibCurrent(const nlohmann::json &entry)
+    {
+        if (!entry.contains("stdlib"))
+            return false;
+        std::string stdlib = entry.value("stdlib", "");
+        return stdlib.empty() || fileStamp(stdlib) == entry.value("stdlibStamp", nlohmann::json());
+    }
+
+    // A bare name is looked up on PATH the way the shell would
+    static std::filesystem::path find(const std::string &compiler)
+    {
+        std::filesystem::path path(compiler);
+        if (path.has_parent_path())
+            return path;
+        const char *variable = std::getenv("PATH");
+        std::string paths = variable ? variable : "";
+#ifdef _WIN32
+        const char separator = ';';
+        const std::string suffix = path.has_extension() ? "" : ".exe";
+#else
+        const char separator = ':';
+        const std::string suffix;
+#endif
+        size_t start = 0;
+        while (start <= paths.size())
+        {
+            size_t end = paths.find(separator, start);
+            if (end == std::string::npos)
+                end = paths.size();
+            auto candidate = std::filesystem::path(paths.substr(start, end - start)) / (compiler + suffix);
+            std::error_code ec;
+            if (end > start && std::filesystem::is_regular_file(candidate, ec))
+                return candidate;
+            start = end + 1;
+        }
+        return path;
+    }
+
+    static nlohmann::json fileStamp(const std::filesystem::path &binary)
+    {
+#ifndef _WIN32
+        struct stat status;
+        if (::stat(binary.c_str(), &status) != 0)
+            return nlohmann::json();
+#ifdef __APPLE__
+        int64_t mtime = int64_t(status.st_mtimespec.tv_sec) * 1000000000 + status.st_mtimespec.tv_nsec;
+#else
+        int64_t mtime = int64_t(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+        return {{"inode", uint64_t(status.st_ino)}, {"size", uint64_t(status.st_size)}, {"mtime", mtime}};
+#else
+        std::error_code ec;
+        auto size = std::filesystem::file_size(binary, ec);
+        auto mtime = std::filesystem::last_write_time(binary, ec).time_since_epoch().count();
+        return {{"inode", 0}, {"size", uint64_t(size)}, {"mtime", int64_t(mtime)}};
+#endif
+    }
+
+    static std::string trim(std::string value)
+    {
+        while (!value.empty() && std::isspace((unsigned char)value.back()))
+            value.pop_back();
+        return value;
+    }
+
+    static std::string capture(const std::string &command)
+    {
+        return TestRunner::capture(command + " 2>" + nullDevice());
+    }
+
+    static std::string nullDevice()
+    {
+#ifdef _WIN32
+        return "NUL";
+#else
+        return "/dev/null";
+#endif
+    }
+
+    static long processId()
+    {
+#ifdef _WIN32
+        return long(::_getpid());
+#else
+        return long(::getpid());
+#endif
+    }
+};
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef TRASH_HPP
+#define TRASH_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "async_io.hpp"
+#include "dir_scanner.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+#endif
+
+// Instant removal of large directory trees.
+//
+// discard() renames the tree into a .tegen-trash directory next to it (same
+// filesystem, so the rename is atomic) and returns straight away. A detached
+// background tegen process (`tegen __purge`) then empties the trash with
+// removeTree(), which unlinks files across subtrees in parallel. Anything an
+// interrupted purge left behind is picked up by the next one.
+class Trash
+{
+public:
+    static constexpr const char *directoryName = ".tegen-trash";
+
+    // Move target out of the way and delete it in the background. Falls back to a
+    // synchronous delete when the rename is not possible (e.g. across devices).
+    static void discard(const std::filesystem::path &target)
+    {
+        std::error_code ec;
+        if (!std::filesystem::exists(std::filesystem::symlink_status(target, ec)))
+            return;
+
+        std::filesystem::path trash = std::filesystem::absolute(target, ec).parent_path() / directoryName;
+        std::filesystem::create_directories(trash, ec);
+        std::filesystem::path slot = trash / uniqueName(target);
+        std::filesystem::rename(target, slot, ec);
+        if (ec)
+        {
+            removeTree(target);
+            return;
+        }
+        purgeInBackground(trash);
+    }
+
+    // Body of `tegen __purge <trash>`, the process purgeInBackground() starts
+    static int purge(const std::filesystem::path &trash)
+    {
+        removeTree(trash);
+        return 0;
+    }
+
+    // Delete a tree now, using parallel unlinkat where available
+    static void removeTree(const std::filesystem::path &root)
+    {
+        std::error_code ec;
+#ifdef _WIN32
+        // Git marks object files read-only, which blocks deletion on Windows
+        for (auto &entry : std::filesystem::recursive_directory_iterator(root, std::filesystem::directory_options::skip_permission_denied, ec))
+            std::filesystem::permissions(entry, std::filesystem::perms::owner_all, std::filesystem::perm_options::add, ec);
+#else
+        if (std::filesystem::is_directory(std::filesystem::symlink_status(root, ec)))
+        {
+            try
+            {
+                unlinkTree(root);
+            }
+            catch (const std::exception &)
+            {
+                // Fall through to remove_all for whatever is left
+            }
+        }
+#endif
+        std::filesystem::remove_all(root, ec);
+    }
+
+private:
+    static std::string uniqueName(const std::filesystem::path &target)
+    {
+        auto ticks = std::chrono::steady_clock::now().time_since_epoch().count();
+#ifdef _WIN32
+        return target.filename().string() + "-" + std::to_string(ticks);
+#else
+        return target.filename().string() + "-" + std::to_string(::getpid()) + "-" + std::to_string(ticks);
+#endif
+    }
+
+    static void purgeInBackground(const std::filesystem::path &trash)
+    {
+#ifdef _WIN32
+        removeTree(trash);
+#else
+        // This process is multithreaded (action graph workers, the log sink), so the child only makes
+        // async-signal-safe calls and execs a fresh tegen to do the deleting ('tegen __purge <trash>',
+        // see purge()); everything it needs is built first
+        std::string self = selfExecutable();
+        if (self.empty())
+        {
+            removeTree(trash);
+            return;
+        }
+        std::string path = trash.string();
+        const char *argv[] = {self.c_str(), "__purge", path.c_str(), nullptr};
+
+        // Closed on a successful exec; a failed one writes a byte, and the trash is emptied here instead
+        int status[2];
+        if (::pipe(status) != 0)
+        {
+            removeTree(trash);
+            return;
+        }
+        ::fcntl(status[0], F_SETFD, FD_CLOEXEC);
+        ::fcntl(status[1], F_SETFD, FD_CLOEXEC);
+
+        // Double fork so the purge outlives this command without leaving a zombie
+        pid_t child = ::fork();
+        if (child < 0)
+        {
+            ::close(status[0]);
+            ::close(status[1]);
+            removeTree(trash);
+            return;
+        }
+        if (child > 0)
+        {
+            ::close(status[1]);
+            int exitStatus = 0;
+            ::waitpid(child, &exitStatus, 0);
+            char failed = 0;
+            ssize_t got;
+            while ((got = ::read(status[0], &failed, 1)) < 0 && errno == EINTR)
+            {
+            }
+            ::close(status[0]);
+            if (got != 0 || !WIFEXITED(exitStatus) || WEXITSTATUS(exitStatus) != 0)
+                removeTree(trash);
+            return;
+        }
+
+        ::close(status[0]);
+        ::setsid();
+        pid_t purger = ::fork();
+        if (purger != 0)
+            ::_exit(purger < 0 ? 1 : 0);
+
+        int devNull = ::open("/dev/null", O_RDWR);
+        if (devNull >= 0)
+        {
+            ::dup2(devNull, STDIN_FILENO);
+            ::dup2(devNull, STDOUT_FILENO);
+            ::dup2(devNull, STDERR_FILENO);
+        }
+        if (::nice(10) == -1)
+        {
+            // Lower priority is best effort
+        }
+        ::execve(argv[0], const_cast<char *const *>(argv), environ);
+        char failed = 1;
+        if (::write(status[1], &failed, 1) < 0)
+        {
+            // The parent sees the pipe close either way and finds the trash still there
+        }
+        ::_exit(127);
+#endif
+    }
+
+#ifndef _WIN32
+    // This executable, for the background purge to run; "" where it cannot be found
+    static std::string selfExecutable()
+    {
+#ifdef __linux__
+        std::error_code ec;
+        auto self = std::filesystem::read_symlink("/proc/self/exe", ec);
+        if (!ec)
+            return self.string();
+#endif
+        return "";
+    }
+#endif
+
+#ifndef _WIN32
+    static void unlinkTree(const std::filesystem::path &root)
+    {
+        auto listing = DirScanner::scan(root);
+        int rootFd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (rootFd < 0)
+            return;
+
+        // Files first, all at once; then directories deepest level first
+        std::vector<std::string> files;
+        std::map<size_t, std::vector<std::string>, std::greater<size_t>> directoriesByDepth;
+        for (const auto &entry : listing.entries())
+        {
+            std::string relative(listing.relative(entry));
+            if (entry.type == DirScanner::EntryType::Directory)
+                directoriesByDepth[size_t(std::count(relative.begin(), relative.end(), '/'))].push_back(std::move(relative));
+            else
+                files.push_back(std::move(relative));
+        }
+
+        AsyncFileIo::parallelFor(files.size(), [&](size_t i)
+                                 { ::unlinkat(rootFd, files[i].c_str(), 0); });
+        for (const auto &[depth, directories] : directoriesByDepth)
+        {
+            AsyncFileIo::parallelFor(directories.size(), [&](size_t i)
+                                     {
+                // Symlinks to directories are classified as directories but unlink like files
+                if (::unlinkat(rootFd, directories[i].c_str(), AT_REMOVEDIR) != 0 && errno == ENOTDIR)
+                    ::unlinkat(rootFd, directories[i].c_str(), 0); });
+        }
+        ::close(rootFd);
+    }
+#endif
+};
+
+#endif
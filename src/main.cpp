@@ -2,59 +2,356 @@
 
 using json = nlohmann::json; // alias for ease of use
 
+// A count given on the command line (runs, jobs, shards): a whole number of at least minimum
+static unsigned countArgument(const std::string &text, const std::string &what, unsigned minimum = 1) {
+    size_t used = 0;
+    unsigned long value = 0;
+    try {
+        value = std::stoul(text, &used);
+    } catch (const std::exception &) {
+        used = 0;
+    }
+    if (used == 0 || used != text.size() || text[0] == '-' || value < minimum || value > 1000000) {
+        throw std::runtime_error(what + " must be a whole number of at least " + std::to_string(minimum) + ", not '" + text + "'");
+    }
+    return static_cast<unsigned>(value);
+}
+
 int main(int argc, char const *argv[]) {
+    // Compiler launcher mode, set up by cmake/TegenCompileHistory.cmake
+    if (argc >= 2 && std::string(argv[1]) == "__compile") {
+        return CompileHistory::launch(argc, argv, LazyHeaders::retryCompile(argc > 3 ? argv[3] : ""));
+    }
+    // Background half of Trash::discard, started by it in a fresh process
+    if (argc == 3 && std::string(argv[1]) == "__purge") {
+        return Trash::purge(argv[2]);
+    }
+
+    // Global options may come anywhere before a '--': --dry-run makes commands that change things only show
+    // their plan; --quiet, --verbose and --json pick the log mode
+    bool dryRun = false;
+    std::vector<const char *> args;
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--") {
+            args.insert(args.end(), argv + i, argv + argc);
+            break;
+        }
+        if (arg == "--dry-run") {
+            dryRun = true;
+        } else if (arg == "--quiet" || arg == "-q") {
+            Log::setMode(Log::Mode::Quiet);
+        } else if (arg == "--verbose") {
+            Log::setMode(Log::Mode::Verbose);
+        } else if (arg == "--json") {
+            Log::setMode(Log::Mode::Json);
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    argc = static_cast<int>(args.size());
+    argv = args.data();
+    // Whatever is still buffered is written on the way out, however main returns. The log is built
+    // first, so its destructor runs after this handler rather than before it.
+    Log::mode();
+    std::atexit([] { Log::shutdown(); });
+
     PackageManager manager;
 
     // Handle -h flag for help
     if (argc == 2 && std::string(argv[1]) == "-h") {
-        std::cout << "Usage: Tegen <command> [args]" << std::endl;
-        std::cout << "Available commands:" << std::endl;
-        std::cout << "  init              Initialize a new TegenConfig.json in the current directory." << std::endl;
-        std::cout << "  install <package> Install a package and add it to dependencies." << std::endl;
-        std::cout << "  list              List all dependencies from TegenConfig.json." << std::endl;
-        std::cout << "  build             Build the project using CMake." << std::endl;
-        std::cout << "  run               Run the built project." << std::endl;
-        std::cout << "  --version         Show the current Tegen version." << std::endl;
-        std::cout << "  -h                Show this help message." << std::endl;
+        Log::info() << "Usage: Tegen <command> [args]";
+        Log::info() << "Available commands:";
+        Log::info() << "  init              Initialize a new TegenConfig.json in the current directory.";
+        Log::info() << "  install <package> [version] [--lazy]";
+        Log::info() << "                    Install a package and add it to dependencies; with --lazy, headers are";
+        Log::info() << "                    only copied into include/ once a compile includes them.";
+        Log::info() << "  update <package> [version] [--yes|--no|--defer]";
+        Log::info() << "                    Show which files an update recompiles, then apply, skip or defer it.";
+        Log::info() << "  update            List deferred updates.";
+        Log::info() << "  list              List all dependencies from TegenConfig.json.";
+        Log::info() << "  list --cost       Also show what each dependency's headers cost every file that includes them.";
+        Log::info() << "  build [target]    Build the project (or one target) using CMake.";
+        Log::info() << "  build --opt-report [N]        List the N hottest loops the compiler did not vectorize.";
+        Log::info() << "  run [target]      Build and run an executable target.";
+        Log::info() << "  run --profile [target] [-- args...]  Profile a run; per-line weights feed --opt-report.";
+        Log::info() << "  run --startup [target] [--runs N] [-- args...]";
+        Log::info() << "                    Break startup into exec, loader, static initializers and time to main.";
+        Log::info() << "  clean [--build|--deps|--all]  Remove build output and/or dependency clones.";
+        Log::info() << "  store             Show chunk store usage and dedup ratio.";
+        Log::info() << "  toolchain [cc]    Show the cached fingerprint of a compiler (the project's by default).";
+        Log::info() << "  test [-j N] [--shard i/N] [--no-cache] [filter]";
+        Log::info() << "                    Build, then run tests in parallel, skipping unchanged ones.";
+        Log::info() << "  test --record-impact          Record which files each test executes (needs gcov).";
+        Log::info() << "  test --affected[=<rev>]       Run only tests touched by changes since the recording (or <rev>).";
+        Log::info() << "  watch [--bench]   Rebuild and rerun (or re-bench) the project on every change.";
+        Log::info() << "  bench [runs]      Time repeated runs of the built project.";
+        Log::info() << "  bench --io <dir>  Compare install I/O backends on a directory tree.";
+        Log::info() << "  bench --allocators [runs]     Compare system, mimalloc, jemalloc and tcmalloc.";
+        Log::info() << "  optimize [target] [--runs N] [--order-file] [-- args...]";
+        Log::info() << "                    Profile a training run, write a layout-optimized binary and compare.";
+        Log::info() << "  tune [target] [--profile <build type>] [--runs N] [-j N] [-- args...]";
+        Log::info() << "                    Search compiler and linker flags; save the fastest to the profile.";
+        Log::info() << "  size [target] [--diff [snapshot.json]]";
+        Log::info() << "                    Show binary size per package and template bloat; diff against the last run.";
+        Log::info() << "  --dry-run         With init, install, update, build, run, test, bench or clean: show the plan";
+        Log::info() << "                    (downloads, store reuse, files, header cost, predicted time) and change nothing.";
+        Log::info() << "  --quiet, -q       Show only warnings and errors; tools Tegen runs are silenced too.";
+        Log::info() << "  --verbose         Also show every command Tegen runs.";
+        Log::info() << "  --json            Log one JSON object per line on stdout (tool output goes to stderr).";
+        Log::info() << "  --version         Show the current Tegen version.";
+        Log::info() << "  -h                Show this help message.";
         return 0;
     }
 
     // Handle --version
     if (argc == 2 && std::string(argv[1]) == "--version") {
-        std::cout << "tegen version " << PACKAGE_VERSION << std::endl;
+        Log::info() << "tegen version " << PACKAGE_VERSION;
         return 0;
     }
 
     if (argc < 2) {
-        std::cerr << "Usage: Tegen <command> [args]" << std::endl;
-        std::cerr << "Run 'Tegen -h' for a list of available commands." << std::endl;
+        Log::error() << "Usage: Tegen <command> [args]";
+        Log::error() << "Run 'Tegen -h' for a list of available commands.";
         return 1;
     }
 
     std::string command = argv[1];
+    if (dryRun && (command == "watch" || command == "optimize" || command == "size" || command == "tune")) {
+        Log::error() << "Error: " << command
+                     << " has no --dry-run; it is supported by init, install, update, build, run, test, bench and clean.";
+        return 1;
+    }
 
     try {
         if (command == "init") {
-            manager.init();
+            manager.init(dryRun);
         } else if (command == "install") {
             if (argc < 3) {
-                std::cerr << "Error: Please specify a package to install." << std::endl;
+                Log::error() << "Error: Please specify a package to install.";
+                return 1;
+            }
+            std::string package;
+            std::string version;
+            bool lazy = false;
+            for (int i = 2; i < argc; i++) {
+                std::string arg = argv[i];
+                if (arg == "--lazy") {
+                    lazy = true;
+                } else if (package.empty()) {
+                    package = arg;
+                } else {
+                    version = arg;
+                }
+            }
+            if (package.empty()) {
+                Log::error() << "Error: Please specify a package to install.";
+                return 1;
+            }
+            manager.install(package, version, lazy, dryRun);
+        } else if (command == "update") {
+            std::string package;
+            std::string version;
+            std::string decision;
+            for (int i = 2; i < argc; i++) {
+                std::string arg = argv[i];
+                if (arg == "--yes" || arg == "--no" || arg == "--defer") {
+                    decision = arg.substr(2);
+                } else if (package.empty()) {
+                    package = arg;
+                } else {
+                    version = arg;
+                }
+            }
+            if (!manager.update(package, version, decision, dryRun)) {
                 return 1;
             }
-            std::string package = argv[2];
-            manager.install(package);
         } else if (command == "list") {
-            manager.listDependencies();
+            manager.listDependencies(argc >= 3 && std::string(argv[2]) == "--cost");
+        } else if (dryRun && (command == "build" || command == "run" || command == "test" || command == "bench")) {
+            // These all start with a build; what runs after it is not planned
+            manager.build("", true);
         } else if (command == "build") {
-            manager.build();
+            if (argc >= 3 && std::string(argv[2]) == "--opt-report") {
+                if (!manager.optReport(argc >= 4 ? countArgument(argv[3], "The number of loops") : 20)) {
+                    return 1;
+                }
+            } else {
+                manager.build(argc >= 3 ? argv[2] : "");
+            }
         } else if (command == "run") {
-            manager.run();
+            if (argc >= 3 && std::string(argv[2]) == "--profile") {
+                std::string target;
+                std::string arguments;
+                for (int i = 3; i < argc; i++) {
+                    if (std::string(argv[i]) == "--") {
+                        for (i++; i < argc; i++) {
+                            arguments += " " + TestRunner::shellQuote(argv[i]);
+                        }
+                    } else {
+                        target = argv[i];
+                    }
+                }
+                if (!manager.profile(target, arguments)) {
+                    return 1;
+                }
+            } else if (argc >= 3 && std::string(argv[2]) == "--startup") {
+                std::string target;
+                std::vector<std::string> arguments;
+                size_t runs = 10;
+                for (int i = 3; i < argc; i++) {
+                    std::string arg = argv[i];
+                    if (arg == "--") {
+                        arguments.assign(argv + i + 1, argv + argc);
+                        break;
+                    } else if (arg == "--runs" && i + 1 < argc) {
+                        runs = countArgument(argv[++i], "--runs");
+                    } else {
+                        target = arg;
+                    }
+                }
+                if (!manager.startupProfile(target, arguments, runs)) {
+                    return 1;
+                }
+            } else {
+                manager.run(argc >= 3 ? argv[2] : "");
+            }
+        } else if (command == "clean") {
+            if (!manager.clean(argc >= 3 ? argv[2] : "--build", dryRun)) {
+                return 1;
+            }
+        } else if (command == "store") {
+            manager.storeStats();
+        } else if (command == "toolchain") {
+            manager.toolchainInfo(argc >= 3 ? argv[2] : "");
+        } else if (command == "test") {
+            TestRunner::Options options;
+            bool affected = false;
+            bool recordImpact = false;
+            std::string base;
+            for (int i = 2; i < argc; i++) {
+                std::string arg = argv[i];
+                if (arg == "-j" && i + 1 < argc) {
+                    options.jobs = countArgument(argv[++i], "-j");
+                } else if (arg.rfind("--shard=", 0) == 0 || (arg == "--shard" && i + 1 < argc)) {
+                    std::string spec = arg == "--shard" ? argv[++i] : arg.substr(8);
+                    auto slash = spec.find('/');
+                    if (slash == std::string::npos) {
+                        Log::error() << "Error: --shard expects i/N, e.g. --shard 0/4";
+                        return 1;
+                    }
+                    options.shardIndex = countArgument(spec.substr(0, slash), "The shard index", 0);
+                    options.shardCount = countArgument(spec.substr(slash + 1), "The shard count");
+                    if (options.shardCount == 0 || options.shardIndex >= options.shardCount) {
+                        Log::error() << "Error: shard index must be below the shard count.";
+                        return 1;
+                    }
+                } else if (arg == "--no-cache") {
+                    options.useCache = false;
+                } else if (arg == "--affected" || arg.rfind("--affected=", 0) == 0) {
+                    affected = true;
+                    base = arg.size() > 10 ? arg.substr(11) : "";
+                } else if (arg == "--record-impact") {
+                    recordImpact = true;
+                } else {
+                    options.filter = arg;
+                }
+            }
+            if (recordImpact ? !manager.recordTestImpact(options) : !manager.test(options, affected, base)) {
+                return 1;
+            }
+        } else if (command == "watch") {
+            manager.watch(argc >= 3 && std::string(argv[2]) == "--bench");
+        } else if (command == "bench") {
+            if (argc >= 3 && std::string(argv[2]) == "--io") {
+                if (argc < 4) {
+                    Log::error() << "Usage: tegen bench --io <dir>";
+                    return 1;
+                }
+                if (!manager.benchIo(argv[3])) {
+                    return 1;
+                }
+            } else if (argc >= 3 && std::string(argv[2]) == "--allocators") {
+                if (!manager.benchAllocators(argc >= 4 ? int(countArgument(argv[3], "The number of runs")) : 10)) {
+                    return 1;
+                }
+            } else if (!manager.bench(argc >= 3 ? int(countArgument(argv[2], "The number of runs")) : 10)) {
+                return 1;
+            }
+        } else if (command == "optimize") {
+            std::string target;
+            std::string arguments;
+            int runs = 10;
+            bool orderFile = false;
+            for (int i = 2; i < argc; i++) {
+                std::string arg = argv[i];
+                if (arg == "--") {
+                    // Everything after -- is the training workload's command line
+                    for (i++; i < argc; i++) {
+                        arguments += " " + TestRunner::shellQuote(argv[i]);
+                    }
+                } else if (arg == "--runs" && i + 1 < argc) {
+                    runs = int(countArgument(argv[++i], "--runs"));
+                } else if (arg == "--order-file") {
+                    orderFile = true;
+                } else {
+                    target = arg;
+                }
+            }
+            if (!manager.optimize(target, arguments, runs, orderFile)) {
+                return 1;
+            }
+        } else if (command == "tune") {
+            std::string target;
+            std::string arguments;
+            std::string buildType;
+            int runs = 0;
+            unsigned jobs = 0;
+            for (int i = 2; i < argc; i++) {
+                std::string arg = argv[i];
+                if (arg == "--") {
+                    // Everything after -- is the benchmark's command line
+                    for (i++; i < argc; i++) {
+                        arguments += " " + TestRunner::shellQuote(argv[i]);
+                    }
+                } else if (arg == "--runs" && i + 1 < argc) {
+                    runs = int(countArgument(argv[++i], "--runs"));
+                } else if (arg == "-j" && i + 1 < argc) {
+                    jobs = countArgument(argv[++i], "-j");
+                } else if (arg == "--profile" && i + 1 < argc) {
+                    buildType = argv[++i];
+                } else {
+                    target = arg;
+                }
+            }
+            if (!manager.tune(target, arguments, buildType, runs, jobs)) {
+                return 1;
+            }
+        } else if (command == "size") {
+            std::string target;
+            std::string against;
+            bool diff = false;
+            for (int i = 2; i < argc; i++) {
+                std::string arg = argv[i];
+                if (arg == "--diff") {
+                    diff = true;
+                    // An optional snapshot to compare against instead of the previous run
+                    if (i + 1 < argc && std::filesystem::path(argv[i + 1]).extension() == ".json") {
+                        against = argv[++i];
+                    }
+                } else {
+                    target = arg;
+                }
+            }
+            if (!manager.size(target, diff, against)) {
+                return 1;
+            }
         } else {
-            std::cerr << "Error: Unknown command: " << command << std::endl;
-            std::cerr << "Run 'Tegen -h' for help." << std::endl;
+            Log::error() << "Error: Unknown command: " << command;
+            Log::error() << "Run 'Tegen -h' for help.";
         }
     } catch (const std::exception& e) {
-        std::cerr << "An error occurred: " << e.what() << std::endl;
+        Log::error() << "An error occurred: " << e.what();
         return 1;
     }
 